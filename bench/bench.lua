@@ -0,0 +1,274 @@
+-- Microbenchmarks for the C modules. Run from the repository root after a
+-- release build, e.g. `make bench` or:
+--
+--      lua bench/bench.lua [out.json] [filter]
+--
+-- Results are printed as a table and, if `out.json` is given, also written as
+-- JSON with one result per line so that two runs can be compared with
+-- `lua bench/compare.lua old.json new.json`.
+--
+-- `filter` is a Lua pattern; only cases whose name matches it are run.
+package.cpath = "./?.so;./?.dll;" .. package.cpath
+
+local timer   = require "timer"
+local dyarray = require "dyarray"
+local serial  = require "serial"
+
+local out_path = arg[1]
+local filter   = arg[2]
+local sizes    = {16, 1024, 65536}
+
+---@class bench.case
+---@field name  string
+---@field size  integer
+---@field fn    fun(n: integer)
+
+---@type bench.case[]
+local cases = {}
+
+---@param name string
+---@param size integer
+---@param fn   fun(n: integer)
+local function add(name, size, fn)
+    if not filter or name:match(filter) then
+        cases[#cases + 1] = {name = name, size = size, fn = fn}
+    end
+end
+
+---@param n integer
+---@return number[]
+local function make_table(n)
+    local t = {}
+    for i = 1, n do
+        t[i] = i
+    end
+    return t
+end
+
+--- CASES ------------------------------------------------------------------ {{{
+
+for _, size in ipairs(sizes) do
+    local t = make_table(size)
+    local a = dyarray.new(t)
+
+    add("new", size, function(n)
+        for _ = 1, n do
+            dyarray.new(t)
+        end
+    end)
+
+    -- Amortized growth, starting from an empty array each call.
+    add("push", size, function(n)
+        local b = dyarray.new()
+        for i = 1, n do
+            b:push(i)
+            if i % size == 0 then
+                b:resize(0)
+            end
+        end
+    end)
+
+    add("pop", size, function(n)
+        local b = a:copy()
+        for i = 1, n do
+            if b:length() == 0 then
+                b:resize(size)
+            end
+            b:pop()
+        end
+    end)
+
+    add("get:method", size, function(n)
+        for i = 1, n do
+            a:get(i % size + 1)
+        end
+    end)
+
+    add("get:__index", size, function(n)
+        for i = 1, n do
+            local _ = a[i % size + 1]
+        end
+    end)
+
+    -- Cases that write go through their own copy, so every later case still
+    -- reads `t` from `a` whichever ones the filter selects.
+    local w1 = a:copy()
+    add("set:method", size, function(n)
+        for i = 1, n do
+            w1:set(i % size + 1, i)
+        end
+    end)
+
+    local w2 = a:copy()
+    add("set:__newindex", size, function(n)
+        for i = 1, n do
+            w2[i % size + 1] = i
+        end
+    end)
+
+    -- Same loops through the closures from `a:unsafe()`, which skip the type
+    -- check on every call and, in release builds, the bounds check.
+    local uget = a:unsafe()
+    local _, uset = a:copy():unsafe()
+
+    add("get:unsafe", size, function(n)
+        for i = 1, n do
+            uget(i % size + 1)
+        end
+    end)
+
+    add("set:unsafe", size, function(n)
+        for i = 1, n do
+            uset(i % size + 1, i)
+        end
+    end)
+
+    add("resize", size, function(n)
+        local b = dyarray.new()
+        for i = 1, n do
+            b:resize(i % 2 == 0 and size or 0)
+        end
+    end)
+
+    -- Random fill through `math.random()` per element versus in one call.
+    local w3 = a:copy()
+    add("random:math.random", size, function(n)
+        local random = math.random
+        for i = 1, n do
+            w3[i % size + 1] = random()
+        end
+    end)
+
+    local w4 = a:copy()
+    add("random:fill_uniform", size, function(n)
+        for _ = 1, math.ceil(n / size) do
+            w4:fill_uniform()
+        end
+    end)
+
+    -- Feature normalization: `math.log()` per element versus `a:log()`.
+    local logs = a:copy()
+    add("math:math.log", size, function(n)
+        local log = math.log
+        for i = 1, n do
+            local j = i % size + 1
+            logs[j] = log(a[j])
+        end
+    end)
+
+    add("math:log", size, function(n)
+        for _ = 1, math.ceil(n / size) do
+            a:log(logs)
+        end
+    end)
+
+    -- A chained pipeline: per element in Lua versus one fused native pass.
+    add("expr:lua", size, function(n)
+        local sqrt, abs = math.sqrt, math.abs
+        local s = 0
+        for i = 1, n do
+            local x = a[i % size + 1]
+            s = s + sqrt(abs(x * 2 + x))
+        end
+        return s
+    end)
+
+    add("expr:fused", size, function(n)
+        for _ = 1, math.ceil(n / size) do
+            local e = a:lazy()
+            local _ = ((e * 2) + a):abs():sqrt():sum()
+        end
+    end)
+
+    add("copy", size, function(n)
+        for _ = 1, n do
+            a:copy()
+        end
+    end)
+
+    add("tostring", size, function(n)
+        for _ = 1, n do
+            tostring(a)
+        end
+    end)
+
+    -- Checkpoint-like state: many small records.
+    local state = {}
+    for i = 1, size do
+        state[i] = {id = i, name = "item" .. i, weight = i / 3}
+    end
+    local packed = serial.pack(state)
+
+    add("serial.pack", size, function(n)
+        for _ = 1, n do
+            serial.pack(state)
+        end
+    end)
+
+    add("serial.unpack", size, function(n)
+        for _ = 1, n do
+            serial.unpack(packed)
+        end
+    end)
+
+    add("dump_table", size, function(n)
+        for _ = 1, n do
+            dump_table(state, {out = "string"})
+        end
+    end)
+end
+
+--- }}} ------------------------------------------------------------------------
+
+--- REPORTING -------------------------------------------------------------- {{{
+
+---@param v any
+local function to_json(v)
+    if type(v) == "string" then
+        return string.format("%q", v)
+    elseif type(v) == "number" then
+        return (v == math.huge) and "1e308" or string.format("%.6g", v)
+    end
+    return tostring(v)
+end
+
+local FIELDS = {"median", "p99", "min", "max", "mean", "stddev", "mad", "ops_per_sec"}
+
+---@param name  string
+---@param size  integer
+---@param stats table
+local function json_line(name, size, stats)
+    local parts = {to_json("name") .. ": " .. to_json(name),
+                   to_json("size") .. ": " .. to_json(size),
+                   to_json("iters") .. ": " .. to_json(stats.iters),
+                   to_json("reps") .. ": " .. to_json(stats.reps)}
+    for _, k in ipairs(FIELDS) do
+        local unit = (k == "ops_per_sec") and "" or "_ns"
+        parts[#parts + 1] = to_json(k .. unit) .. ": " .. to_json(stats[k])
+    end
+    return "{" .. table.concat(parts, ", ") .. "}"
+end
+
+print(string.format("%-16s %8s %12s %12s %12s %14s",
+                    "case", "size", "median ns", "p99 ns", "mad ns", "ops/sec"))
+
+local lines = {}
+for _, case in ipairs(cases) do
+    collectgarbage("collect")
+    local stats = timer.measure(case.fn)
+    print(string.format("%-16s %8d %12.2f %12.2f %12.2f %14.0f",
+                        case.name, case.size, stats.median, stats.p99,
+                        stats.mad, stats.ops_per_sec))
+    lines[#lines + 1] = json_line(case.name, case.size, stats)
+end
+
+if out_path then
+    local file = assert(io.open(out_path, "w"))
+    file:write('{"version": ', to_json(_VERSION), ', "results": [\n')
+    file:write(table.concat(lines, ",\n"))
+    file:write("\n]}\n")
+    file:close()
+    print("wrote " .. out_path)
+end
+
+--- }}} ------------------------------------------------------------------------
@@ -0,0 +1,59 @@
+-- Compare two JSON files written by `bench/bench.lua`:
+--
+--      lua bench/compare.lua old.json new.json [threshold]
+--
+-- Prints the median ratio for every case found in both files and flags those
+-- that got slower by more than `threshold` (default 0.05, i.e. 5%). Exits
+-- with a nonzero status if anything regressed.
+local old_path, new_path = arg[1], arg[2]
+local threshold = tonumber(arg[3]) or 0.05
+
+if not old_path or not new_path then
+    io.stderr:write("usage: lua bench/compare.lua old.json new.json [threshold]\n")
+    os.exit(2)
+end
+
+-- We only ever read our own output, which has one result object per line, so
+-- a full JSON parser would be overkill.
+---@param path string
+---@return table<string, table>, string[]
+local function load(path)
+    local results, order = {}, {}
+    for line in io.lines(path) do
+        local name = line:match('"name": "([^"]+)"')
+        if name then
+            local key = name .. "/" .. line:match('"size": (%d+)')
+            results[key] = {
+                median = tonumber(line:match('"median_ns": ([^,}]+)')),
+                mad    = tonumber(line:match('"mad_ns": ([^,}]+)')),
+            }
+            order[#order + 1] = key
+        end
+    end
+    return results, order
+end
+
+local old = load(old_path)
+local new, order = load(new_path)
+local regressed = 0
+
+print(string.format("%-24s %12s %12s %8s", "case", "old ns", "new ns", "ratio"))
+for _, key in ipairs(order) do
+    local a, b = old[key], new[key]
+    if a then
+        local ratio = b.median / a.median
+        -- Differences within the combined noise are not worth flagging.
+        local noise = (a.mad + b.mad) / a.median
+        local flag  = ""
+        if ratio > 1 + math.max(threshold, noise) then
+            flag      = "  REGRESSION"
+            regressed = regressed + 1
+        elseif ratio < 1 - math.max(threshold, noise) then
+            flag = "  improved"
+        end
+        print(string.format("%-24s %12.2f %12.2f %8.3f%s",
+                            key, a.median, b.median, ratio, flag))
+    end
+end
+
+os.exit(regressed == 0 and 0 or 1)
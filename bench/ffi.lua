@@ -0,0 +1,77 @@
+-- Summation over a dyarray through the C API versus through LuaJIT's FFI.
+-- Only meaningful under LuaJIT; run from the repository root after a release
+-- build (`make bench` builds everything needed):
+--
+--      luajit bench/ffi.lua [size]
+package.cpath = "./?.so;./?.dll;" .. package.cpath
+package.path  = "./?.lua;" .. package.path
+
+if not jit then
+    print("bench/ffi.lua: skipped, this needs LuaJIT")
+    return
+end
+
+local timer   = require "timer"
+local dyarray = require "dyarray"
+local dyffi   = require "dyarray_ffi"
+
+local size   = tonumber(arg[1]) or 1e6
+local a      = dyarray.new()
+local expect = 0
+for i = 1, size do
+    a:push(i % 7)
+    expect = expect + i % 7
+end
+
+-- Every case stores its sum here, and it is checked after timing, so that
+-- LuaJIT cannot drop a loop whose result would otherwise go unused.
+local sink
+
+local cases = {
+    {"a:get(i)", function(n)
+        for _ = 1, n do
+            local s = 0
+            for i = 1, size do
+                s = s + a:get(i)
+            end
+            sink = s
+        end
+    end},
+    {"a[i]", function(n)
+        for _ = 1, n do
+            local s = 0
+            for i = 1, size do
+                s = s + a[i]
+            end
+            sink = s
+        end
+    end},
+    {"ffi values", function(n)
+        for _ = 1, n do
+            sink = dyffi.sum(a)
+        end
+    end},
+    {"ffi view", function(n)
+        for _ = 1, n do
+            local v, s = dyffi.view(a), 0
+            for i = 0, v.length - 1 do
+                s = s + v.values[i]
+            end
+            sink = s
+        end
+    end},
+}
+
+print(string.format("%s, %d elements", jit.version, size))
+print(string.format("%-12s %12s %12s %10s", "case", "median ms", "ns/elem", "speedup"))
+
+local base
+for _, case in ipairs(cases) do
+    sink = nil
+    local stats = timer.measure(case[2], {iters = 1, reps = 11})
+    assert(sink == expect, case[1] .. ": wrong sum")
+    local ms    = stats.median / 1e6
+    base = base or ms
+    print(string.format("%-12s %12.3f %12.3f %9.1fx", case[1], ms,
+                        stats.median / size, base / ms))
+end
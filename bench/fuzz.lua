@@ -0,0 +1,220 @@
+-- Differential fuzzer: run the same random operation sequences against the C
+-- `dyarray` module and the pure-Lua model in `meta/dyarray.lua`, and check
+-- that every result, every error and the final contents agree.
+--
+--      lua bench/fuzz.lua [seed] [rounds] [ops_per_round]
+--
+-- Along the way each operation is timed on both sides, and the per-op
+-- speedup of the C module over the model is reported at the end. Exits with
+-- a nonzero status on the first disagreement, printing the seed and the
+-- operation log needed to reproduce it.
+package.cpath = "./?.so;./?.dll;" .. package.cpath
+
+local dyarray = require "dyarray"
+local unpack  = unpack or table.unpack
+local clock   = os.clock
+do
+    local ok, timer = pcall(require, "timer")
+    if ok then
+        clock = timer.now
+    end
+end
+
+local seed   = tonumber(arg[1]) or os.time()
+local rounds = tonumber(arg[2]) or 200
+local nops   = tonumber(arg[3]) or 500
+
+-- Load the model into its own environment so that its global `dyarray` does
+-- not replace the C module's, which `src/dyarray.c` looks methods up in.
+---@return table
+local function load_model(path)
+    local env = setmetatable({}, {__index = _G})
+    local chunk
+    if setfenv then
+        chunk = assert(loadfile(path))
+        setfenv(chunk, env)
+    else
+        chunk = assert(loadfile(path, "t", env))
+    end
+    return chunk()
+end
+
+local model = load_model("meta/dyarray.lua")
+
+--- OPERATIONS ------------------------------------------------------------- {{{
+
+-- Mostly small values, now and then a NaN to exercise orderings.
+local function rand_value()
+    if math.random() < 0.01 then
+        return 0/0
+    end
+    return math.random(-1000, 1000) / 8
+end
+
+-- Mostly valid indexes, including negative ones, with some out of range.
+---@param len integer
+local function rand_index(len)
+    local r = math.random()
+    if r < 0.1 then
+        return len + math.random(1, 3)
+    elseif r < 0.2 then
+        return -len - math.random(1, 3)
+    elseif r < 0.4 then
+        return -math.random(1, math.max(len, 1))
+    end
+    return math.random(1, math.max(len, 1))
+end
+
+---@class fuzz.op
+---@field name   string
+---@field weight integer
+---@field args   fun(len: integer): any[]
+---@field ordered? boolean Result order is unspecified once NaNs are present.
+
+---@type fuzz.op[]
+local OPS = {
+    {name = "push",    weight = 30, args = function() return {rand_value()} end},
+    {name = "pop",     weight = 15, args = function() return {} end},
+    {name = "get",     weight = 15, args = function(len) return {rand_index(len)} end},
+    {name = "set",     weight = 10, args = function(len) return {rand_index(len), rand_value()} end},
+    {name = "insert",  weight = 5,  args = function(len) return {rand_index(len), rand_value()} end},
+    {name = "remove",  weight = 5,  args = function(len) return {rand_index(len)} end},
+    {name = "resize",  weight = 5,  args = function(len)
+        return {math.random() < 0.05 and -1 or math.random(0, len * 2 + 8)}
+    end},
+    {name = "length",  weight = 5,  args = function() return {} end},
+    {name = "copy",    weight = 2,  args = function() return {} end},
+    {name = "cumsum",  weight = 2,  args = function() return {} end},
+    {name = "diff",    weight = 2,  args = function() return {math.random(0, 3)} end},
+    {name = "topk",    weight = 2,  ordered = true, args = function(len) return {math.random(0, len + 2)} end},
+    {name = "unique",  weight = 2,  args = function() return {} end},
+}
+
+local total_weight = 0
+for _, op in ipairs(OPS) do
+    total_weight = total_weight + op.weight
+end
+
+local function pick_op()
+    local r = math.random(1, total_weight)
+    for _, op in ipairs(OPS) do
+        r = r - op.weight
+        if r <= 0 then
+            return op
+        end
+    end
+end
+
+--- }}} ------------------------------------------------------------------------
+
+--- COMPARISON ------------------------------------------------------------- {{{
+
+-- Flatten a C dyarray or a model instance into a plain table.
+---@return number[]
+local function contents(a)
+    local t = {n = a:length()}
+    for i = 1, t.n do
+        t[i] = a:get(i)
+    end
+    return t
+end
+
+-- Lua 5.3+ prints integral floats as `1.0`, and the model keeps integers as
+-- given while the C modules hand back floats, so compare numbers by value
+-- rather than by `tostring()`.
+local function show_value(v)
+    if v ~= v then
+        return "nan" -- Its sign bit depends on how it was made.
+    elseif type(v) == "number" then
+        return string.format("%.17g", v)
+    end
+    return tostring(v)
+end
+
+---@param t number[]
+local function show(t)
+    local parts = {}
+    for i = 1, t.n do
+        parts[i] = show_value(t[i])
+    end
+    return "{" .. table.concat(parts, ", ") .. "}"
+end
+
+-- Results are compared by value; dyarray results by their contents.
+local function normalize(v)
+    if type(v) == "userdata" or (type(v) == "table" and v.m_values) then
+        return show(contents(v))
+    end
+    return show_value(v)
+end
+
+--- }}} ------------------------------------------------------------------------
+
+local stats = {}
+for _, op in ipairs(OPS) do
+    stats[op.name] = {count = 0, c_time = 0, lua_time = 0}
+end
+
+---@param impl table
+---@param self any
+---@param op   fuzz.op
+---@param args any[]
+local function run(impl, self, op, args)
+    local start = clock()
+    local ok, result = pcall(impl[op.name], self, unpack(args))
+    return clock() - start, ok, result
+end
+
+math.randomseed(seed)
+print(string.format("fuzz: seed = %d, rounds = %d, ops per round = %d", seed, rounds, nops))
+
+for round = 1, rounds do
+    local init = {}
+    for i = 1, math.random(0, 20) do
+        init[i] = rand_value()
+    end
+
+    local c, m = dyarray.new(init), model.new(init)
+    local log  = {"new(" .. show({n = #init, unpack(init)}) .. ")"}
+    local has_nan = log[1]:find("nan", 1, true) ~= nil
+    for _ = 1, nops do
+        local op   = pick_op()
+        while has_nan and op.ordered do
+            op = pick_op()
+        end
+        local args = op.args(m:length())
+        local st   = stats[op.name]
+        local c_dt, c_ok, c_res = run(dyarray, c, op, args)
+        local m_dt, m_ok, m_res = run(model, m, op, args)
+
+        log[#log + 1] = op.name .. "(" .. table.concat(args, ", ") .. ")"
+        st.count    = st.count + 1
+        st.c_time   = st.c_time + c_dt
+        st.lua_time = st.lua_time + m_dt
+
+        local c_str = c_ok and normalize(c_res) or "error"
+        local m_str = m_ok and normalize(m_res) or "error"
+        local c_all = show(contents(c))
+        local m_all = show(contents(m))
+        has_nan = c_all:find("nan", 1, true) ~= nil
+        if c_str ~= m_str or c_all ~= m_all then
+            print(string.format("MISMATCH in round %d (seed %d)", round, seed))
+            print("ops:    " .. table.concat(log, "; "))
+            print("C:      " .. c_str .. (c_ok and "" or (" " .. tostring(c_res))) .. " -> " .. c_all)
+            print("model:  " .. m_str .. (m_ok and "" or (" " .. tostring(m_res))) .. " -> " .. m_all)
+            os.exit(1)
+        end
+    end
+end
+
+print(string.format("\n%-8s %8s %12s %12s %9s", "op", "count", "C us/op", "Lua us/op", "speedup"))
+for _, op in ipairs(OPS) do
+    local st = stats[op.name]
+    if st.count > 0 then
+        local c_us   = st.c_time / st.count * 1e6
+        local lua_us = st.lua_time / st.count * 1e6
+        print(string.format("%-8s %8d %12.3f %12.3f %8.2fx", op.name, st.count,
+                            c_us, lua_us, (c_us > 0) and lua_us / c_us or 0))
+    end
+end
+print("\nfuzz: all results agree")
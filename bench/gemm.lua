@@ -0,0 +1,86 @@
+-- Throughput of `dyarray.gemm()` and `dyarray.gemv()` in GFLOP/s, next to the
+-- triple loop through `__index` that they replace. Run from the repository
+-- root after a release build (`make bench` builds everything needed):
+--
+--      lua bench/gemm.lua [max_size]
+--
+-- Square `n x n` matrices throughout; the Lua loops are only timed up to
+-- n = 128 since they take too long beyond that.
+package.cpath = "./?.so;./?.dll;" .. package.cpath
+
+local timer   = require "timer"
+local dyarray = require "dyarray"
+
+local max_size = tonumber(arg[1]) or 512
+
+---@param len integer
+local function random_dyarray(len)
+    local a = dyarray.new()
+    a:resize(len)
+    for i = 1, len do
+        a[i] = math.random() - 0.5
+    end
+    return a
+end
+
+---@param A dyarray
+---@param B dyarray
+---@param C dyarray
+---@param n integer
+local function lua_gemm(A, B, C, n)
+    for i = 0, n - 1 do
+        for j = 1, n do
+            local s = 0
+            for p = 0, n - 1 do
+                s = s + A[i * n + p + 1] * B[p * n + j]
+            end
+            C[i * n + j] = s
+        end
+    end
+end
+
+---@param name  string
+---@param n     integer
+---@param flops number
+---@param fn    fun(iters: integer)
+---@param base? number Median ns of the case to compare against.
+---@param opts? table  Passed on to `timer.measure()`.
+local function report(name, n, flops, fn, base, opts)
+    collectgarbage("collect")
+    local stats = timer.measure(fn, opts or {})
+    print(string.format("%-12s %6d %12.3f %10.2f %10s", name, n, stats.median / 1e6,
+                        flops / stats.median,
+                        base and string.format("%.1fx", base / stats.median) or ""))
+    return stats.median
+end
+
+math.randomseed(1)
+print(string.format("%-12s %6s %12s %10s %10s", "case", "n", "median ms", "GFLOP/s", "speedup"))
+
+local n = 16
+while n <= max_size do
+    local A, B = random_dyarray(n * n), random_dyarray(n * n)
+    local C    = dyarray.new()
+    local x    = random_dyarray(n)
+    local flops = 2 * n * n * n
+
+    local base
+    if n <= 128 then
+        base = report("lua gemm", n, flops, function(iters)
+            for _ = 1, iters do
+                lua_gemm(A, B, C, n)
+            end
+        end, nil, {reps = 5})
+    end
+    report("gemm", n, flops, function(iters)
+        for _ = 1, iters do
+            dyarray.gemm(A, B, n, n, n, C)
+        end
+    end, base)
+    report("gemv", n, 2 * n * n, function(iters)
+        for _ = 1, iters do
+            dyarray.gemv(A, x, n, n, C)
+        end
+    end)
+    n = n * 2
+end
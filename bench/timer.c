@@ -0,0 +1,199 @@
+/**
+ * @name    Benchmark Timer
+ *
+ * @brief   Monotonic clock plus a measurement loop for `bench/bench.lua`. The
+ *          loop lives in C so that the harness itself adds no Lua overhead
+ *          between samples, and so that sample storage never allocates Lua
+ *          objects while we are timing.
+ *
+ * @note    A benchmark function receives an iteration count `n` and should
+ *          perform its operation `n` times. We time whole calls and divide by
+ *          `n`, which amortizes the call and clock overhead.
+ */
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L // clock_gettime()
+#endif
+
+#define LIB_NAME "timer"
+#include "common.h"
+#include <math.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define DEFAULT_REPS        31
+#define DEFAULT_WARMUP      3
+#define DEFAULT_MIN_TIME    1e-3 // Seconds per sample when calibrating.
+
+// HELPERS ----------------------------------------------------------------- {{{
+
+// Seconds since some unspecified starting point. Never goes backwards.
+static double c_now(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER        t;
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return cast(double, t.QuadPart) / cast(double, freq.QuadPart);
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return cast(double, t.tv_sec) + cast(double, t.tv_nsec) * 1e-9;
+#endif
+}
+
+static int c_compare_doubles(const void *a, const void *b)
+{
+    double x = *cast(const double *, a);
+    double y = *cast(const double *, b);
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted `samples[0:n]`, `p` in [0, 1].
+static double c_percentile(const double *samples, int n, double p)
+{
+    int rank = cast_int(ceil(p * n)) - 1;
+    if (rank < 0)
+        rank = 0;
+    return samples[rank];
+}
+
+/**
+ * @brief   Time a single call of `fn(n)`.
+ *
+ * @note    Stack before:   [ fn, ... ]
+ *          Stack after:    [ fn, ... ]
+ */
+static double l_time_call(lua_State *L, int fn_idx, int n)
+{
+    double start;
+    lua_pushvalue(L, fn_idx);
+    lua_pushinteger(L, n);
+    start = c_now();
+    lua_call(L, 1, 0);
+    return c_now() - start;
+}
+
+static void l_setfield_number(lua_State *L, const char *k, double v)
+{
+    lua_pushnumber(L, v);
+    lua_setfield(L, -2, k);
+}
+
+static int l_optfield_int(lua_State *L, int t_idx, const char *k, int def)
+{
+    int n;
+    lua_getfield(L, t_idx, k);
+    n = lua_isnil(L, -1) ? def : cast_int(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    return n;
+}
+
+// }}} -------------------------------------------------------------------------
+
+// METHODS ---------------------------------------------------------------- {{{1
+
+/**
+ * @note    Stack usage:    [ -0, +1, - ]
+ *          Stack after:    [ seconds: number ]
+ */
+static int now_timer(lua_State *L)
+{
+    lua_pushnumber(L, c_now());
+    return 1;
+}
+
+/**
+ * @brief   Run `fn(iters)` `warmup` times untimed, then `reps` times timed,
+ *          and summarize the per-operation times of the timed runs.
+ *
+ * @exception <args[:]>: type
+ *            fn():      any
+ *
+ * @note    Stack usage:    [ -(1|2), +1, m|e ]
+ *          Stack before:   [ fn: function, opts: table? ]
+ *          Stack after:    [ stats: table ]
+ *
+ * @note    `opts` may have the integer fields `iters`, `reps` and `warmup`.
+ *          If `iters` is not given it is doubled until one call takes at
+ *          least a millisecond, so that clock resolution is negligible.
+ *
+ * @note    All times in `stats` are in nanoseconds per operation:
+ *          `min`, `median`, `p99`, `max`, `mean`, `stddev` and `mad` (median
+ *          absolute deviation, which unlike `stddev` ignores outliers). It
+ *          also has `ops_per_sec` (from the median), `iters` and `reps`.
+ */
+static int measure_timer(lua_State *L)
+{
+    int     iters, reps, warmup;
+    double *samples, *devs;
+    double  sum = 0, sumsq = 0, median, scale;
+
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+    if (lua_isnoneornil(L, 2))
+        lua_newtable(L);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2); // [ fn, opts ]
+
+    iters  = l_optfield_int(L, 2, "iters", 0);
+    reps   = l_optfield_int(L, 2, "reps", DEFAULT_REPS);
+    warmup = l_optfield_int(L, 2, "warmup", DEFAULT_WARMUP);
+    luaL_argcheck(L, reps > 0 && warmup >= 0 && iters >= 0, 2, "negative count");
+
+    if (iters == 0) {
+        iters = 1;
+        while (l_time_call(L, 1, iters) < DEFAULT_MIN_TIME && iters < (1 << 30))
+            iters *= 2;
+    }
+    for (int i = 0; i < warmup; i++)
+        l_time_call(L, 1, iters);
+
+    // Userdata so the buffer is collected even if `fn` throws.
+    samples = lua_newuserdata(L, sizeof(double) * 2 * reps); // [ fn, opts, buf ]
+    devs    = samples + reps;
+    scale   = 1e9 / iters;
+    for (int i = 0; i < reps; i++) {
+        samples[i] = l_time_call(L, 1, iters) * scale;
+        sum   += samples[i];
+        sumsq += samples[i] * samples[i];
+    }
+
+    qsort(samples, cast(size_t, reps), sizeof(samples[0]), &c_compare_doubles);
+    median = c_percentile(samples, reps, 0.5);
+    for (int i = 0; i < reps; i++)
+        devs[i] = fabs(samples[i] - median);
+    qsort(devs, cast(size_t, reps), sizeof(devs[0]), &c_compare_doubles);
+
+    lua_createtable(L, 0, 10); // [ fn, opts, buf, stats ]
+    l_setfield_number(L, "min",    samples[0]);
+    l_setfield_number(L, "median", median);
+    l_setfield_number(L, "p99",    c_percentile(samples, reps, 0.99));
+    l_setfield_number(L, "max",    samples[reps - 1]);
+    l_setfield_number(L, "mean",   sum / reps);
+    l_setfield_number(L, "stddev", sqrt(fmax(sumsq / reps - (sum / reps) * (sum / reps), 0)));
+    l_setfield_number(L, "mad",    c_percentile(devs, reps, 0.5));
+    l_setfield_number(L, "ops_per_sec", (median > 0) ? 1e9 / median : HUGE_VAL);
+    l_setfield_number(L, "iters",  iters);
+    l_setfield_number(L, "reps",   reps);
+    return 1;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+static const luaL_Reg lib_fns[] = {
+    {"now",     &now_timer},
+    {"measure", &measure_timer},
+    {NULL,      NULL},
+};
+
+LIB_EXPORT int luaopen_timer(lua_State *L)
+{
+    luaL_register(L, LIB_NAME, lib_fns); // [ timer ], reg(_G.timer, lib_fns)
+    return 1;
+}
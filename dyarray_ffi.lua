@@ -0,0 +1,64 @@
+-- LuaJIT FFI bindings for `dyarray`, so that hot loops can index the `values`
+-- buffer directly instead of calling into C for every element. Calls to
+-- C functions such as `a:get(i)` abort trace compilation, whereas FFI loads
+-- and stores compile down to plain machine loads and stores.
+--
+-- The C module keeps ownership of the buffer, so:
+--  * Keep a reference to the dyarray for as long as you use a pointer into it.
+--  * Re-fetch pointers after anything that can reallocate the buffer, such as
+--    `push()`, `resize()` or `insert()`. `view(a)` sidesteps this by pointing
+--    at the `DyArray` struct itself, whose `values` field is always current.
+--  * Nothing is bounds checked. Valid C indexes are `0` to `length - 1`.
+--
+--      local dyffi = require "dyarray_ffi"
+--      local v     = dyffi.view(a)
+--      for i = 0, v.length - 1 do
+--          v.values[i] = v.values[i] * 2
+--      end
+local ffi     = require "ffi"
+local dyarray = require "dyarray"
+
+-- Must match `DyArray` in `src/dyarray.h`.
+ffi.cdef [[
+typedef struct {
+    int     length;
+    int     capacity;
+    double *values;
+} DyArray;
+]]
+
+local DyArray_ptr = ffi.typeof("DyArray *")
+local double_ptr  = ffi.typeof("double *")
+
+local M = {}
+
+-- Pointer to the header of `a`. LuaJIT converts a userdata argument to a
+-- pointer to its payload, which for a dyarray is the `DyArray` struct.
+---@param a dyarray
+---@return ffi.cdata*
+function M.view(a)
+    return ffi.cast(DyArray_ptr, a)
+end
+
+-- Pointer to the first element plus the current length.
+---@param a dyarray
+---@return ffi.cdata*, integer
+function M.values(a)
+    local p, n = a:ptr()
+    return ffi.cast(double_ptr, p), n
+end
+
+-- Reference loop that the JIT compiles to a tight native loop.
+---@param a dyarray
+---@return number
+function M.sum(a)
+    local p, n = M.values(a)
+    local s    = 0
+    for i = 0, n - 1 do
+        s = s + p[i]
+    end
+    return s
+end
+
+M.dyarray = dyarray
+return M
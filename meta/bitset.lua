@@ -0,0 +1,47 @@
+---@meta
+
+-- Annotations for the `bitset` type. For more information see `src/bitset.c`.
+---@class bitset
+---@field [integer] boolean
+bitset = {}
+
+---@param n integer
+---@return bitset
+function bitset.new(n) end
+
+---@param i integer
+---@return boolean
+function bitset:test(i) end
+
+---@param i  integer
+---@param v? boolean Defaults to true.
+---@return bitset
+function bitset:set(i, v) end
+
+---@return integer
+function bitset:popcount() end
+
+-- Index of the first set bit at or after `i`, or nil.
+---@param i? integer
+---@return integer?
+function bitset:find_next(i) end
+
+---@param other bitset
+---@return bitset
+function bitset:band(other) end
+
+---@param other bitset
+---@return bitset
+function bitset:bor(other) end
+
+---@param other bitset
+---@return bitset
+function bitset:bxor(other) end
+
+---@return bitset
+function bitset:bnot() end
+
+---@return integer
+function bitset:length() end
+
+return bitset
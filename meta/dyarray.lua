@@ -2,57 +2,99 @@
 
 -- This is a mock implementation for the `dyarray` type.
 -- For more information see `src/dyarray.c`.
+--
+-- It is also the executable reference model for `bench/fuzz.lua`, so the
+-- behavior of every implemented method, including which calls throw, must
+-- match the C module.
 ---@class dyarray
 ---@field m_values   number[]
 ---@field m_length   integer
 ---@field m_capacity integer
 dyarray = {}
 
+local mt = {__index = dyarray}
+
+-- Same growth policy as `next_power_of_2()` in `src/dyarray.c`.
+---@param x integer
+local function next_power_of_2(x)
+    local n = 8
+    while n < x do
+        n = n * 2
+    end
+    return n
+end
+
+-- Convert a relative 1-based index to an absolute one, or throw.
+---@param self dyarray
+---@param i    integer
+local function check_index(self, i)
+    if i < 0 then
+        i = self.m_length + i + 1
+    end
+    if i < 1 or i > self.m_length then
+        error("bad argument #2 (index out of range)", 3)
+    end
+    return i
+end
+
 ---@param t? number[]|dyarray
 function dyarray.new(t)
     ---@type dyarray
-    local inst      = setmetatable({}, {__index = dyarray})
-    inst.m_values   = t or {}
-    inst.m_length   = t and #t or 0
-    inst.m_capacity = inst.m_length
+    local inst = setmetatable({m_values = {}, m_length = 0}, mt)
+    local src  = (getmetatable(t) == mt) and t.m_values or t or {}
+    local len  = (getmetatable(t) == mt) and t.m_length or #src
+    for i = 1, len, 1 do
+        inst.m_values[i] = src[i]
+    end
+    inst.m_length   = len
+    inst.m_capacity = next_power_of_2(len)
     return inst
 end
 
+function dyarray:copy()
+    return dyarray.new(self)
+end
+
 ---@param i integer
 function dyarray:get(i)
-    return self.m_values[i]
+    return self.m_values[check_index(self, i)]
 end
 
 ---@param i integer
 ---@param v number
 function dyarray:set(i, v)
-    self.m_values[i] = v
+    self.m_values[check_index(self, i)] = v
     return self
 end
 
 -- Mostly C code, not much Lua-equivalent representation!
 ---@param len integer
 function dyarray:resize(len)
-    self.m_capacity = len
+    if len < 0 then
+        error("Cannot resize to " .. len .. " elements", 2)
+    end
     -- If we extended, zero out the extended region.
     for i = self.m_length + 1, len, 1 do
         self.m_values[i] = 0
     end
+    for i = len + 1, self.m_length, 1 do
+        self.m_values[i] = nil
+    end
+    self.m_length   = len
+    self.m_capacity = next_power_of_2(len)
     return self
 end
 
+-- Unlike `table.insert()` this overwrites; `i` must already be in range.
 ---@param i integer
 ---@param v number
 function dyarray:insert(i, v)
-    -- Need to extend the buffer?
-    if i > self.m_length then
-        self:resize(i)
-    end
-    self.m_values[i] = v
-    return self
+    return self:set(i, v)
 end
 
+---@param i integer
 function dyarray:remove(i)
+    i = check_index(self, i)
     local v   = self.m_values[i]
     local len = self.m_length
     -- Shift all elements to the right, 1 position to the left.
@@ -65,10 +107,19 @@ end
 
 ---@param v number
 function dyarray:push(v)
-    return self:insert(self.m_length + 1, v)
+    local len = self.m_length
+    if len >= self.m_capacity then
+        self.m_capacity = next_power_of_2(len + 1)
+    end
+    self.m_values[len + 1] = v
+    self.m_length = len + 1
+    return self
 end
 
 function dyarray:pop()
+    if self.m_length <= 0 then
+        error("Nothing to pop, have " .. self.m_length .. " elements", 2)
+    end
     return self:remove(self.m_length)
 end
 
@@ -76,5 +127,507 @@ function dyarray:length()
     return self.m_length
 end
 
+-- Raw `values` buffer for LuaJIT's FFI, see `dyarray_ffi.lua`.
+-- Implemented only in C.
+---@return lightuserdata values, integer length
+function dyarray:ptr() end
+
+-- Closures bound to `self` that skip the type check, and in release builds
+-- also the bounds check. `i` must be in `[1, self:length()]`.
+-- Implemented only in C.
+---@return fun(i: integer): number get, fun(i: integer, v: number) set
+function dyarray:unsafe() end
+
+mt.__len = dyarray.length
+
+---@alias dyarray.scan_op   "sum"|"prod"|"max"|"min"
+---@alias dyarray.scan_kind "inclusive"|"exclusive"
+
+local scan_fns = {
+    sum  = {0,         function(acc, x) return acc + x end},
+    prod = {1,         function(acc, x) return acc * x end},
+    max  = {-math.huge, math.max},
+    min  = {math.huge,  math.min},
+}
+
+-- Pass `self` as `out` to scan in-place.
+---@param op    dyarray.scan_op
+---@param kind? dyarray.scan_kind
+---@param out?  dyarray
+---@return dyarray out
+function dyarray:scan(op, kind, out)
+    local identity, fn = scan_fns[op][1], scan_fns[op][2]
+    local acc = identity
+    out = out or dyarray.new()
+    for i = 1, self.m_length, 1 do
+        local nextacc = fn(acc, self.m_values[i])
+        out.m_values[i] = (kind == "exclusive") and acc or nextacc
+        acc = nextacc
+    end
+    out.m_length = self.m_length
+    return out
+end
+
+---@param out? dyarray
+function dyarray:cumsum(out)  return self:scan("sum", "inclusive", out) end
+
+---@param out? dyarray
+function dyarray:cumprod(out) return self:scan("prod", "inclusive", out) end
+
+---@param out? dyarray
+function dyarray:cummax(out)  return self:scan("max", "inclusive", out) end
+
+-- `order`-th forward difference, like `numpy.diff()`.
+---@param order? integer
+---@param out?   dyarray
+---@return dyarray out
+function dyarray:diff(order, out)
+    local len = self.m_length
+    order = math.min(order or 1, len)
+    out = out or dyarray.new()
+    for i = 1, len, 1 do
+        out.m_values[i] = self.m_values[i]
+    end
+    for k = 1, order, 1 do
+        for i = 1, len - k, 1 do
+            out.m_values[i] = out.m_values[i + 1] - out.m_values[i]
+        end
+    end
+    out.m_length = len - order
+    return out
+end
+
+-- The `k` largest values in descending order.
+---@param k integer
+---@return dyarray
+function dyarray:topk(k)
+    local t = {}
+    for i = 1, self.m_length, 1 do
+        t[i] = self.m_values[i]
+    end
+    table.sort(t, function(a, b) return a > b end)
+    for i = #t, k + 1, -1 do
+        t[i] = nil
+    end
+    return dyarray.new(t)
+end
+
+-- Comparison masks. Implemented only in C, see `src/dyarray.c`.
+---@param x number
+---@return bitset
+function dyarray:lt(x) end
+
+---@param x number
+---@return bitset
+function dyarray:le(x) end
+
+---@param x number
+---@return bitset
+function dyarray:gt(x) end
+
+---@param x number
+---@return bitset
+function dyarray:ge(x) end
+
+---@param x number
+---@return bitset
+function dyarray:eq(x) end
+
+---@param lo number
+---@param hi number
+---@return bitset
+function dyarray:between(lo, hi) end
+
+-- Keep only the values whose bit is set in `mask`.
+---@param mask bitset
+---@return dyarray
+function dyarray:compress(mask) end
+
+-- `out[i] = mask[i] and self[i] or other[i]`
+---@param mask  bitset
+---@param other dyarray|number
+---@return dyarray
+function dyarray:where(mask, other) end
+
+-- `out[i] = self[idx[i]]`
+---@param idx dyarray
+---@return dyarray
+function dyarray:gather(idx)
+    local out = dyarray.new()
+    for i = 1, idx.m_length, 1 do
+        local j = idx.m_values[i]
+        out:push(self.m_values[j < 0 and self.m_length + j + 1 or j])
+    end
+    return out
+end
+
+-- `self[idx[i]] = vals[i]`, or `vals` itself if it is a number.
+---@param idx  dyarray
+---@param vals dyarray|number
+---@return dyarray self
+function dyarray:scatter(idx, vals)
+    for i = 1, idx.m_length, 1 do
+        local j = idx.m_values[i]
+        j = j < 0 and self.m_length + j + 1 or j
+        self.m_values[j] = type(vals) == "number" and vals or vals.m_values[i]
+    end
+    return self
+end
+
+-- Fused `self:compress(self[pred](self, x, hi))`.
+---@param pred "lt"|"le"|"gt"|"ge"|"eq"|"between"
+---@param x    number
+---@param hi?  number
+---@return dyarray
+function dyarray:select(pred, x, hi) end
+
+-- Distinct values in ascending order. All NaNs count as one value, which
+-- comes last.
+---@return dyarray
+function dyarray:unique()
+    local t, seen, nan = {}, {}, nil
+    for i = 1, self.m_length, 1 do
+        local v = self.m_values[i]
+        if v ~= v then
+            nan = v
+        elseif not seen[v] then
+            seen[v] = true
+            t[#t + 1] = v
+        end
+    end
+    table.sort(t)
+    t[#t + 1] = nan
+    return dyarray.new(t)
+end
+
+---@return number
+function dyarray:mean()
+    local s = 0
+    for i = 1, self.m_length, 1 do
+        s = s + self.m_values[i]
+    end
+    return (self.m_length > 0) and s / self.m_length or 0 / 0
+end
+
+-- `ddof` is 0 for the population variance, 1 for the sample variance.
+---@param ddof? integer
+---@return number
+function dyarray:variance(ddof)
+    local n, mean, ss = self.m_length, self:mean(), 0
+    ddof = ddof or 0
+    for i = 1, n, 1 do
+        ss = ss + (self.m_values[i] - mean) ^ 2
+    end
+    return (n - ddof > 0) and ss / (n - ddof) or 0 / 0
+end
+
+---@param ddof? integer
+---@return number
+function dyarray:std(ddof)
+    return math.sqrt(self:variance(ddof))
+end
+
+-- Linear interpolation between closest ranks, ignoring NaNs. The C version
+-- selects instead of sorting and leaves `self` alone.
+---@param q number In `[0, 1]`.
+---@return number
+function dyarray:quantile(q)
+    local t = {}
+    for i = 1, self.m_length, 1 do
+        local v = self.m_values[i]
+        if v == v then
+            t[#t + 1] = v
+        end
+    end
+    if #t == 0 then
+        return 0 / 0
+    end
+    table.sort(t)
+    local h = q * (#t - 1)
+    local k = math.floor(h)
+    local v = t[k + 1]
+    return (k + 1 < #t) and v + (h - k) * (t[k + 2] - v) or v
+end
+
+---@param qs dyarray|number[]
+---@return dyarray
+function dyarray:quantiles(qs)
+    local t = {}
+    for i = 1, #qs, 1 do
+        t[i] = self:quantile(qs[i])
+    end
+    return dyarray.new(t)
+end
+
+---@return number
+function dyarray:median() return self:quantile(0.5) end
+
+-- Counts in `bins` equal-width bins over `[lo, hi]`, by default the range of
+-- the values. The last bin includes `hi`; values outside and NaNs are skipped.
+---@param bins integer
+---@param lo?  number
+---@param hi?  number
+---@return dyarray
+function dyarray:histogram(bins, lo, hi)
+    if not (lo and hi) then
+        local min, max = math.huge, -math.huge
+        for i = 1, self.m_length, 1 do
+            min = math.min(min, self.m_values[i])
+            max = math.max(max, self.m_values[i])
+        end
+        if not (min < max) then
+            min = (min <= max) and min - 0.5 or 0
+            max = min + 1
+        end
+        lo, hi = lo or min, hi or max
+    end
+    local t = {}
+    for b = 1, bins, 1 do
+        t[b] = 0
+    end
+    for i = 1, self.m_length, 1 do
+        local v = self.m_values[i]
+        if lo <= v and v <= hi then
+            local b = math.min(math.floor((v - lo) * bins / (hi - lo)), bins - 1)
+            t[b + 1] = t[b + 1] + 1
+        end
+    end
+    return dyarray.new(t)
+end
+
+-- Row-major matrix product: `out[m][n] = A[m][k] * B[k][n]`. `out` must not
+-- be `A` or `B`. The C version is cache-blocked; this is the plain loop.
+---@param A    dyarray
+---@param B    dyarray
+---@param m    integer
+---@param n    integer
+---@param k    integer
+---@param out? dyarray
+---@return dyarray
+function dyarray.gemm(A, B, m, n, k, out)
+    local a, b = A.m_values, B.m_values
+    out = out or dyarray.new()
+    for i = 0, m - 1 do
+        for j = 1, n do
+            local s = 0
+            for p = 0, k - 1 do
+                s = s + a[i * k + p + 1] * b[p * n + j]
+            end
+            out.m_values[i * n + j] = s
+        end
+    end
+    out.m_length = m * n
+    return out
+end
+
+-- Row-major matrix-vector product: `out[m] = A[m][n] * x[n]`.
+---@param A    dyarray
+---@param x    dyarray
+---@param m    integer
+---@param n    integer
+---@param out? dyarray
+---@return dyarray
+function dyarray.gemv(A, x, m, n, out)
+    local a, v = A.m_values, x.m_values
+    out = out or dyarray.new()
+    for i = 0, m - 1 do
+        local s = 0
+        for j = 1, n do
+            s = s + a[i * n + j] * v[j]
+        end
+        out.m_values[i + 1] = s
+    end
+    out.m_length = m
+    return out
+end
+
+-- Elementwise math. The C versions use their own polynomial kernels, see
+-- `src/dyarray.c` for how far they may stray from libm.
+local function map(self, fn, out)
+    out = out or dyarray.new()
+    for i = 1, self.m_length, 1 do
+        out.m_values[i] = fn(self.m_values[i])
+    end
+    out.m_length = self.m_length
+    return out
+end
+
+local function tanh(x)
+    if math.tanh then return math.tanh(x) end -- Removed in Lua 5.3.
+    if x ~= x then return x end
+    if math.abs(x) > 20 then return (x > 0) and 1 or -1 end
+    local e = math.exp(2 * x)
+    return (e - 1) / (e + 1)
+end
+
+-- Halfway cases round away from zero.
+local function round(x)
+    if x ~= x or x == math.huge or x == -math.huge then return x end
+    return (x < 0) and -math.floor(-x + 0.5) or math.floor(x + 0.5)
+end
+
+-- Pass `self` as `out` for any of these to work in-place.
+---@param out? dyarray
+---@return dyarray out
+function dyarray:exp(out)     return map(self, math.exp, out) end
+
+---@param out? dyarray
+---@return dyarray out
+function dyarray:log(out)     return map(self, math.log, out) end
+
+---@param out? dyarray
+---@return dyarray out
+function dyarray:sin(out)     return map(self, math.sin, out) end
+
+---@param out? dyarray
+---@return dyarray out
+function dyarray:cos(out)     return map(self, math.cos, out) end
+
+---@param out? dyarray
+---@return dyarray out
+function dyarray:tanh(out)    return map(self, tanh, out) end
+
+---@param out? dyarray
+---@return dyarray out
+function dyarray:sigmoid(out)
+    return map(self, function(x) return 1 / (1 + math.exp(-x)) end, out)
+end
+
+---@param out? dyarray
+---@return dyarray out
+function dyarray:floor(out)   return map(self, math.floor, out) end
+
+---@param out? dyarray
+---@return dyarray out
+function dyarray:ceil(out)    return map(self, math.ceil, out) end
+
+---@param out? dyarray
+---@return dyarray out
+function dyarray:round(out)   return map(self, round, out) end
+
+-- `out[i] = self[i] ^ p`, or `self[i] ^ p[i]` if `p` is a dyarray.
+---@param p    number|dyarray
+---@param out? dyarray
+---@return dyarray out
+function dyarray:pow(p, out)
+    if type(p) == "number" then
+        return map(self, function(x) return x ^ p end, out)
+    end
+    assert(p.m_length == self.m_length, "length mismatch")
+    out = out or dyarray.new()
+    for i = 1, self.m_length, 1 do
+        out.m_values[i] = self.m_values[i] ^ p.m_values[i]
+    end
+    out.m_length = self.m_length
+    return out
+end
+
+---@class dyarray.heap
+---@field push        fun(self: dyarray.heap, v: number, payload?: integer): dyarray.heap
+---@field pop         fun(self: dyarray.heap): number, integer?
+---@field peek        fun(self: dyarray.heap): number?, integer?
+---@field replace_top fun(self: dyarray.heap, v: number, payload?: integer): number, integer?
+---@field heapify     fun(self: dyarray.heap, src: dyarray, payloads?: dyarray): dyarray.heap
+---@field length      fun(self: dyarray.heap): integer
+
+-- Implemented only in C, see `src/dyarray.c`.
+---@param kind? "min"|"max"
+---@return dyarray.heap
+function dyarray.heap(kind) end
+
+---@class dyarray.rng
+---@field seed   fun(self: dyarray.rng, seed: integer): dyarray.rng
+---@field split  fun(self: dyarray.rng): dyarray.rng Independent stream; `self` jumps ahead.
+---@field random fun(self: dyarray.rng, m?: integer, n?: integer): number Like `math.random()`.
+
+-- Random numbers: xoshiro256++ in 4 lockstep streams. Implemented only in C,
+-- see `src/dyarray.c`. Every function takes an optional generator last;
+-- without one they share the module's, which `dyarray.seed()` reseeds.
+---@param seed? integer Default: drawn from the module's generator.
+---@return dyarray.rng
+function dyarray.rng(seed) end
+
+---@param seed integer
+function dyarray.seed(seed) end
+
+---@param n     integer
+---@param dist? "uniform"|"normal"
+---@param rng?  dyarray.rng
+---@return dyarray
+function dyarray.random(n, dist, rng) end
+
+-- Uniform on `[lo, hi)`, `[0, 1)` by default.
+---@param lo?  number
+---@param hi?  number
+---@param rng? dyarray.rng
+---@return dyarray self
+function dyarray:fill_uniform(lo, hi, rng) end
+
+---@param mu?    number
+---@param sigma? number
+---@param rng?   dyarray.rng
+---@return dyarray self
+function dyarray:fill_normal(mu, sigma, rng) end
+
+---@param rng? dyarray.rng
+---@return dyarray self
+function dyarray:shuffle(rng) end
+
+-- `k` elements without replacement, in no particular order.
+---@param k    integer
+---@param rng? dyarray.rng
+---@return dyarray
+function dyarray:sample(k, rng) end
+
+---@class dyarray.expr
+---@operator add(number|dyarray|dyarray.expr): dyarray.expr
+---@operator sub(number|dyarray|dyarray.expr): dyarray.expr
+---@operator mul(number|dyarray|dyarray.expr): dyarray.expr
+---@operator div(number|dyarray|dyarray.expr): dyarray.expr
+---@operator pow(number|dyarray|dyarray.expr): dyarray.expr
+---@operator unm: dyarray.expr
+---@operator len: integer
+---@field eval    fun(self: dyarray.expr, out?: dyarray): dyarray One fused pass; `out` may be an input.
+---@field reduce  fun(self: dyarray.expr, op: dyarray.scan_op): number
+---@field sum     fun(self: dyarray.expr): number
+---@field mean    fun(self: dyarray.expr): number
+---@field max     fun(self: dyarray.expr): number
+---@field min     fun(self: dyarray.expr): number
+---@field length  fun(self: dyarray.expr): integer
+---@field pow     fun(self: dyarray.expr, p: number|dyarray|dyarray.expr): dyarray.expr
+---@field abs     fun(self: dyarray.expr): dyarray.expr
+---@field sqrt    fun(self: dyarray.expr): dyarray.expr
+---@field exp     fun(self: dyarray.expr): dyarray.expr
+---@field log     fun(self: dyarray.expr): dyarray.expr
+---@field sin     fun(self: dyarray.expr): dyarray.expr
+---@field cos     fun(self: dyarray.expr): dyarray.expr
+---@field tanh    fun(self: dyarray.expr): dyarray.expr
+---@field sigmoid fun(self: dyarray.expr): dyarray.expr
+---@field floor   fun(self: dyarray.expr): dyarray.expr
+---@field ceil    fun(self: dyarray.expr): dyarray.expr
+---@field round   fun(self: dyarray.expr): dyarray.expr
+
+-- Lazy elementwise expression over `self`, e.g. `(a:lazy() * 2 + b):sum()`.
+-- Nothing is computed until `eval()` or a reduction, which then make a single
+-- pass over the inputs without temporaries. Inputs are read at that point and
+-- must all have the same length by then. Implemented only in C.
+---@return dyarray.expr
+function dyarray:lazy() end
+
+dyarray.expr = dyarray.lazy
+
+---@class dump_table.opts
+---@field depth? integer Tables nested deeper are written as `{...}`. Default 64.
+---@field sort?  boolean Write keys in order instead of `next()` order.
+---@field out?   "stdout"|"string"|file* Where to write, default `"stdout"`.
+
+-- Global set by `require "dyarray"`. Writes `t` as a table constructor; tables
+-- seen before (cycles, shared references) are written as `<ref path>`.
+-- Implemented only in C.
+---@param t     table
+---@param opts? dump_table.opts
+---@return string? s Only if `opts.out == "string"`.
+function dump_table(t, opts) end
+
 -- Convenience return value.
 return dyarray
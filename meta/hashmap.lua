@@ -0,0 +1,56 @@
+---@meta
+
+-- Annotations for the `hashmap` type. For more information see `src/hashmap.c`.
+---@class hashmap
+---@field [number] number
+hashmap = {}
+
+-- Preallocate room for `n` entries. A map holds at most 939524096 entries on
+-- 64-bit targets (58720256 on 32-bit), and larger counts throw.
+---@param n? integer
+---@return hashmap
+function hashmap.new(n) end
+
+---@param k number
+---@return number?
+function hashmap:get(k) end
+
+-- Assigning nil removes `k`, just like a Lua table.
+---@param k  number
+---@param v? number
+---@return hashmap
+function hashmap:set(k, v) end
+
+---@param k number
+---@return boolean
+function hashmap:has(k) end
+
+---@param k number
+---@return number? old
+function hashmap:remove(k) end
+
+---@param keys   dyarray
+---@param values dyarray
+---@return hashmap
+function hashmap:insert_many(keys, values) end
+
+-- Missing keys yield `default`, which is NaN if not given.
+---@param keys     dyarray
+---@param default? number
+---@return dyarray
+function hashmap:get_many(keys, default) end
+
+---@param n integer
+---@return hashmap
+function hashmap:reserve(n) end
+
+---@return hashmap
+function hashmap:clear() end
+
+---@return integer
+function hashmap:length() end
+
+---@return fun(): number, number
+function hashmap:pairs() end
+
+return hashmap
@@ -0,0 +1,122 @@
+---@meta
+
+-- Annotations for the `ndarray` type. For more information see
+-- `src/ndarray.c`.
+---@class ndarray
+---@operator len: integer
+---@field [integer]   ndarray|number Row `i`, or element `i` if 1-D.
+---@field [integer[]] number         Element at the given indexes.
+ndarray = {}
+
+-- Zeroed array of the given shape, or a row-major view of the first
+-- `prod(shape)` elements of `base`, which it then shares.
+---@param shape integer|integer[]
+---@param base? dyarray
+---@return ndarray
+function ndarray.new(shape, base) end
+
+---@param ... integer One index per dimension.
+---@return number
+function ndarray:get(...) end
+
+-- `a:set(i, j, v)` for a 2-D array.
+---@param ... integer|number Indexes, then the value.
+---@return ndarray
+function ndarray:set(...) end
+
+---@return integer ...
+function ndarray:shape() end
+
+-- In elements, one per dimension.
+---@return integer ...
+function ndarray:strides() end
+
+---@return integer
+function ndarray:ndim() end
+
+-- Number of elements.
+---@return integer
+function ndarray:size() end
+
+---@return boolean
+function ndarray:is_contiguous() end
+
+-- The shared buffer, and the index in it of the first element.
+---@return dyarray base, integer start
+function ndarray:base() end
+
+--- VIEWS --- {{{
+
+-- View with a new shape; one dimension may be `-1`. Contiguous arrays only.
+---@param shape integer|integer[]
+---@return ndarray
+function ndarray:reshape(shape) end
+
+-- View with the dimensions permuted, by default reversed.
+---@param ... integer
+---@return ndarray
+function ndarray:transpose(...) end
+
+-- View with dimension `axis` fixed at `i`. A number if `self` is 1-D.
+---@param axis integer
+---@param i    integer
+---@return ndarray|number
+function ndarray:select(axis, i) end
+
+---@param i integer
+---@return ndarray|number
+function ndarray:row(i) end
+
+---@param j integer
+---@return ndarray|number
+function ndarray:col(j) end
+
+--- }}}
+
+--- COPIES --- {{{
+
+-- Contiguous copy with its own buffer.
+---@return ndarray
+function ndarray:copy() end
+
+-- `self` if contiguous, else `self:copy()`.
+---@return ndarray
+function ndarray:contiguous() end
+
+-- Elements in row-major order.
+---@return dyarray
+function ndarray:flatten() end
+
+--- }}}
+
+--- ELEMENTWISE --- {{{
+
+-- `out = self + other`, where `out` defaults to a new array and may be `self`.
+---@param other ndarray|number
+---@param out?  ndarray
+---@return ndarray
+function ndarray:add(other, out) end
+
+---@param other ndarray|number
+---@param out?  ndarray
+---@return ndarray
+function ndarray:sub(other, out) end
+
+---@param other ndarray|number
+---@param out?  ndarray
+---@return ndarray
+function ndarray:mul(other, out) end
+
+---@param other ndarray|number
+---@param out?  ndarray
+---@return ndarray
+function ndarray:div(other, out) end
+
+---@param v number
+---@return ndarray
+function ndarray:fill(v) end
+
+---@return number
+function ndarray:sum() end
+
+--- }}}
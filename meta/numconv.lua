@@ -0,0 +1,38 @@
+---@meta
+
+-- Annotations for the `numconv` module. For more information see
+-- `src/numconv.c`.
+numconv = {}
+
+-- Parse each string of `strings`. With `base` 0, the default, `0x` and `0b`
+-- prefixes are detected and anything `tonumber()` takes is accepted. Invalid
+-- entries become NaN and are counted in `nbad`.
+---@param strings (string|number)[]
+---@param base?   integer 0 or 2 to 36.
+---@return dyarray values, integer nbad
+function numconv.parse_many(strings, base) end
+
+-- Format each element of `values`, separated by `sep` (default `"\n"`).
+-- Bases other than 10 only take integers; 16 and 2 get a `0x`/`0b` prefix.
+---@param values dyarray
+---@param base?  integer 2 to 36, default 10.
+---@param sep?   string
+---@param out?   strbuf Appended to if given.
+---@return strbuf
+function numconv.format_many(values, base, sep, out) end
+
+-- Index of the highest set bit of `n > 0`.
+---@param n integer
+---@return integer
+function numconv.ilog2(n) end
+
+-- Smallest power of 2 no less than `n`.
+---@param n integer
+---@return integer
+function numconv.next_pow2(n) end
+
+---@param n integer
+---@return integer
+function numconv.popcount(n) end
+
+return numconv
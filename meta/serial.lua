@@ -0,0 +1,19 @@
+---@meta
+
+-- Annotations for the `serial` module. For more information see `src/serial.c`.
+serial = {}
+
+-- Encode nil, booleans, numbers, strings, dyarrays and tables of those.
+-- Shared and cyclic tables are preserved.
+---@param v any
+---@return string
+function serial.pack(v) end
+
+-- Decode the value packed at byte `pos` of `s`, default 1. Also returns the
+-- position just past it.
+---@param s    string
+---@param pos? integer
+---@return any v, integer next
+function serial.unpack(s, pos) end
+
+return serial
@@ -0,0 +1,52 @@
+---@meta
+
+-- Annotations for the `sketch` module. For more information see
+-- `src/sketch.c`. Quantiles are within a relative error of `alpha` of the
+-- exact ones; NaNs and infinities are not counted.
+sketch = {}
+
+---@class sketch
+
+---@param alpha?    number  Relative accuracy in `[1e-4, 1)`, default 0.01.
+---@param max_bins? integer Per sign, default 2048. Past this the buckets
+---                         closest to zero are folded together.
+---@return sketch
+function sketch.new(alpha, max_bins) end
+
+-- Rebuild a sketch from the string given by `sketch:pack()`.
+---@param s string
+---@return sketch
+function sketch.unpack(s) end
+
+-- Add `x`, `w` times if given.
+---@param x  number
+---@param w? number
+---@return sketch self
+function sketch:add(x, w) end
+
+---@param values dyarray
+---@return sketch self
+function sketch:add_many(values) end
+
+-- NaN if nothing was added.
+---@param q number In `[0, 1]`.
+---@return number
+function sketch:quantile(q) end
+
+-- Add everything in `other`, which must have the same `alpha`.
+---@param other sketch
+---@return sketch self
+function sketch:merge(other) end
+
+---@return number
+function sketch:count() end
+
+---@return number
+function sketch:sum() end
+
+-- Exact minimum and maximum, or nothing if nothing was added.
+---@return number? min, number? max
+function sketch:range() end
+
+---@return string
+function sketch:pack() end
@@ -0,0 +1,120 @@
+---@meta
+
+-- Annotations for the `sparse` module. For more information see
+-- `src/sparse.c`. Indexes are 1-based; duplicates given to the constructors
+-- are summed.
+sparse = {}
+
+---@class sparse.vector
+---@operator len: integer
+
+---@class sparse.csr
+
+---@param dim      integer
+---@param indices? dyarray|integer[]
+---@param values?  dyarray|number[]
+---@return sparse.vector
+function sparse.vector(dim, indices, values) end
+
+-- Entries of `a` whose magnitude exceeds `eps`, default 0.
+---@param a    dyarray
+---@param eps? number
+---@return sparse.vector
+function sparse.from_dense(a, eps) end
+
+-- From coordinate triplets, in any order.
+---@param nrows  integer
+---@param ncols  integer
+---@param rows   dyarray|integer[]
+---@param cols   dyarray|integer[]
+---@param values dyarray|number[]
+---@return sparse.csr
+function sparse.csr(nrows, ncols, rows, cols, values) end
+
+-- Entries of the row-major `nrows x ncols` matrix `a` whose magnitude exceeds
+-- `eps`, default 0.
+---@param a     dyarray
+---@param nrows integer
+---@param ncols integer
+---@param eps?  number
+---@return sparse.csr
+function sparse.csr_from_dense(a, nrows, ncols, eps) end
+
+--- VECTOR METHODS --- {{{
+
+---@return integer
+function sparse.vector:dim() end
+
+-- Number of stored entries.
+---@return integer
+function sparse.vector:nnz() end
+
+---@param i integer
+---@return number
+function sparse.vector:get(i) end
+
+---@return dyarray
+function sparse.vector:indices() end
+
+---@return dyarray
+function sparse.vector:values() end
+
+-- With a dense `x` this costs `O(nnz)`.
+---@param x dyarray|sparse.vector
+---@return number
+function sparse.vector:dot(x) end
+
+-- `self + alpha * other`, as a new vector.
+---@param other  sparse.vector
+---@param alpha? number Default 1.
+---@return sparse.vector
+function sparse.vector:add(other, alpha) end
+
+-- In place.
+---@param s number
+---@return sparse.vector
+function sparse.vector:scale(s) end
+
+---@return dyarray
+function sparse.vector:todense() end
+
+--- }}}
+
+--- CSR METHODS --- {{{
+
+---@return integer nrows, integer ncols
+function sparse.csr:shape() end
+
+---@return integer
+function sparse.csr:nnz() end
+
+---@param i integer
+---@param j integer
+---@return number
+function sparse.csr:get(i, j) end
+
+-- `out = self * x`; `x` is dense with at least `ncols` elements.
+---@param x    dyarray
+---@param out? dyarray
+---@return dyarray
+function sparse.csr:mul(x, out) end
+
+---@param i integer
+---@return sparse.vector
+function sparse.csr:row(i) end
+
+---@param other  sparse.csr
+---@param alpha? number Default 1.
+---@return sparse.csr
+function sparse.csr:add(other, alpha) end
+
+-- In place.
+---@param s number
+---@return sparse.csr
+function sparse.csr:scale(s) end
+
+-- Row-major.
+---@return dyarray
+function sparse.csr:todense() end
+
+--- }}}
@@ -0,0 +1,46 @@
+---@meta
+
+-- Annotations for the `strbuf` type. For more information see `src/strbuf.c`.
+---@class strbuf
+strbuf = {}
+
+---@param capacity? integer Bytes to preallocate.
+---@return strbuf
+function strbuf.new(capacity) end
+
+---@param ... string|number
+---@return strbuf
+function strbuf:append(...) end
+
+---@param n number
+---@return strbuf
+function strbuf:append_number(n) end
+
+-- Append `n` copies of `s`, separated by `sep`.
+---@param s    string
+---@param n    integer
+---@param sep? string
+---@return strbuf
+function strbuf:rep(s, n, sep) end
+
+-- Make room for `n` more bytes.
+---@param n integer
+---@return strbuf
+function strbuf:reserve(n) end
+
+-- Empty the buffer, keeping its allocation.
+---@return strbuf
+function strbuf:clear() end
+
+---@return string
+function strbuf:tostring() end
+
+-- Write the contents to `file`, default `io.stdout`, without making a string.
+---@param file? file*
+---@return strbuf
+function strbuf:write(file) end
+
+---@return integer
+function strbuf:length() end
+
+return strbuf
@@ -1,22 +1,23 @@
+local strbuf   = require "strbuf"
+local numconv  = require "numconv"
 local prefixes = {"0x1", "0x2", "0x4", "0x8"}
 local maxzeros = tonumber(arg[1]) or 4
 local hexes    = {n = 0}
+local buf      = strbuf.new()
 
 -- For each some amount of zeroes...
 for nzeroes = 0, maxzeros, 1 do
     -- For each "0x" <n> prefix...
     for _, prefix in ipairs(prefixes) do
-        local t = {n = 1, prefix}
-        -- Populate an individual prefix with the current amount of zeroes.
-        for _ = 1, nzeroes, 1 do
-            t.n = t.n + 1
-            t[t.n] = '0'
-        end
+        -- Build the literal in place instead of concatenating a table of
+        -- fragments, which would make a Lua string for every '0'.
         hexes.n = hexes.n + 1
-        hexes[hexes.n] = table.concat(t)
+        hexes[hexes.n] = buf:clear():append(prefix):rep('0', nzeroes):tostring()
     end
 end
 
+-- One call for all of them rather than a `tonumber()` each.
+local values = numconv.parse_many(hexes)
 for i, v in ipairs(hexes) do
-    print(i, v, "=>", tonumber(v))
+    print(i, v, "=>", values[i])
 end
@@ -0,0 +1,330 @@
+/**
+ * @name    Packed Bitset
+ *
+ * @brief   A fixed-length array of booleans stored 1 bit per element, 64 bits
+ *          to a word. Besides plain indexing, whole-set operations work a word
+ *          at a time so they touch 1/64th of the memory a table would.
+ *
+ * @note    `and`, `or` and `not` are reserved words in Lua so the logical
+ *          operations are named `band`, `bor`, `bxor` and `bnot` instead, same
+ *          as the LuaJIT `bit` library.
+ *
+ * @note    Masks are usually created by `dyarray` comparison methods such as
+ *          `a:lt(x)` and consumed by `a:compress(mask)` or `a:where(mask, b)`.
+ */
+#define LIB_NAME "bitset"
+#include "common.h"
+#include "bitset.h"
+
+// HELPERS ----------------------------------------------------------------- {{{
+
+static Bitset *l_checkarg_bitset(lua_State *L, int argn)
+{
+    return bitset_check(L, argn);
+}
+
+// Convert a Lua 1-based index to a C 0-based index, negative counts from the end.
+static int l_checkarg_index(lua_State *L, Bitset *self, int argn)
+{
+    int i = luaL_checkint(L, argn);
+    i = (i < 0) ? self->length + i : i - 1;
+    luaL_argcheck(L, 0 <= i && i < self->length, argn, "index out of range");
+    return i;
+}
+
+static int bad_field(lua_State *L, const char *field)
+{
+    return LIB_ERROR(L, "Unknown field " LUA_QS, field);
+}
+
+// }}} -------------------------------------------------------------------------
+
+// METHODS ---------------------------------------------------------------- {{{1
+
+/**
+ * @exception <args[1]>:         type
+ *            bitset_push_new(): memory
+ *
+ * @note    Stack usage:    [ -1, +1, m|v ]
+ *          Stack before:   [ n: integer ]
+ *          Stack after:    [ self: bitset ]
+ */
+static int new_bitset(lua_State *L)
+{
+    int n = luaL_checkint(L, 1);
+    luaL_argcheck(L, n >= 0, 1, "negative length");
+    DBG_PRINTFLN("new " LIB_QNAME " of length %d", n);
+    bitset_push_new(L, n);
+    return 1;
+}
+
+/**
+ * @exception <args[:]>: type
+ *            <args[2]>: index
+ *
+ * @note    Stack usage:    [ -2, +1, v ]
+ *          Stack before:   [ self: bitset, i: integer ]
+ *          Stack after:    [ self[i]: boolean ]
+ */
+static int test_bitset(lua_State *L)
+{
+    Bitset *self = l_checkarg_bitset(L, 1);
+    int     i    = l_checkarg_index(L, self, 2);
+    lua_pushboolean(L, cast_int(bitset_test(self, i)));
+    return 1;
+}
+
+/**
+ * @exception <args[:]>: type
+ *            <args[2]>: index
+ *
+ * @note    Stack usage:    [ -(2|3), +1, v ]
+ *          Stack before:   [ self: bitset, i: integer, v: boolean? ]
+ *          Stack after:    [ self ]
+ *          Side effects:   self[i] = v, where `v` defaults to true.
+ */
+static int set_bitset(lua_State *L)
+{
+    Bitset  *self = l_checkarg_bitset(L, 1);
+    int      i    = l_checkarg_index(L, self, 2);
+    uint64_t bit  = UINT64_C(1) << (i % BITSET_WORD_BITS);
+
+    if (lua_isnone(L, 3) || lua_toboolean(L, 3))
+        self->words[i / BITSET_WORD_BITS] |= bit;
+    else
+        self->words[i / BITSET_WORD_BITS] &= ~bit;
+    lua_settop(L, 1); // [ self ]
+    return 1;
+}
+
+/**
+ * @note    Stack usage:    [ -1, +1, v ]
+ *          Stack before:   [ self: bitset ]
+ *          Stack after:    [ count: integer ]
+ */
+static int popcount_bitset(lua_State *L)
+{
+    Bitset *self  = l_checkarg_bitset(L, 1);
+    int     n     = bitset_nwords(self->length);
+    int     count = 0;
+    for (int i = 0; i < n; i++)
+        count += popcount_u64(self->words[i]);
+    lua_pushinteger(L, count);
+    return 1;
+}
+
+/**
+ * @brief   Find the first set bit at or after index `i`.
+ *
+ * @exception <args[:]>: type
+ *
+ * @note    Stack usage:    [ -(1|2), +1, v ]
+ *          Stack before:   [ self: bitset, i: integer? ]
+ *          Stack after:    [ j: integer? ]
+ *
+ * @note    `i` defaults to 1. Returns nil if there are no more set bits, so
+ *          `j = b:find_next(j + 1)` can be looped until it returns nil.
+ */
+static int find_next_bitset(lua_State *L)
+{
+    Bitset *self = l_checkarg_bitset(L, 1);
+    int     i    = luaL_optint(L, 2, 1) - 1;
+    int     n    = bitset_nwords(self->length);
+    int     w;
+
+    luaL_argcheck(L, i >= 0, 2, "index out of range");
+    if (i >= self->length) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    // Mask off the bits below `i` in the first word only.
+    w = i / BITSET_WORD_BITS;
+    for (uint64_t word = self->words[w] & (~UINT64_C(0) << (i % BITSET_WORD_BITS));;) {
+        if (word != 0) {
+            lua_pushinteger(L, w * BITSET_WORD_BITS + ctz_u64(word) + 1);
+            return 1;
+        }
+        if (++w >= n)
+            break;
+        word = self->words[w];
+    }
+    lua_pushnil(L);
+    return 1;
+}
+
+// BITWISE OPERATIONS ----------------------------------------------------- {{{2
+
+typedef enum {
+    BITWISE_AND,
+    BITWISE_OR,
+    BITWISE_XOR,
+} BitwiseOp;
+
+/**
+ * @exception <args[:]>:         type
+ *            <args[2]>:         length mismatch
+ *            bitset_push_new(): memory
+ *
+ * @note    Stack usage:    [ -2, +1, m|v ]
+ *          Stack before:   [ self: bitset, other: bitset ]
+ *          Stack after:    [ self op other: bitset ]
+ */
+static int c_bitwise_bitset(lua_State *L, BitwiseOp op)
+{
+    Bitset   *self  = l_checkarg_bitset(L, 1);
+    Bitset   *other = l_checkarg_bitset(L, 2);
+    int       n     = bitset_nwords(self->length);
+    uint64_t *a     = self->words;
+    uint64_t *b     = other->words;
+    uint64_t *dst;
+
+    luaL_argcheck(L, other->length == self->length, 2, "length mismatch");
+    dst = bitset_push_new(L, self->length)->words;
+    switch (op) {
+    case BITWISE_AND: for (int i = 0; i < n; i++) dst[i] = a[i] & b[i]; break;
+    case BITWISE_OR:  for (int i = 0; i < n; i++) dst[i] = a[i] | b[i]; break;
+    case BITWISE_XOR: for (int i = 0; i < n; i++) dst[i] = a[i] ^ b[i]; break;
+    }
+    return 1;
+}
+
+static int band_bitset(lua_State *L)
+{
+    return c_bitwise_bitset(L, BITWISE_AND);
+}
+
+static int bor_bitset(lua_State *L)
+{
+    return c_bitwise_bitset(L, BITWISE_OR);
+}
+
+static int bxor_bitset(lua_State *L)
+{
+    return c_bitwise_bitset(L, BITWISE_XOR);
+}
+
+/**
+ * @note    Stack usage:    [ -1, +1, m|v ]
+ *          Stack before:   [ self: bitset ]
+ *          Stack after:    [ ~self: bitset ]
+ */
+static int bnot_bitset(lua_State *L)
+{
+    Bitset   *self = l_checkarg_bitset(L, 1);
+    int       n    = bitset_nwords(self->length);
+    uint64_t *dst  = bitset_push_new(L, self->length)->words;
+
+    for (int i = 0; i < n; i++)
+        dst[i] = ~self->words[i];
+
+    // Keep the unused tail bits cleared so `popcount()` stays correct.
+    if (n > 0)
+        dst[n - 1] &= bitset_tail_mask(self->length);
+    return 1;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+static int length_bitset(lua_State *L)
+{
+    lua_pushinteger(L, l_checkarg_bitset(L, 1)->length);
+    return 1;
+}
+
+/**
+ * @note    Stack usage:    [ -2, +1, v ]
+ *          Stack before:   [ self: bitset, key: string ]
+ *          Stack after:    [ bitset[key]: function ]
+ */
+static int get_field(lua_State *L)
+{
+    const char *s = luaL_checkstring(L, 2);
+    lua_getglobal(L, LIB_NAME); // [ self, key, bitset ]
+    lua_getfield(L, -1, s);     // [ self, key, bitset, bitset[key] ]
+    return lua_isnil(L, -1) ? bad_field(L, s) : 1;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// METATABLES ------------------------------------------------------------- {{{1
+
+/**
+ * @note    Stack usage:    [ -1, +1, m|v ]
+ *          Stack before:   [ self ]
+ *          Stack after:    [ tostring(self) ]
+ */
+static int mt_tostring(lua_State *L)
+{
+    Bitset     *self = l_checkarg_bitset(L, 1);
+    int         len  = self->length;
+    luaL_Buffer buf;
+
+    luaL_buffinit(L, &buf);
+    lua_pushfstring(L, LIB_MESSAGE("length = %d, bits = ", len));
+    luaL_addvalue(&buf); // [ self, fmt ] -> [ self ]
+    for (int i = 0; i < len; i++)
+        luaL_addchar(&buf, bitset_test(self, i) ? '1' : '0');
+    luaL_pushresult(&buf);
+    return 1;
+}
+
+/**
+ * @note    Stack usage:  [ -2, +1, v ]
+ *          Stack before: [ self: bitset, key: number|string ]
+ *          Stack after:  [ self[key]: boolean|function ]
+ */
+static int mt_index(lua_State *L)
+{
+    switch (lua_type(L, 2)) {
+    case LUA_TNUMBER: return test_bitset(L);
+    case LUA_TSTRING: return get_field(L);
+    default:          break;
+    }
+    return bad_field(L, luaL_typename(L, 2));
+}
+
+static int mt_gc(lua_State *L)
+{
+    Bitset *self = l_checkarg_bitset(L, 1);
+    DBG_PRINTFLN("free bitset of length %d", self->length);
+    if (self->words != NULL)
+        free_pointer(L, self->words, size_of_words(self->length));
+    return 0;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+static const luaL_Reg lib_fns[] = {
+    {"new",         &new_bitset},
+    {"test",        &test_bitset},
+    {"set",         &set_bitset},
+    {"popcount",    &popcount_bitset},
+    {"find_next",   &find_next_bitset},
+
+    // Whole-set logical operations
+    {"band",        &band_bitset},
+    {"bor",         &bor_bitset},
+    {"bxor",        &bxor_bitset},
+    {"bnot",        &bnot_bitset},
+
+    {"length",      &length_bitset},
+    {NULL,          NULL},
+};
+
+static const luaL_Reg mt_fns[] = {
+    {"__index",    &mt_index},
+    {"__newindex", &set_bitset},
+    {"__tostring", &mt_tostring},
+    {"__len",      &length_bitset},
+    {"__gc",       &mt_gc},
+    {NULL,         NULL},
+};
+
+LIB_EXPORT int luaopen_bitset(lua_State *L)
+{
+    luaL_newmetatable(L, LIB_MTNAME);    // [ mt ]
+    luaL_register(L, NULL, mt_fns);      // [ mt ], reg(mt, mt_fns)
+    luaL_register(L, LIB_NAME, lib_fns); // [ mt, bitset ], reg(_G.bitset, lib_fns)
+    return 1;
+}
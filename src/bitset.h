@@ -0,0 +1,82 @@
+/**
+ * @brief   Layout of the `bitset` userdata, shared with other C modules so
+ *          that they can produce and consume masks without going through Lua.
+ *
+ * @note    Include this after `common.h`.
+ */
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <stdint.h>
+
+#define BITSET_MTNAME           "C_Modules" "bitset"
+#define BITSET_WORD_BITS        64
+
+typedef struct {
+    int       length; // #Bits.
+    uint64_t *words;  // Bits past `length` in the last word are always 0.
+} Bitset;
+
+#define bitset_nwords(n)        (((n) + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS)
+#define size_of_words(n)        size_of_array(cast(uint64_t *, NULL), bitset_nwords(n))
+#define bitset_test(self, i)    (((self)->words[(i) / BITSET_WORD_BITS] >> ((i) % BITSET_WORD_BITS)) & 1)
+
+// Mask with only the bits below `length % 64` set, or all bits if that is 0.
+static inline uint64_t bitset_tail_mask(int length)
+{
+    int r = length % BITSET_WORD_BITS;
+    return (r == 0) ? ~UINT64_C(0) : (UINT64_C(1) << r) - 1;
+}
+
+/**
+ * @brief   Like `luaL_checkudata()`, this throws if `args[argn]` is not a
+ *          bitset.
+ */
+static inline Bitset *bitset_check(lua_State *L, int argn)
+{
+    return luaL_checkudata(L, argn, BITSET_MTNAME);
+}
+
+/**
+ * @brief   Create a bitset of `n` cleared bits. If the `bitset` module has not
+ *          been loaded yet we `require` it so its metatable is registered.
+ *
+ * @exception new_pointer(), require(): memory, other
+ *
+ * @note    Stack usage:    [ 0, +1, m|e ]
+ *          Stack before:   [ ...args ]
+ *          Stack after:    [ ...args, self ]
+ *
+ * @note    The module must be loaded before the userdata is created: Lua 5.1
+ *          and LuaJIT finalize newest first when closing, so a bitset older
+ *          than the library would run its `__gc` after the library has been
+ *          unloaded.
+ */
+static inline Bitset *bitset_push_new(lua_State *L, int n)
+{
+    Bitset *self;
+
+    luaL_getmetatable(L, BITSET_MTNAME); // [ ...args, mt ]
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);                   // [ ...args ]
+        lua_getglobal(L, "require");     // [ ...args, require ]
+        lua_pushliteral(L, "bitset");    // [ ...args, require, "bitset" ]
+        lua_call(L, 1, 0);               // [ ...args ]
+        luaL_getmetatable(L, BITSET_MTNAME);
+    }
+    self = lua_newuserdata(L, sizeof(*self)); // [ ...args, mt, self ]
+    self->length = 0;
+    self->words  = NULL;
+    lua_insert(L, -2);                   // [ ...args, self, mt ]
+    lua_setmetatable(L, -2);             // [ ...args, self ] ; setmetatable(self, mt)
+
+    self->words = new_pointer(L, size_of_words(n));
+    for (int i = 0; i < bitset_nwords(n); i++)
+        self->words[i] = 0;
+    self->length = n;
+    return self;
+}
+
+#endif // BITSET_H
@@ -1,5 +1,9 @@
 #include <lua.h>
 #include <lauxlib.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 
 #ifndef LIB_NAME
 #error Please define LIB_NAME as the desired library name before including.
@@ -45,6 +49,79 @@
 #define cast_int(expr)      cast(int, expr)
 #define size_of_array(T, n) (sizeof((T)[0]) * (n))
 
+// LUA VERSION COMPATIBILITY ----------------------------------------------- {{{
+
+// The modules are written against the Lua 5.1 API, which LuaJIT also
+// implements. For 5.2 and later we map the handful of removed functions onto
+// their replacements so that the sources need no version checks of their own.
+// https://www.lua.org/manual/5.2/manual.html#8.3
+// https://www.lua.org/manual/5.3/manual.html#8.3
+// https://www.lua.org/manual/5.4/manual.html#8.3
+
+#if LUA_VERSION_NUM >= 502
+
+#define lua_objlen(L, i)        lua_rawlen(L, i)
+
+/**
+ * @brief   Lua 5.1's `luaL_register()`: with a non-NULL `libname`, get or
+ *          create the global table `libname` and push it; then register the
+ *          functions in `l` into the table on top of the stack.
+ *
+ * @note    Unlike 5.1, this does not go through `package.loaded`. Our modules
+ *          are loaded with `require()` which records the result anyway.
+ *
+ * @note    Stack usage:    [ -0, +(0|1), m ]
+ */
+static inline void compat_register(lua_State *L, const char *libname, const luaL_Reg *l)
+{
+    if (libname != NULL) {
+        lua_getglobal(L, libname); // [ _G[libname] ]
+        if (!lua_istable(L, -1)) {
+            lua_pop(L, 1);             // []
+            lua_newtable(L);           // [ lib ]
+            lua_pushvalue(L, -1);      // [ lib, lib ]
+            lua_setglobal(L, libname); // [ lib ] ; _G[libname] = lib
+        }
+    }
+    luaL_setfuncs(L, l, 0);
+}
+
+// 5.2 may have its own `luaL_register()` under `LUA_COMPAT_MODULE`.
+#undef luaL_register
+#define luaL_register(L, libname, l)    compat_register(L, libname, l)
+
+static inline int compat_typerror(lua_State *L, int argn, const char *tname)
+{
+    const char *msg = lua_pushfstring(L, "%s expected, got %s",
+                                      tname, luaL_typename(L, argn));
+    return luaL_argerror(L, argn, msg);
+}
+
+#define luaL_typerror(L, argn, tname)   compat_typerror(L, argn, tname)
+
+#else  // LUA_VERSION_NUM < 502
+
+// 5.2's `luaL_setfuncs()`: register `l` into the table below the `nup`
+// upvalues on top of the stack, then pop them. 5.1 and LuaJIT do the same
+// through `luaL_openlib()` when given no library name.
+#define luaL_setfuncs(L, l, nup)        luaL_openlib(L, NULL, l, nup)
+
+#endif // LUA_VERSION_NUM >= 502
+
+// Removed in 5.3 unless built with `LUA_COMPAT_APIINTCASTS`.
+#ifndef luaL_checkint
+#define luaL_checkint(L, argn)          cast_int(luaL_checkinteger(L, argn))
+#define luaL_optint(L, argn, def)       cast_int(luaL_optinteger(L, argn, def))
+#endif
+
+// Removed in 5.4.
+#ifndef LUA_QL
+#define LUA_QL(x)   "'" x "'"
+#define LUA_QS      LUA_QL("%s")
+#endif
+
+// }}} -------------------------------------------------------------------------
+
 static inline void *resize_pointer(lua_State *L, void *hint, size_t osz, size_t nsz)
 {
     void     *ctx;
@@ -59,3 +136,126 @@ static inline void *resize_pointer(lua_State *L, void *hint, size_t osz, size_t
 
 #define new_pointer(L, sz)          resize_pointer(L, NULL, 0, sz)
 #define free_pointer(L, ptr, sz)    resize_pointer(L, ptr, sz, 0)
+
+/**
+ * @brief   Like `luaL_checkudata()`, but compares the metatable of
+ *          `args[argn]` against the one at `mt_idx` instead of fetching it
+ *          from the registry by name, which hashes `tname` on every call.
+ *          `tname` is only used for the error message.
+ *
+ * @note    `mt_idx` must be an absolute or pseudo-index, since this pushes
+ *          onto the stack. Modules pass the upvalue holding their metatable.
+ *
+ * @note    Stack usage:    [ -0, +0, v ]
+ */
+static inline void *l_checkarg_udata(lua_State *L, int argn, int mt_idx, const char *tname)
+{
+    void *p = lua_touserdata(L, argn);
+    if (p != NULL && lua_getmetatable(L, argn)) { // [ ...args, mt ]
+        int ok = lua_rawequal(L, -1, mt_idx);
+        lua_pop(L, 1);                             // [ ...args ]
+        if (ok)
+            return p;
+    }
+    luaL_typerror(L, argn, tname);
+    return NULL;
+}
+
+// BIT TWIDDLING ----------------------------------------------------------- {{{
+
+#ifdef _MSC_VER
+
+#include <intrin.h>
+
+// Undefined for `x == 0`.
+static inline int ctz_u64(uint64_t x)
+{
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return cast_int(i);
+}
+
+static inline int popcount_u64(uint64_t x)
+{
+    return cast_int(__popcnt64(x));
+}
+
+// Index of the highest set bit. Undefined for `x == 0`.
+static inline int ilog2_u64(uint64_t x)
+{
+    unsigned long i;
+    _BitScanReverse64(&i, x);
+    return cast_int(i);
+}
+
+#else  // _MSC_VER not defined.
+
+// Undefined for `x == 0`.
+static inline int ctz_u64(uint64_t x)
+{
+    return __builtin_ctzll(x);
+}
+
+static inline int popcount_u64(uint64_t x)
+{
+    return __builtin_popcountll(x);
+}
+
+// Index of the highest set bit. Undefined for `x == 0`.
+static inline int ilog2_u64(uint64_t x)
+{
+    return 63 - __builtin_clzll(x);
+}
+
+#endif // _MSC_VER
+
+// Smallest power of 2 no less than `x`, or 0 if that does not fit.
+static inline uint64_t next_pow2_u64(uint64_t x)
+{
+    if (x <= 1)
+        return 1;
+    if (x > (UINT64_C(1) << 63))
+        return 0;
+    return UINT64_C(1) << (ilog2_u64(x - 1) + 1);
+}
+
+// }}} -------------------------------------------------------------------------
+
+// NUMBER FORMATTING ------------------------------------------------------- {{{
+
+// Enough for `LUA_NUMBER_FMT` and for any integer below 2^64, plus the nul.
+#define FORMAT_NUMBER_SIZE  32
+
+/**
+ * @brief   Write `n` to `buf` the way `tostring()` does in Lua 5.1, that is
+ *          `LUA_NUMBER_FMT`, and return the length. Integral values below 2^53
+ *          in magnitude, which covers most numbers in practice, are converted
+ *          with a digit loop instead of the much slower `snprintf()`.
+ *
+ * @note    `buf` must hold at least `FORMAT_NUMBER_SIZE` chars. It is always
+ *          nul-terminated.
+ *
+ * @note    Negative zero is written as `0`, and on 5.3+ integral floats lack
+ *          the `.0` that `tostring()` would add.
+ */
+static inline int format_number(char *buf, lua_Number n)
+{
+    if (n == floor(n) && fabs(n) < 9007199254740992.0) {
+        char     tmp[FORMAT_NUMBER_SIZE];
+        char    *end = tmp + sizeof(tmp);
+        char    *p   = end;
+        uint64_t u   = cast(uint64_t, fabs(n));
+        do {
+            *--p = cast(char, '0' + u % 10);
+            u /= 10;
+        } while (u != 0);
+        if (n < 0)
+            *--p = '-';
+        memcpy(buf, p, cast(size_t, end - p));
+        buf[end - p] = '\0';
+        return cast_int(end - p);
+    }
+    return snprintf(buf, FORMAT_NUMBER_SIZE, LUA_NUMBER_FMT, n);
+}
+
+// }}} -------------------------------------------------------------------------
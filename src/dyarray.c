@@ -27,31 +27,31 @@
  */
 #define LIB_NAME "dyarray"
 #include "common.h"
+#include "dyarray.h"
+#include "bitset.h"
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-typedef struct {
-    int         length;   // #Active, also 1 past last written C index.
-    int         capacity; // #Allocated, also 1 past last valid C index.
-    lua_Number *values;   // Heap-allocated 1D array.
-} DyArray;
-
-#define size_of_values(self, n) size_of_array((self)->values, n)
-#define size_of_active(self)    size_of_values(self, (self)->length)
-#define size_of_total(self)     size_of_values(self, (self)->capacity)
-
 // HELPERS ----------------------------------------------------------------- {{{
 
-/**
- * @brief   May throw if metatable does not match.
- *          `luaL_checkudata()` checks the stack index against the given
- *          metatable name. This name may be found in the registry.
- *
- * @note    As of Lua 5.1 `luaL_checkudata()` throws by itself.
- *          See: https://www.lua.org/manual/5.1/manual.html#7.3
- */
+// Every function in `lib_fns`, `mt_fns`, `heap_fns` and `rng_fns` shares these
+// upvalues, see `luaopen_dyarray()`.
+#define UPVALUE_MT          lua_upvalueindex(1)
+#define UPVALUE_HEAP_MT     lua_upvalueindex(2)
+#define UPVALUE_RNG_MT      lua_upvalueindex(3)
+#define UPVALUE_RNG         lua_upvalueindex(4) // Used when none is passed in.
+#define UPVALUE_EXPR_MT     lua_upvalueindex(5)
+
+// The upvalues are only there in functions registered by `luaopen_dyarray()`.
+// The C API may be called from other modules' functions, hence `api_check()`
+// still goes through `luaL_checkudata()`.
 static DyArray *l_checkarg_dyarray(lua_State *L, int argn)
 {
-    return luaL_checkudata(L, argn, LIB_MTNAME);
+    return l_checkarg_udata(L, argn, UPVALUE_MT, LIB_MTNAME);
 }
 
 // Convert a relative Lua 1-based index to an absolute C 0-based index.
@@ -78,6 +78,17 @@ static lua_Number *l_poke_value(lua_State *L)
     return &self->values[l_checkarg_index(L, self, 2)];
 }
 
+// Capacity for `x` elements: a power of 2, at least 8. Past 2^30 the next
+// power of 2 would overflow, so we settle for `INT_MAX`.
+static int next_power_of_2(int x)
+{
+    if (x <= 8)
+        return 8;
+    if (x > (1 << 30))
+        return INT_MAX;
+    return cast_int(next_pow2_u64(cast(uint64_t, x)));
+}
+
 // Assumes `start` and `stop` are both 0-based indexes.
 static lua_Number *c_clear_values(lua_Number *dst, int start, int stop)
 {
@@ -96,6 +107,34 @@ static lua_Number *c_copy_values(lua_Number *dst, lua_Number *src, int len)
     return dst;
 }
 
+/**
+ * @brief   Grow `self` so that it can hold at least `ncap` elements. Newly
+ *          allocated slots are zeroed. Unlike `c_resize_dyarray()` this never
+ *          shrinks the buffer, never changes the length and leaves the stack
+ *          untouched.
+ *
+ * @exception resize_pointer(): memory
+ */
+static void c_reserve_values(lua_State *L, DyArray *self, int ncap)
+{
+    if (ncap > self->capacity) {
+        size_t      osz = size_of_total(self);
+        lua_Number *tmp;
+        ncap = next_power_of_2(ncap);
+        tmp  = resize_pointer(L, self->values, osz, size_of_values(self, ncap));
+        DBG_PRINTFLN("grow buffer from %d to %d", self->capacity, ncap);
+        self->values   = c_clear_values(tmp, self->length, ncap);
+        self->capacity = ncap;
+    }
+}
+
+// Grow `self` as needed to hold `nlen` active elements, then set its length.
+static void c_ensure_length(lua_State *L, DyArray *self, int nlen)
+{
+    c_reserve_values(L, self, nlen);
+    self->length = nlen;
+}
+
 static int bad_newtype(lua_State *L, const char *tname)
 {
     return LIB_ERROR(L, "Cannot create new " LIB_QNAME " from %s", tname);
@@ -112,89 +151,502 @@ static int bad_field(lua_State *L, const char *field)
     return LIB_ERROR(L, "Unknown field " LUA_QS, field);
 }
 
-// TODO: Check for integer overflow
-static int next_power_of_2(int x)
+// Assumes `_G.tostring` is found at the valid index `fn`.
+// This has net 0 stack usage so that the caller can reuse it.
+static const char *call_tostring(lua_State *L, int fn_idx, int arg_idx)
 {
-    int n = 8;
-    while (n < x)
-        n *= 2;
-    return n;
+    const char *s;
+    lua_pushvalue(L, fn_idx);  // [ tostring]
+    lua_pushvalue(L, arg_idx); // [ tostring, arg ]
+    lua_call(L, 1, 1);         // [ tostring(arg) ]
+    s = lua_tostring(L, -1);
+    lua_pop(L, 1);
+    return s;
+}
+
+// }}} -------------------------------------------------------------------------
+
+// DUMP TABLE ------------------------------------------------------------- {{{1
+
+#define DUMP_MAX_DEPTH      64  // Default for `opts.depth`.
+#define DUMP_DEPTH_LIMIT    200 // Each level recurses on the C stack.
+#define DUMP_INIT_SIZE      4096
+#define DUMP_FLUSH_SIZE     (1 << 16)
+#define DUMP_INDENT         "    "
+
+static const char *const dump_outs[] = {"stdout", "string", NULL};
+
+enum {
+    DUMP_STDOUT,
+    DUMP_STRING,
+    DUMP_FILE,
+};
+
+/**
+ * @brief   Serializer state. Output goes to a growable byte buffer owned by a
+ *          userdata "box" at `box_idx`, so that it is collected even if we
+ *          throw halfway. Growing allocates a bigger box and replaces the old
+ *          one in the same stack slot.
+ *
+ * @note    Unless writing to a string, the buffer is flushed every
+ *          `DUMP_FLUSH_SIZE` bytes so that memory use stays bounded.
+ */
+typedef struct {
+    lua_State *L;
+    char      *data;
+    size_t     length;
+    size_t     capacity;
+    int        box_idx;     // Stack index of the userdata that owns `data`.
+    int        visited_idx; // Stack index of `{[table] = path}`.
+    int        out_idx;     // Stack index of the file, if `out == DUMP_FILE`.
+    int        out;
+    int        max_depth;
+    int        sort;
+} Dumper;
+
+/**
+ * @brief   Sort key for `opts.sort`: numbers, then strings, then booleans,
+ *          then everything else by address. `slot` is the key's index in the
+ *          temporary key list.
+ */
+typedef struct {
+    int         rank;
+    int         slot;
+    lua_Number  n;
+    const char *s;
+    size_t      len;
+} DumpKey;
+
+/**
+ * @exception write(): any
+ */
+static void c_dump_flush(Dumper *D)
+{
+    lua_State *L = D->L;
+    if (D->length == 0)
+        return;
+    if (D->out == DUMP_STDOUT) {
+        fwrite(D->data, 1, D->length, stdout);
+    } else {
+        lua_getfield(L, D->out_idx, "write");  // [ ..., out.write ]
+        lua_pushvalue(L, D->out_idx);          // [ ..., out.write, out ]
+        lua_pushlstring(L, D->data, D->length);
+        lua_call(L, 2, 2);                     // [ ..., ok, err ]
+        if (lua_isnil(L, -2) && !lua_isnil(L, -1))
+            LIB_ERROR(L, "dump_table: %s", lua_tostring(L, -1));
+        lua_pop(L, 2);                         // [ ... ]
+    }
+    D->length = 0;
+}
+
+/**
+ * @exception lua_newuserdata(): memory
+ *
+ * @note    Stack usage:    [ -0, +0, m ]
+ */
+static void c_dump_reserve(Dumper *D, size_t n)
+{
+    lua_State *L = D->L;
+    size_t     ncap;
+    char      *tmp;
+
+    if (D->length + n <= D->capacity)
+        return;
+    ncap = D->capacity * 2;
+    while (ncap < D->length + n)
+        ncap *= 2;
+    tmp = lua_newuserdata(L, ncap); // [ ..., box ]
+    memcpy(tmp, D->data, D->length);
+    lua_replace(L, D->box_idx);     // [ ... ] ; old box is now garbage
+    D->data     = tmp;
+    D->capacity = ncap;
+}
+
+static void c_dump_addlstring(Dumper *D, const char *s, size_t len)
+{
+    c_dump_reserve(D, len);
+    memcpy(D->data + D->length, s, len);
+    D->length += len;
+}
+
+#define c_dump_addliteral(D, s) c_dump_addlstring(D, "" s, sizeof(s) - 1)
+
+static void c_dump_addchar(Dumper *D, char c)
+{
+    c_dump_reserve(D, 1);
+    D->data[D->length++] = c;
+}
+
+static void c_dump_indent(Dumper *D, int depth)
+{
+    for (int i = 0; i < depth; i++)
+        c_dump_addliteral(D, DUMP_INDENT);
+}
+
+// Infinities and NaN are written as expressions that evaluate back to them.
+static void c_dump_number(Dumper *D, lua_Number n)
+{
+    char buf[FORMAT_NUMBER_SIZE];
+
+    if (n != n) {
+        c_dump_addliteral(D, "0/0");
+    } else if (isinf(n)) {
+        if (n < 0)
+            c_dump_addliteral(D, "-1/0");
+        else
+            c_dump_addliteral(D, "1/0");
+    } else {
+        c_dump_addlstring(D, buf, cast(size_t, format_number(buf, n)));
+    }
+}
+
+/**
+ * @brief   Quote with `'` for single characters and `"` otherwise, escaping
+ *          as needed so that the output reads back as the same string.
+ */
+static void c_dump_string(Dumper *D, int s_idx)
+{
+    size_t      len;
+    const char *s = lua_tolstring(D->L, s_idx, &len);
+    const char  q = (len == 1) ? '\'' : '\"';
+
+    c_dump_reserve(D, len + 2);
+    c_dump_addchar(D, q);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = cast(unsigned char, s[i]);
+        if (c == q || c == '\\') {
+            c_dump_addchar(D, '\\');
+            c_dump_addchar(D, cast(char, c));
+        } else if (c == '\n') {
+            c_dump_addliteral(D, "\\n");
+        } else if (c < 0x20 || c == 0x7F) {
+            char buf[8];
+            int  n = snprintf(buf, sizeof(buf), "\\%03d", c);
+            c_dump_addlstring(D, buf, cast(size_t, n));
+        } else {
+            c_dump_addchar(D, cast(char, c));
+        }
+    }
+    c_dump_addchar(D, q);
 }
 
-static void print_value(lua_State *L, int i)
+// Everything but tables.
+static void c_dump_scalar(Dumper *D, int i)
 {
+    lua_State *L = D->L;
     switch (lua_type(L, i)) {
     case LUA_TNIL:
-        printf("nil");
+        c_dump_addliteral(D, "nil");
         break;
     case LUA_TBOOLEAN:
-        printf(lua_toboolean(L, i) ? "true" : "false");
+        if (lua_toboolean(L, i))
+            c_dump_addliteral(D, "true");
+        else
+            c_dump_addliteral(D, "false");
         break;
     case LUA_TNUMBER:
-        printf("%g", lua_tonumber(L, i));
+        c_dump_number(D, lua_tonumber(L, i));
+        break;
+    case LUA_TSTRING:
+        c_dump_string(D, i);
+        break;
+    default: {
+        char buf[64];
+        int  n = snprintf(buf, sizeof(buf), "%s(%p)",
+                          luaL_typename(L, i), lua_topointer(L, i));
+        c_dump_addlstring(D, buf, cast(size_t, n));
         break;
-    case LUA_TSTRING: {
-        const char *s = lua_tostring(L, i);
-        const char  q = (lua_objlen(L, i) == 1) ? '\'' : '\"';
-        printf("%c%s%c", q, s, q);
+    }
+    }
+}
+
+/**
+ * @brief   Push the path of `t[k]` given the path of `t`, as used by cycle
+ *          and shared reference markers: `root.name`, `root[1]`, ...
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ */
+static void l_push_childpath(lua_State *L, int path_idx, int k_idx)
+{
+    const char *path = lua_tostring(L, path_idx);
+    switch (lua_type(L, k_idx)) {
+    case LUA_TNUMBER: {
+        lua_Number n = lua_tonumber(L, k_idx);
+        if (fabs(n) < INT_MAX && n == cast(int, n))
+            lua_pushfstring(L, "%s[%d]", path, cast_int(n));
+        else
+            lua_pushfstring(L, "%s[%f]", path, n);
         break;
     }
+    case LUA_TSTRING:
+        lua_pushfstring(L, "%s.%s", path, lua_tostring(L, k_idx));
+        break;
     default:
-        printf("%s(%p)", luaL_typename(L, i), lua_topointer(L, i));
+        lua_pushfstring(L, "%s[<%s>]", path, luaL_typename(L, k_idx));
         break;
     }
 }
 
-// Assumes `_G.tostring` is found at the valid index `fn`.
-// This has net 0 stack usage so that the caller can reuse it.
-static const char *call_tostring(lua_State *L, int fn_idx, int arg_idx)
+static int c_compare_dumpkeys(const void *a, const void *b)
 {
-    const char *s;
-    lua_pushvalue(L, fn_idx);  // [ tostring]
-    lua_pushvalue(L, arg_idx); // [ tostring, arg ]
-    lua_call(L, 1, 1);         // [ tostring(arg) ]
-    s = lua_tostring(L, -1);
-    lua_pop(L, 1);
-    return s;
+    const DumpKey *x = a;
+    const DumpKey *y = b;
+    int            cmp;
+
+    if (x->rank != y->rank)
+        return x->rank - y->rank;
+    switch (x->rank) {
+    case 0: // number
+    case 2: // boolean
+        return (x->n > y->n) - (x->n < y->n);
+    case 1: // string
+        cmp = memcmp(x->s, y->s, (x->len < y->len) ? x->len : y->len);
+        return (cmp != 0) ? cmp : (x->len > y->len) - (x->len < y->len);
+    default:
+        return (cast(uintptr_t, x->s) > cast(uintptr_t, y->s))
+             - (cast(uintptr_t, x->s) < cast(uintptr_t, y->s));
+    }
+}
+
+static void c_dump_value(Dumper *D, int v_idx, int path_idx, int depth);
+
+/**
+ * @brief   Write `[k] = v,` on its own line. For table values the path of
+ *          `t[k]` is pushed first.
+ *
+ * @note    Stack usage:    [ -0, +0, m|e ]
+ *          Stack before:   [ ..., k, v ]
+ *          Stack after:    [ ..., k, v ]
+ */
+static void c_dump_entry(Dumper *D, int path_idx, int depth)
+{
+    lua_State *L     = D->L;
+    int        k_idx = lua_gettop(L) - 1;
+    int        v_idx = k_idx + 1;
+
+    c_dump_indent(D, depth);
+    c_dump_addchar(D, '[');
+    if (lua_istable(L, k_idx)) {
+        lua_pushfstring(L, "%s{key}", lua_tostring(L, path_idx));
+        c_dump_value(D, k_idx, lua_gettop(L), depth); // [ ..., k, v, kpath ]
+        lua_pop(L, 1);                                // [ ..., k, v ]
+    } else {
+        c_dump_scalar(D, k_idx);
+    }
+    c_dump_addliteral(D, "] = ");
+    if (lua_istable(L, v_idx)) {
+        l_push_childpath(L, path_idx, k_idx);         // [ ..., k, v, vpath ]
+        c_dump_value(D, v_idx, lua_gettop(L), depth);
+        lua_pop(L, 1);                                // [ ..., k, v ]
+    } else {
+        c_dump_scalar(D, v_idx);
+    }
+    c_dump_addliteral(D, ",\n");
+    if (D->out != DUMP_STRING && D->length >= DUMP_FLUSH_SIZE)
+        c_dump_flush(D);
 }
 
-// TODO: Make recursive using memoization
-static int c_dump_table(lua_State *L, int t_idx)
+/**
+ * @brief   Write the entries of the table at `t_idx` in key order.
+ *
+ * @note    Stack usage:    [ -0, +0, m|e ]
+ */
+static void c_dump_sorted(Dumper *D, int t_idx, int path_idx, int depth)
 {
-    lua_pushnil(L); // [ t, nil ] ; set space for key
+    lua_State *L = D->L;
+    DumpKey   *keys;
+    int        n = 0, keys_idx;
 
-    // https://www.lua.org/manual/5.1/manual.html#lua_next
+    lua_newtable(L); // [ ..., keylist ] ; anchors the strings in `keys`
+    keys_idx = lua_gettop(L);
+    lua_pushnil(L);  // [ ..., keylist, nil ]
     while (lua_next(L, t_idx)) {
-        // [ t, k, t[k] ]
-        int k_idx = t_idx + 1;
-        int v_idx = t_idx + 2;
-        printf("[");    print_value(L, k_idx);
-        printf("] = "); print_value(L, v_idx);
-        printf("\n");
+        lua_pop(L, 1);                     // [ ..., keylist, k ]
+        lua_pushvalue(L, -1);              // [ ..., keylist, k, k ]
+        lua_rawseti(L, keys_idx, ++n);     // [ ..., keylist, k ]
+    }
 
-        // [ t, m, k ]
-        lua_pop(L, 1);
+    keys = lua_newuserdata(L, sizeof(keys[0]) * (n > 0 ? n : 1)); // [ ..., keylist, keys ]
+    for (int i = 0; i < n; i++) {
+        DumpKey *key = &keys[i];
+        lua_rawgeti(L, keys_idx, i + 1); // [ ..., keylist, keys, k ]
+        key->slot = i + 1;
+        key->n    = 0;
+        key->s    = NULL;
+        key->len  = 0;
+        switch (lua_type(L, -1)) {
+        case LUA_TNUMBER:
+            key->rank = 0;
+            key->n    = lua_tonumber(L, -1);
+            break;
+        case LUA_TSTRING:
+            key->rank = 1;
+            key->s    = lua_tolstring(L, -1, &key->len);
+            break;
+        case LUA_TBOOLEAN:
+            key->rank = 2;
+            key->n    = lua_toboolean(L, -1);
+            break;
+        default:
+            key->rank = 3;
+            key->s    = cast(const char *, lua_topointer(L, -1));
+            break;
+        }
+        lua_pop(L, 1); // [ ..., keylist, keys ]
     }
-    return 0;
+    qsort(keys, cast(size_t, n), sizeof(keys[0]), &c_compare_dumpkeys);
+
+    for (int i = 0; i < n; i++) {
+        lua_rawgeti(L, keys_idx, keys[i].slot); // [ ..., keylist, keys, k ]
+        lua_pushvalue(L, -1);                   // [ ..., keylist, keys, k, k ]
+        lua_rawget(L, t_idx);                   // [ ..., keylist, keys, k, t[k] ]
+        c_dump_entry(D, path_idx, depth);
+        lua_pop(L, 2);                          // [ ..., keylist, keys ]
+    }
+    lua_pop(L, 2); // [ ... ]
+}
+
+/**
+ * @brief   Write any value. Tables are written as constructors, except that
+ *          a table already seen (a cycle or a shared reference) is written as
+ *          `<ref path>` and a table nested deeper than `max_depth` as `{...}`.
+ *
+ * @note    Stack usage:    [ -0, +0, m|e ]
+ */
+static void c_dump_value(Dumper *D, int v_idx, int path_idx, int depth)
+{
+    lua_State *L = D->L;
+
+    if (!lua_istable(L, v_idx)) {
+        c_dump_scalar(D, v_idx);
+        return;
+    }
+
+    lua_pushvalue(L, v_idx);        // [ ..., v ]
+    lua_rawget(L, D->visited_idx);  // [ ..., visited[v] ]
+    if (!lua_isnil(L, -1)) {
+        c_dump_addliteral(D, "<ref ");
+        c_dump_addlstring(D, lua_tostring(L, -1), lua_objlen(L, -1));
+        c_dump_addchar(D, '>');
+        lua_pop(L, 1);              // [ ... ]
+        return;
+    }
+    lua_pop(L, 1);                  // [ ... ]
+    if (depth >= D->max_depth) {
+        c_dump_addliteral(D, "{...}");
+        return;
+    }
+
+    luaL_checkstack(L, 8, "dump_table: table too deeply nested");
+    lua_pushvalue(L, v_idx);        // [ ..., v ]
+    lua_pushvalue(L, path_idx);     // [ ..., v, path ]
+    lua_rawset(L, D->visited_idx);  // [ ... ] ; visited[v] = path
+
+    c_dump_addliteral(D, "{\n");
+    if (D->sort) {
+        c_dump_sorted(D, v_idx, path_idx, depth + 1);
+    } else {
+        lua_pushnil(L);             // [ ..., nil ]
+        while (lua_next(L, v_idx)) {
+            c_dump_entry(D, path_idx, depth + 1); // [ ..., k, v[k] ]
+            lua_pop(L, 1);                        // [ ..., k ]
+        }
+    }
+    c_dump_indent(D, depth);
+    c_dump_addchar(D, '}');
+}
+
+static int l_optfield_int(lua_State *L, int t_idx, const char *k, int def)
+{
+    int n;
+    lua_getfield(L, t_idx, k);
+    n = lua_isnil(L, -1) ? def : cast_int(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    return n;
 }
 
+/**
+ * @brief   Serialize `t` as a Lua table constructor.
+ *
+ * @exception <args[1]>, <args[2]>: type
+ *            out:write():          any
+ *            lua_newuserdata():    memory
+ *
+ * @note    Stack usage:    [ -(1|2), +(0|1), m|e ]
+ *          Stack before:   [ t: table, opts: table? ]
+ *          Stack after:    [ s: string? ]
+ *
+ * @note    `opts` may have the fields:
+ *          `depth`: Tables nested deeper than this are written as `{...}`.
+ *                   Defaults to `DUMP_MAX_DEPTH`.
+ *          `sort`:  If true, write keys in order: numbers, then strings, then
+ *                   booleans, then everything else. Otherwise in `next()`
+ *                   order, which is faster.
+ *          `out`:   `"stdout"` (the default), `"string"` to return the result,
+ *                   or any object with a `write` method, e.g. a file.
+ *
+ * @note    Tables seen before, due to a cycle or a shared reference, are
+ *          written as `<ref path>`, where `path` names their first occurrence,
+ *          e.g. `<ref root.config[2]>`.
+ */
 static int dump_table(lua_State *L)
 {
-    return lua_istable(L, 1) ? c_dump_table(L, 1) : luaL_typerror(L, 1, "table");
+    Dumper D;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    if (lua_isnoneornil(L, 2))
+        lua_newtable(L);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2); // [ t, opts ]
+
+    D.L         = L;
+    D.max_depth = l_optfield_int(L, 2, "depth", DUMP_MAX_DEPTH);
+    luaL_argcheck(L, 0 <= D.max_depth && D.max_depth <= DUMP_DEPTH_LIMIT, 2,
+                  "depth out of range");
+    lua_getfield(L, 2, "sort");  // [ t, opts, opts.sort ]
+    D.sort = lua_toboolean(L, -1);
+    lua_pop(L, 1);               // [ t, opts ]
+
+    lua_getfield(L, 2, "out");   // [ t, opts, out ]
+    D.out_idx = 3;
+    if (lua_isnil(L, 3) || lua_type(L, 3) == LUA_TSTRING)
+        D.out = luaL_checkoption(L, 3, "stdout", dump_outs);
+    else
+        D.out = DUMP_FILE;
+
+    lua_newtable(L);             // [ t, opts, out, visited ]
+    D.visited_idx = 4;
+    D.data        = lua_newuserdata(L, DUMP_INIT_SIZE); // [ t, opts, out, visited, box ]
+    D.box_idx     = 5;
+    D.length      = 0;
+    D.capacity    = DUMP_INIT_SIZE;
+
+    lua_pushliteral(L, "root");  // [ t, opts, out, visited, box, "root" ]
+    c_dump_value(&D, 1, 6, 0);
+    c_dump_addchar(&D, '\n');
+
+    if (D.out == DUMP_STRING) {
+        lua_pushlstring(L, D.data, D.length); // [ ..., s ]
+        return 1;
+    }
+    c_dump_flush(&D);
+    return 0;
 }
 
-// }}} -------------------------------------------------------------------------
+// 1}}} ------------------------------------------------------------------------
 
 // METHODS ---------------------------------------------------------------- {{{1
 
 /**
+ * @brief   `mt_idx` must be an absolute or upvalue index of the metatable.
+ *
  * @exception lua_newuserdata(): memory
  *
  * @note    Stack usage:    [ 0, +1, m ]
  *          Stack before:   [ ...args ]
  *          Stack after:    [ ...args, self ]
  */
-static DyArray *c_new_dyarray(lua_State *L, int len, int cap)
+static DyArray *c_new_dyarray_mt(lua_State *L, int len, int cap, int mt_idx)
 {
     DyArray *self  = lua_newuserdata(L, sizeof(*self)); // [ ...args, self ]
 
@@ -203,11 +655,46 @@ static DyArray *c_new_dyarray(lua_State *L, int len, int cap)
     self->capacity = cap;
     self->values   = new_pointer(L, size_of_total(self));
 
-    luaL_getmetatable(L, LIB_MTNAME); // [ ...args, self, mt ]
-    lua_setmetatable(L, -2);          // [ ...args, self ] ; setmetatable(self, mt)
+    lua_pushvalue(L, mt_idx); // [ ...args, self, mt ]
+    lua_setmetatable(L, -2);  // [ ...args, self ] ; setmetatable(self, mt)
     return self;
 }
 
+static DyArray *c_new_dyarray(lua_State *L, int len, int cap)
+{
+    return c_new_dyarray_mt(L, len, cap, UPVALUE_MT);
+}
+
+/**
+ * @brief   Resolve the optional output argument used by the bulk methods.
+ *          If `args[argn]` is none or nil we create a fresh dyarray, otherwise
+ *          we reuse the given one (which may be `self` itself for in-place
+ *          operation) and grow it as needed.
+ *
+ * @exception <args[argn]>:    type
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ *          Stack before:   [ self: dyarray, ...args ]
+ *          Stack after:    [ self, ...args, out: dyarray ]
+ *
+ * @note    `out.length` is set to `len`, but its values are left as-is.
+ */
+static DyArray *l_optarg_output(lua_State *L, int argn, int len)
+{
+    DyArray *out;
+    if (lua_isnoneornil(L, argn)) {
+        int cap = next_power_of_2(len);
+        out = c_new_dyarray(L, len, cap);
+        c_clear_values(out->values, len, cap);
+        return out;
+    }
+    out = l_checkarg_dyarray(L, argn);
+    c_ensure_length(L, out, len);
+    lua_pushvalue(L, argn);
+    return out;
+}
+
 /**
  * @exception <args[1]>:       type
  *            c_new_dyarray(): memory
@@ -376,8 +863,9 @@ static int c_remove_dyarray(lua_State *L, DyArray *self, int c_idx)
     int        len = self->length;
     lua_Number n   = self->values[c_idx];
 
-    // Move all elements to the right, 1 step to the left.
-    for (int i = c_idx; i < len; i++)
+    // Move all elements to the right, 1 step to the left. Stop before the
+    // last one since `values[len]` is past the buffer when `len == capacity`.
+    for (int i = c_idx; i < len - 1; i++)
         self->values[i] = self->values[i + 1];
 
     lua_pushnumber(L, n);
@@ -458,9 +946,10 @@ static int push_dyarray(lua_State *L)
     lua_Number n    = luaL_checknumber(L, 2);
 
     // cap of 4 means last valid C index is 3, and if `len` is 4 that means
-    // we need to resize.
+    // we need to resize. Ask for `len + 1` since `next_power_of_2(len)` would
+    // just give us `len` back when it's already a power of 2.
     if (len >= self->capacity)
-        c_resize_dyarray(L, self, len, next_power_of_2(len));
+        c_resize_dyarray(L, self, len, next_power_of_2(len + 1));
     return c_insert_dyarray(L, self, len, n);
 }
 
@@ -496,77 +985,1396 @@ static int length_dyarray(lua_State *L)
     return 1;
 }
 
-// 1}}} ------------------------------------------------------------------------
-
-// METATABLES ------------------------------------------------------------- {{{1
-
 /**
- * @exception <args[1]>:         type
- *            lua_pushfstring(): memory
- *            luaL_add*:         memory
+ * @brief   Expose the raw `values` buffer, e.g. for LuaJIT's FFI:
+ *          `ffi.cast("double *", a:ptr())`. See `dyarray_ffi.lua`.
  *
- * @note    Stack usage:    [ -1, +1, m|v ]
+ * @warning The pointer is only valid while `self` is alive and until the
+ *          next call that may grow or shrink it (`push`, `resize`, ...).
+ *          Indexes past `length` are not checked.
+ *
+ * @exception <args[1]>: type
+ *
+ * @note    Stack usage:    [ -1, +2, v ]
  *          Stack before:   [ self ]
- *          Stack after:    [ tostring(self) ]
+ *          Stack after:    [ values: lightuserdata, length: integer ]
  */
-static int mt_tostring(lua_State *L)
+static int ptr_dyarray(lua_State *L)
 {
-    DyArray    *self = l_checkarg_dyarray(L, 1);
-    int         len  = self->length;
-    luaL_Buffer buf;
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    lua_pushlightuserdata(L, self->values);
+    lua_pushinteger(L, self->length);
+    return 2;
+}
 
-    luaL_buffinit(L, &buf);
-    lua_pushfstring(L, LIB_MESSAGE("length = %d, values = {", len));
-    luaL_addvalue(&buf); // [ self, fmt ] -> [ self ]
+// UNSAFE ACCESSORS ------------------------------------------------------- {{{2
 
-    for (int i = 0; i < len; i++) {
-        lua_pushnumber(L, self->values[i]);
-        luaL_addvalue(&buf); // [ self, self.values[i] ] -> [ self ]
-        if (i < len - 1)
-            luaL_addstring(&buf, ", ");
-    }
+// The unsafe accessors only check their arguments in builds without NDEBUG,
+// so that misuse still shows up in tests run against debug builds.
+#ifdef NDEBUG
+#define unsafe_argcheck(L, cond, argn, msg) ((void)0)
+#else
+#define unsafe_argcheck(L, cond, argn, msg) luaL_argcheck(L, cond, argn, msg)
+#endif
 
-    luaL_addchar(&buf, '}');
-    luaL_pushresult(&buf);
+/**
+ * @brief   `get(i)` closure made by `unsafe_dyarray()`. `self` is its upvalue.
+ *
+ * @note    Stack usage:    [ -1, +1, - ]
+ *          Stack before:   [ i: integer ]
+ *          Stack after:    [ self[i]: number ]
+ */
+static int unsafe_get(lua_State *L)
+{
+    DyArray *self = lua_touserdata(L, lua_upvalueindex(1));
+    int      i    = cast_int(lua_tointeger(L, 1)) - 1;
+    unsafe_argcheck(L, 0 <= i && i < self->length, 1, "index out of range");
+    lua_pushnumber(L, self->values[i]);
     return 1;
 }
 
 /**
- * @exception <args[2]>: type, index, field
- *
- * @note    Stack usage:  [ -2, +1, v ]
- *          Stack before: [ self: dyarray, key: number|string ]
- *          Stack after:  [ self[key]: number|function ]
+ * @brief   `set(i, v)` closure made by `unsafe_dyarray()`. `self` is its
+ *          upvalue. Returns nothing, unlike `set_dyarray()`.
  *
-*/
-static int mt_index(lua_State *L)
+ * @note    Stack usage:    [ -2, +0, - ]
+ *          Stack before:   [ i: integer, v: number ]
+ *          Stack after:    []
+ */
+static int unsafe_set(lua_State *L)
 {
-    switch (lua_type(L, 2)) {
-    case LUA_TNUMBER: return get_dyarray(L);
-    case LUA_TSTRING: return get_field(L);
-    default:          break;
-    }
-
-    lua_getglobal(L, "tostring"); // [ self, key, tostring ]
-    lua_pushvalue(L, 2);          // [ self, key, tostring, key ]
-    return bad_field(L, call_tostring(L, 3, 4));
+    DyArray *self = lua_touserdata(L, lua_upvalueindex(1));
+    int      i    = cast_int(lua_tointeger(L, 1)) - 1;
+    unsafe_argcheck(L, 0 <= i && i < self->length, 1, "index out of range");
+    unsafe_argcheck(L, lua_isnumber(L, 2), 2, "number expected");
+    self->values[i] = lua_tonumber(L, 2);
+    return 0;
 }
 
 /**
- * @brief   `dyarray.values` is not managed by Lua, we must free it ourselves.
- *          Think of this like a pseudo-destructor.
+ * @brief   Validate `self` once and return `get(i)` and `set(i, v)` closures
+ *          bound to it, for hot loops. Being closures they skip the type
+ *          check on `self`, and they read `self.values` on every call so they
+ *          stay valid when `self` grows. `i` must be an integer in
+ *          `[1, self:length()]`; negative indexes are not resolved.
+ *
+ *          local get, set = a:unsafe()
+ *          for i = 1, #a do
+ *              set(i, get(i) * 2)
+ *          end
+ *
+ * @warning Release builds (`NDEBUG`) check neither `i` nor `v`, so an out
+ *          of range index reads or writes out of bounds.
  *
  * @exception <args[1]>: type
  *
- * @note    Stack usage:    [ -1, 0, - ]
- *          Stack before:   [ self: dyarray ]
- *          Stack after:    []
- *          Side effect:    free(self.values)
+ * @note    Stack usage:    [ -1, +2, m|v ]
+ *          Stack before:   [ self ]
+ *          Stack after:    [ get: function, set: function ]
  */
-static int mt_gc(lua_State *L)
+static int unsafe_dyarray(lua_State *L)
 {
-    DyArray *self = l_checkarg_dyarray(L, 1);
-    DBG_PRINTFLN("free buffer of length %d", self->length);
+    l_checkarg_dyarray(L, 1);
+    lua_settop(L, 1);                      // [ self ]
+    lua_pushvalue(L, 1);                   // [ self, self ]
+    lua_pushcclosure(L, &unsafe_get, 1);   // [ self, get ]
+    lua_pushvalue(L, 1);                   // [ self, get, self ]
+    lua_pushcclosure(L, &unsafe_set, 1);   // [ self, get, set ]
+    return 2;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// SCANS AND DIFFERENCES -------------------------------------------------- {{{2
+
+typedef enum {
+    SCAN_SUM,
+    SCAN_PROD,
+    SCAN_MAX,
+    SCAN_MIN,
+} ScanOp;
+
+static const char *const scan_ops[]   = {"sum", "prod", "max", "min", NULL};
+static const char *const scan_kinds[] = {"inclusive", "exclusive", NULL};
+
+#define scan_sum(acc, x)    ((acc) + (x))
+#define scan_prod(acc, x)   ((acc) * (x))
+#define scan_max(acc, x)    (((x) > (acc)) ? (x) : (acc))
+#define scan_min(acc, x)    (((x) < (acc)) ? (x) : (acc))
+
+// `dst` may alias `src`; each element is read before it is written.
+#define SCAN_LOOP(fn, identity)                                                \
+    do {                                                                       \
+        lua_Number acc = (identity);                                           \
+        for (int i = 0; i < len; i++) {                                        \
+            lua_Number x    = src[i];                                          \
+            lua_Number next = fn(acc, x);                                      \
+            dst[i] = exclusive ? acc : next;                                   \
+            acc    = next;                                                     \
+        }                                                                      \
+    } while (0)
+
+/**
+ * @brief   Prefix scan of `src[0:len]` into `dst[0:len]`. An inclusive scan
+ *          yields `dst[i] = src[0] op ... op src[i]`, an exclusive scan yields
+ *          `dst[i] = identity op src[0] op ... op src[i - 1]`.
+ *
+ * @note    Each element depends on the previous one so this is inherently
+ *          serial; the `exclusive` branch is loop-invariant and gets hoisted.
+ */
+static lua_Number *c_scan_values(lua_Number *dst, const lua_Number *src, int len,
+                                 ScanOp op, int exclusive)
+{
+    DBG_PRINTFLN("scan indexes 0 to %d", len);
+    switch (op) {
+    case SCAN_SUM:  SCAN_LOOP(scan_sum, 0);          break;
+    case SCAN_PROD: SCAN_LOOP(scan_prod, 1);         break;
+    case SCAN_MAX:  SCAN_LOOP(scan_max, -HUGE_VAL);  break;
+    case SCAN_MIN:  SCAN_LOOP(scan_min, HUGE_VAL);   break;
+    }
+    return dst;
+}
+
+#undef SCAN_LOOP
+
+/**
+ * @brief   `order`-th forward difference of `src[0:len]` into `dst`, which
+ *          must have room for `len - order` elements. Like `numpy.diff()`,
+ *          `order = 2` means the difference of the difference.
+ *
+ * @note    `dst` may alias `src`: `dst[i]` only ever reads indexes `i` and
+ *          `i + 1` which have not been overwritten yet.
+ */
+static lua_Number *c_diff_values(lua_Number *dst, const lua_Number *src, int len, int order)
+{
+    DBG_PRINTFLN("diff of order %d over indexes 0 to %d", order, len);
+    for (int k = 1; k <= order; k++) {
+        for (int i = 0; i < len - k; i++)
+            dst[i] = src[i + 1] - src[i];
+        src = dst;
+    }
+    return dst;
+}
+
+/**
+ * @exception <args[:]>:          type
+ *            l_optarg_output():  memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ *          Stack before:   [ self, ...args, out: dyarray? ]
+ *          Stack after:    [ self, ...args, out, out ]
+ */
+static int c_scan_dyarray(lua_State *L, ScanOp op, int exclusive, int out_argn)
+{
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    int      len  = self->length;
+    DyArray *out  = l_optarg_output(L, out_argn, len);
+    c_scan_values(out->values, self->values, len, op, exclusive);
+    return 1;
+}
+
+/**
+ * @exception <args[:]>: type, option
+ *
+ * @note    Stack usage:    [ -(1..4), +1, m|v ]
+ *          Stack before:   [ self: dyarray, op: string, kind: string?, out: dyarray? ]
+ *          Stack after:    [ out: dyarray ]
+ *
+ * @note    `op` is one of "sum", "prod", "max" or "min". `kind` is either
+ *          "inclusive" (the default) or "exclusive". Pass `self` as `out` to
+ *          scan in-place.
+ */
+static int scan_dyarray(lua_State *L)
+{
+    ScanOp op        = cast(ScanOp, luaL_checkoption(L, 2, NULL, scan_ops));
+    int    exclusive = luaL_checkoption(L, 3, "inclusive", scan_kinds);
+    return c_scan_dyarray(L, op, exclusive, 4);
+}
+
+/**
+ * @note    Stack before:   [ self: dyarray, out: dyarray? ]
+ *          Stack after:    [ out: dyarray ]
+ *          Side effects:   out[i] = self[1] + ... + self[i]
+ */
+static int cumsum_dyarray(lua_State *L)
+{
+    return c_scan_dyarray(L, SCAN_SUM, 0, 2);
+}
+
+/**
+ * @note    Stack before:   [ self: dyarray, out: dyarray? ]
+ *          Stack after:    [ out: dyarray ]
+ *          Side effects:   out[i] = self[1] * ... * self[i]
+ */
+static int cumprod_dyarray(lua_State *L)
+{
+    return c_scan_dyarray(L, SCAN_PROD, 0, 2);
+}
+
+/**
+ * @note    Stack before:   [ self: dyarray, out: dyarray? ]
+ *          Stack after:    [ out: dyarray ]
+ *          Side effects:   out[i] = max(self[1], ..., self[i])
+ */
+static int cummax_dyarray(lua_State *L)
+{
+    return c_scan_dyarray(L, SCAN_MAX, 0, 2);
+}
+
+/**
+ * @exception <args[:]>:  type
+ *            (order < 0): argument
+ *
+ * @note    Stack usage:    [ -(1..3), +1, m|v ]
+ *          Stack before:   [ self: dyarray, order: integer?, out: dyarray? ]
+ *          Stack after:    [ out: dyarray ]
+ *
+ * @note    `out.length` is `max(self.length - order, 0)`. `order` defaults to 1.
+ */
+static int diff_dyarray(lua_State *L)
+{
+    DyArray *self  = l_checkarg_dyarray(L, 1);
+    int      order = luaL_optint(L, 2, 1);
+    int      len   = self->length;
+    DyArray *out;
+
+    luaL_argcheck(L, order >= 0, 2, "negative difference order");
+    if (order > len)
+        order = len;
+
+    // The first pass writes `len - 1` elements, so `out` needs room for those
+    // even though only `len - order` of them survive.
+    out = l_optarg_output(L, 3, (order > 0) ? len - 1 : len);
+    if (order == 0) {
+        if (out != self)
+            c_copy_values(out->values, self->values, len);
+        return 1;
+    }
+    c_diff_values(out->values, self->values, len, order);
+    out->length = len - order;
+    return 1;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// MASKS ------------------------------------------------------------------ {{{2
+
+typedef enum {
+    MASK_LT,
+    MASK_LE,
+    MASK_GT,
+    MASK_GE,
+    MASK_EQ,
+    MASK_BETWEEN,
+} MaskOp;
+
+static const char *const mask_ops[] = {"lt", "le", "gt", "ge", "eq", "between", NULL};
+
+// Each group of 64 comparisons is packed into one word without branching, so
+// the inner loop vectorizes.
+#define MASK_LOOP(cond)                                                        \
+    for (int w = 0; w < nwords; w++) {                                         \
+        const lua_Number *v    = &src[w * BITSET_WORD_BITS];                   \
+        int               n    = len - w * BITSET_WORD_BITS;                   \
+        uint64_t          word = 0;                                            \
+        if (n > BITSET_WORD_BITS)                                              \
+            n = BITSET_WORD_BITS;                                              \
+        for (int j = 0; j < n; j++)                                            \
+            word |= cast(uint64_t, (cond)) << j;                               \
+        dst[w] = word;                                                         \
+    }
+
+/**
+ * @brief   Compare every value against `lo` (and `hi` for `MASK_BETWEEN`) and
+ *          write the results 1 bit per element.
+ */
+static uint64_t *c_mask_values(uint64_t *dst, const lua_Number *src, int len,
+                               MaskOp op, lua_Number lo, lua_Number hi)
+{
+    int nwords = bitset_nwords(len);
+    DBG_PRINTFLN("mask indexes 0 to %d", len);
+    switch (op) {
+    case MASK_LT:      MASK_LOOP(v[j] <  lo);              break;
+    case MASK_LE:      MASK_LOOP(v[j] <= lo);              break;
+    case MASK_GT:      MASK_LOOP(v[j] >  lo);              break;
+    case MASK_GE:      MASK_LOOP(v[j] >= lo);              break;
+    case MASK_EQ:      MASK_LOOP(v[j] == lo);              break;
+    case MASK_BETWEEN: MASK_LOOP(lo <= v[j] && v[j] <= hi); break;
+    }
+    return dst;
+}
+
+#undef MASK_LOOP
+
+/**
+ * @exception <args[:]>:         type
+ *            bitset_push_new(): memory
+ *
+ * @note    Stack usage:    [ -(2|3), +1, m|v ]
+ *          Stack before:   [ self: dyarray, lo: number, hi: number? ]
+ *          Stack after:    [ mask: bitset ]
+ */
+static int c_mask_dyarray(lua_State *L, MaskOp op)
+{
+    DyArray   *self = l_checkarg_dyarray(L, 1);
+    lua_Number lo   = luaL_checknumber(L, 2);
+    lua_Number hi   = (op == MASK_BETWEEN) ? luaL_checknumber(L, 3) : lo;
+    Bitset    *mask = bitset_push_new(L, self->length);
+    c_mask_values(mask->words, self->values, self->length, op, lo, hi);
+    return 1;
+}
+
+// mask[i] = self[i] < x
+static int lt_dyarray(lua_State *L)
+{
+    return c_mask_dyarray(L, MASK_LT);
+}
+
+// mask[i] = self[i] <= x
+static int le_dyarray(lua_State *L)
+{
+    return c_mask_dyarray(L, MASK_LE);
+}
+
+// mask[i] = self[i] > x
+static int gt_dyarray(lua_State *L)
+{
+    return c_mask_dyarray(L, MASK_GT);
+}
+
+// mask[i] = self[i] >= x
+static int ge_dyarray(lua_State *L)
+{
+    return c_mask_dyarray(L, MASK_GE);
+}
+
+// mask[i] = self[i] == x
+static int eq_dyarray(lua_State *L)
+{
+    return c_mask_dyarray(L, MASK_EQ);
+}
+
+// mask[i] = lo <= self[i] and self[i] <= hi
+static int between_dyarray(lua_State *L)
+{
+    return c_mask_dyarray(L, MASK_BETWEEN);
+}
+
+// Throws unless `args[argn]` is a bitset with the same length as `self`.
+static Bitset *l_checkarg_mask(lua_State *L, int argn, DyArray *self)
+{
+    Bitset *mask = bitset_check(L, argn);
+    luaL_argcheck(L, mask->length == self->length, argn, "length mismatch");
+    return mask;
+}
+
+/**
+ * @brief   Keep only the values whose bit is set in `mask`.
+ *
+ * @exception <args[:]>:       type
+ *            <args[2]>:       length mismatch
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -2, +1, m|v ]
+ *          Stack before:   [ self: dyarray, mask: bitset ]
+ *          Stack after:    [ out: dyarray ]
+ */
+static int compress_dyarray(lua_State *L)
+{
+    DyArray *self   = l_checkarg_dyarray(L, 1);
+    Bitset  *mask   = l_checkarg_mask(L, 2, self);
+    int      nwords = bitset_nwords(mask->length);
+    int      count  = 0;
+    int      cap;
+    DyArray *out;
+
+    for (int w = 0; w < nwords; w++)
+        count += popcount_u64(mask->words[w]);
+
+    cap = next_power_of_2(count);
+    out = c_new_dyarray(L, count, cap);
+    c_clear_values(out->values, count, cap);
+
+    // Visit set bits only, so sparse masks skip most of `self`.
+    count = 0;
+    for (int w = 0; w < nwords; w++) {
+        for (uint64_t word = mask->words[w]; word != 0; word &= word - 1)
+            out->values[count++] = self->values[w * BITSET_WORD_BITS + ctz_u64(word)];
+    }
+    return 1;
+}
+
+/**
+ * @brief   `out[i] = mask[i] ? self[i] : other[i]`, where `other` may also be
+ *          a single number.
+ *
+ * @exception <args[:]>:       type
+ *            <args[2:3]>:     length mismatch
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -3, +1, m|v ]
+ *          Stack before:   [ self: dyarray, mask: bitset, other: dyarray|number ]
+ *          Stack after:    [ out: dyarray ]
+ */
+static int where_dyarray(lua_State *L)
+{
+    DyArray    *self  = l_checkarg_dyarray(L, 1);
+    Bitset     *mask  = l_checkarg_mask(L, 2, self);
+    int         len   = self->length;
+    int         cap   = next_power_of_2(len);
+    DyArray    *other = NULL;
+    lua_Number  fill  = 0;
+    lua_Number *dst;
+
+    if (lua_type(L, 3) == LUA_TNUMBER) {
+        fill = lua_tonumber(L, 3);
+    } else {
+        other = l_checkarg_dyarray(L, 3);
+        luaL_argcheck(L, other->length == len, 3, "length mismatch");
+    }
+
+    dst = c_new_dyarray(L, len, cap)->values;
+    c_clear_values(dst, len, cap);
+    for (int i = 0; i < len; i++) {
+        lua_Number alt = (other != NULL) ? other->values[i] : fill;
+        dst[i] = bitset_test(mask, i) ? self->values[i] : alt;
+    }
+    return 1;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// GATHER AND SELECT ------------------------------------------------------ {{{2
+
+/**
+ * @brief   Convert `idx.values[pos]` to a C index into `self`, or throw if it is
+ *          not an integer or out of range. Negative indexes count from the end.
+ */
+static int l_checkvalue_index(lua_State *L, DyArray *self, DyArray *idx, int pos)
+{
+    lua_Number n = idx->values[pos];
+    int        i;
+
+    // Range check first since converting an out-of-range double is undefined.
+    if (!(-INT_MAX <= n && n <= INT_MAX) || cast(lua_Number, cast_int(n)) != n)
+        return LIB_ERROR(L, "Non-integer index %f at position %d", n, pos + 1);
+    i = l_resolve_index(self, cast_int(n));
+    if (i < 0 || i >= self->length)
+        return LIB_ERROR(L, "Index %d out of range at position %d", i + 1, pos + 1);
+    return i;
+}
+
+/**
+ * @brief   `out[i] = self[idx[i]]`
+ *
+ * @exception <args[:]>:       type
+ *            <args[2]>:       index
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -2, +1, m|v ]
+ *          Stack before:   [ self: dyarray, idx: dyarray ]
+ *          Stack after:    [ out: dyarray ]
+ */
+static int gather_dyarray(lua_State *L)
+{
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    DyArray *idx  = l_checkarg_dyarray(L, 2);
+    int      len  = idx->length;
+    int      cap  = next_power_of_2(len);
+    DyArray *out  = c_new_dyarray(L, len, cap);
+
+    c_clear_values(out->values, len, cap);
+    for (int i = 0; i < len; i++)
+        out->values[i] = self->values[l_checkvalue_index(L, self, idx, i)];
+    return 1;
+}
+
+/**
+ * @brief   `self[idx[i]] = vals[i]`, or `self[idx[i]] = vals` if `vals` is a
+ *          number. Later duplicates in `idx` win.
+ *
+ * @exception <args[:]>: type
+ *            <args[2]>: index
+ *            <args[3]>: length mismatch
+ *
+ * @note    Stack usage:    [ -3, +1, v ]
+ *          Stack before:   [ self: dyarray, idx: dyarray, vals: dyarray|number ]
+ *          Stack after:    [ self ]
+ *
+ * @note    All indexes are validated before anything is written, so an error
+ *          leaves `self` untouched.
+ */
+static int scatter_dyarray(lua_State *L)
+{
+    DyArray   *self = l_checkarg_dyarray(L, 1);
+    DyArray   *idx  = l_checkarg_dyarray(L, 2);
+    int        len  = idx->length;
+    DyArray   *vals = NULL;
+    lua_Number fill = 0;
+
+    if (lua_type(L, 3) == LUA_TNUMBER) {
+        fill = lua_tonumber(L, 3);
+    } else {
+        vals = l_checkarg_dyarray(L, 3);
+        luaL_argcheck(L, vals->length == len, 3, "length mismatch with indexes");
+    }
+    for (int i = 0; i < len; i++)
+        l_checkvalue_index(L, self, idx, i);
+    for (int i = 0; i < len; i++) {
+        int j = l_resolve_index(self, cast_int(idx->values[i]));
+        self->values[j] = (vals != NULL) ? vals->values[i] : fill;
+    }
+    lua_settop(L, 1); // [ self ]
+    return 1;
+}
+
+// `x` is the current element. The output index only advances on a match, so
+// there is no branch in the loop body.
+#define SELECT_LOOP(cond)                                                      \
+    for (int i = 0; i < len; i++) {                                            \
+        lua_Number x = src[i];                                                 \
+        dst[count] = x;                                                        \
+        count += (cond);                                                       \
+    }
+
+/**
+ * @return  Number of values in `src[0:len]` that satisfy the predicate, which
+ *          are packed in order into the front of `dst`.
+ *
+ * @note    `dst` needs room for `len` elements and may alias `src`.
+ */
+static int c_select_values(lua_Number *dst, const lua_Number *src, int len,
+                           MaskOp op, lua_Number lo, lua_Number hi)
+{
+    int count = 0;
+    DBG_PRINTFLN("select indexes 0 to %d", len);
+    switch (op) {
+    case MASK_LT:      SELECT_LOOP(x <  lo);             break;
+    case MASK_LE:      SELECT_LOOP(x <= lo);             break;
+    case MASK_GT:      SELECT_LOOP(x >  lo);             break;
+    case MASK_GE:      SELECT_LOOP(x >= lo);             break;
+    case MASK_EQ:      SELECT_LOOP(x == lo);             break;
+    case MASK_BETWEEN: SELECT_LOOP(lo <= x && x <= hi);  break;
+    }
+    return count;
+}
+
+#undef SELECT_LOOP
+
+/**
+ * @brief   Like `self:compress(self:<pred>(x))` in a single pass, without the
+ *          intermediate bitset.
+ *
+ * @exception <args[:]>:       type, option
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -(3|4), +1, m|v ]
+ *          Stack before:   [ self: dyarray, pred: string, x: number, hi: number? ]
+ *          Stack after:    [ out: dyarray ]
+ *
+ * @note    `pred` is the name of one of the mask methods: "lt", "le", "gt",
+ *          "ge", "eq" or "between". Only "between" takes `hi`.
+ */
+static int select_dyarray(lua_State *L)
+{
+    DyArray   *self = l_checkarg_dyarray(L, 1);
+    MaskOp     op   = cast(MaskOp, luaL_checkoption(L, 2, NULL, mask_ops));
+    lua_Number lo   = luaL_checknumber(L, 3);
+    lua_Number hi   = (op == MASK_BETWEEN) ? luaL_checknumber(L, 4) : lo;
+    int        len  = self->length;
+    int        cap  = next_power_of_2(len);
+    DyArray   *out  = c_new_dyarray(L, 0, cap);
+
+    out->length = c_select_values(out->values, self->values, len, op, lo, hi);
+    c_clear_values(out->values, out->length, cap);
+    return 1;
+}
+
+// Orders NaN after everything else so that sorting is well-defined.
+static int c_compare_values(const void *a, const void *b)
+{
+    lua_Number x = *cast(const lua_Number *, a);
+    lua_Number y = *cast(const lua_Number *, b);
+    if (x < y)
+        return -1;
+    if (x > y)
+        return 1;
+    return (x != x) - (y != y); // NaN only ever compares unequal.
+}
+
+/**
+ * @brief   The distinct values of `self` in ascending order. All NaNs count as
+ *          one value, which comes last.
+ *
+ * @exception <args[1]>:       type
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -1, +1, m|v ]
+ *          Stack before:   [ self: dyarray ]
+ *          Stack after:    [ out: dyarray ]
+ */
+static int unique_dyarray(lua_State *L)
+{
+    DyArray    *self = l_checkarg_dyarray(L, 1);
+    int         len  = self->length;
+    int         cap  = next_power_of_2(len);
+    DyArray    *out  = c_new_dyarray(L, len, cap);
+    lua_Number *dst  = out->values;
+    int         count;
+
+    c_copy_values(dst, self->values, len);
+    qsort(dst, cast(size_t, len), sizeof(dst[0]), &c_compare_values);
+
+    // Sorted, so duplicates are adjacent, NaNs included.
+    count = (len > 0) ? 1 : 0;
+    for (int i = 1; i < len; i++) {
+        lua_Number x    = dst[i];
+        lua_Number last = dst[count - 1];
+        if (x != last && (x == x || last == last))
+            dst[count++] = x;
+    }
+    out->length = count;
+    c_clear_values(dst, count, cap);
+    return 1;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// LINEAR ALGEBRA --------------------------------------------------------- {{{2
+
+// Dense row-major matrices stored in plain dyarrays. `gemm()` follows the
+// usual layout of a blocked matrix multiply (Goto & van de Geijn): `B` is
+// packed a `KC x NC` panel at a time and `A` an `MC x KC` block at a time,
+// so that the micro-kernel streams both from cache, and the micro-kernel
+// keeps an `MR x NR` tile of `C` in registers.
+#define GEMM_MR     4
+#define GEMM_NR     8
+#define GEMM_MC     128  // Multiple of `GEMM_MR`. Packed `A` fits in L2.
+#define GEMM_KC     256  // One `KC x NR` sliver of packed `B` fits in L1.
+#define GEMM_NC     2048 // Multiple of `GEMM_NR`. Packed `B` fits in L3.
+#define GEMM_SMALL  (64 * 64 * 64) // Below `m*n*k`, packing costs more than it saves.
+
+#define round_up(x, n)  (((x) + (n) - 1) / (n) * (n))
+#define min_int(a, b)   (((a) < (b)) ? (a) : (b))
+
+/**
+ * @brief   `c[0:mr][0:nr] += a * b`, where `a` is `kc` columns of `GEMM_MR`
+ *          rows and `b` is `kc` rows of `GEMM_NR` columns, as packed below.
+ *          The accumulator has constant bounds so that the compiler keeps it
+ *          in (vector) registers; only the final store looks at `mr` and
+ *          `nr`, which are smaller at the edges of `C`.
+ */
+static void c_gemm_micro(int kc, const lua_Number *a, const lua_Number *b,
+                         lua_Number *c, int ldc, int mr, int nr)
+{
+    lua_Number acc[GEMM_MR][GEMM_NR] = {{0}};
+
+    for (int p = 0; p < kc; p++) {
+        const lua_Number *ap = a + p * GEMM_MR;
+        const lua_Number *bp = b + p * GEMM_NR;
+        for (int i = 0; i < GEMM_MR; i++) {
+            for (int j = 0; j < GEMM_NR; j++)
+                acc[i][j] += ap[i] * bp[j];
+        }
+    }
+    for (int i = 0; i < mr; i++) {
+        for (int j = 0; j < nr; j++)
+            c[i * ldc + j] += acc[i][j];
+    }
+}
+
+// Copy `A[0:mc][0:kc]` into slivers of `GEMM_MR` rows, column by column,
+// zero-padding the last sliver.
+static void c_gemm_pack_a(lua_Number *dst, const lua_Number *A, int lda, int mc, int kc)
+{
+    for (int i0 = 0; i0 < mc; i0 += GEMM_MR) {
+        for (int p = 0; p < kc; p++) {
+            for (int i = 0; i < GEMM_MR; i++)
+                *dst++ = (i0 + i < mc) ? A[(i0 + i) * lda + p] : 0;
+        }
+    }
+}
+
+// Copy `B[0:kc][0:nc]` into slivers of `GEMM_NR` columns, row by row,
+// zero-padding the last sliver.
+static void c_gemm_pack_b(lua_Number *dst, const lua_Number *B, int ldb, int kc, int nc)
+{
+    for (int j0 = 0; j0 < nc; j0 += GEMM_NR) {
+        for (int p = 0; p < kc; p++) {
+            for (int j = 0; j < GEMM_NR; j++)
+                *dst++ = (j0 + j < nc) ? B[p * ldb + j0 + j] : 0;
+        }
+    }
+}
+
+/**
+ * @brief   `C[m][n] += A[m][k] * B[k][n]`, all row-major and contiguous.
+ *          `pack` must hold `c_gemm_pack_size()` elements.
+ */
+static void c_gemm(int m, int n, int k, const lua_Number *A, const lua_Number *B,
+                   lua_Number *C, lua_Number *pack)
+{
+    lua_Number *pack_a = pack;
+    lua_Number *pack_b = pack + round_up(min_int(m, GEMM_MC), GEMM_MR) * min_int(k, GEMM_KC);
+
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+        int nc = min_int(n - jc, GEMM_NC);
+        for (int pc = 0; pc < k; pc += GEMM_KC) {
+            int kc = min_int(k - pc, GEMM_KC);
+            c_gemm_pack_b(pack_b, B + pc * n + jc, n, kc, nc);
+            for (int ic = 0; ic < m; ic += GEMM_MC) {
+                int mc = min_int(m - ic, GEMM_MC);
+                c_gemm_pack_a(pack_a, A + ic * k + pc, k, mc, kc);
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+                        c_gemm_micro(kc, pack_a + ir * kc, pack_b + jr * kc,
+                                     C + (ic + ir) * n + jc + jr, n,
+                                     min_int(GEMM_MR, mc - ir), min_int(GEMM_NR, nc - jr));
+                    }
+                }
+            }
+        }
+    }
+}
+
+static size_t c_gemm_pack_size(int m, int n, int k)
+{
+    size_t kc = cast(size_t, min_int(k, GEMM_KC));
+    size_t mc = cast(size_t, round_up(min_int(m, GEMM_MC), GEMM_MR));
+    size_t nc = cast(size_t, round_up(min_int(n, GEMM_NC), GEMM_NR));
+    return kc * (mc + nc);
+}
+
+// `C[m][n] += A[m][k] * B[k][n]` for matrices too small to be worth packing.
+// The innermost loop runs along rows of `B` and `C`, so it vectorizes.
+static void c_gemm_small(int m, int n, int k, const lua_Number *A, const lua_Number *B,
+                         lua_Number *C)
+{
+    for (int i = 0; i < m; i++) {
+        lua_Number *c = C + i * n;
+        for (int p = 0; p < k; p++) {
+            lua_Number        a = A[i * k + p];
+            const lua_Number *b = B + p * n;
+            for (int j = 0; j < n; j++)
+                c[j] += a * b[j];
+        }
+    }
+}
+
+// `y[m] = A[m][n] * x[n]`, four rows at a time so that each `x[j]` loaded is
+// used four times.
+static void c_gemv(int m, int n, const lua_Number *A, const lua_Number *x, lua_Number *y)
+{
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+        const lua_Number *a0 = A + i * n;
+        const lua_Number *a1 = a0 + n;
+        const lua_Number *a2 = a1 + n;
+        const lua_Number *a3 = a2 + n;
+        lua_Number s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (int j = 0; j < n; j++) {
+            lua_Number xj = x[j];
+            s0 += a0[j] * xj;
+            s1 += a1[j] * xj;
+            s2 += a2[j] * xj;
+            s3 += a3[j] * xj;
+        }
+        y[i]     = s0;
+        y[i + 1] = s1;
+        y[i + 2] = s2;
+        y[i + 3] = s3;
+    }
+    for (; i < m; i++) {
+        const lua_Number *a = A + i * n;
+        lua_Number        s = 0;
+        for (int j = 0; j < n; j++)
+            s += a[j] * x[j];
+        y[i] = s;
+    }
+}
+
+/**
+ * @brief   Check that `args[argn]` holds at least a `rows x cols` matrix.
+ *
+ * @exception <args[argn]>: type, other
+ */
+static DyArray *l_checkarg_matrix(lua_State *L, int argn, int rows, int cols)
+{
+    DyArray *self = l_checkarg_dyarray(L, argn);
+    luaL_argcheck(L, cast(int64_t, rows) * cols <= self->length, argn,
+                  "too short for the given dimensions");
+    return self;
+}
+
+static int l_checkarg_dim(lua_State *L, int argn)
+{
+    int n = luaL_checkint(L, argn);
+    luaL_argcheck(L, n >= 0, argn, "negative dimension");
+    return n;
+}
+
+/**
+ * @brief   Resolve the output of `gemm()` and `gemv()`, which must not share
+ *          storage with the inputs since those are read after it is written.
+ *
+ * @exception <args[argn]>:      other
+ *            l_optarg_output(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ */
+static DyArray *l_optarg_matrix_output(lua_State *L, int argn, int len,
+                                       const DyArray *a, const DyArray *b)
+{
+    const void *p = lua_touserdata(L, argn);
+    luaL_argcheck(L, p != a && p != b, argn, "must not be one of the inputs");
+    luaL_argcheck(L, len >= 0, argn, "result too large");
+    return l_optarg_output(L, argn, len);
+}
+
+/**
+ * @brief   Matrix product `out = A * B` of the row-major `m x k` matrix `A`
+ *          and `k x n` matrix `B`. `out` is `m x n`, and a new dyarray if
+ *          not given.
+ *
+ * @exception <args[1:6]>:                type, other
+ *            l_optarg_matrix_output(), new_pointer(): memory
+ *
+ * @note    Stack usage:    [ -(5|6), +1, m|v ]
+ *          Stack before:   [ A: dyarray, B: dyarray, m: integer, n: integer, k: integer,
+ *                            out: dyarray? ]
+ *          Stack after:    [ out: dyarray ]
+ */
+static int gemm_dyarray(lua_State *L)
+{
+    int      m   = l_checkarg_dim(L, 3);
+    int      n   = l_checkarg_dim(L, 4);
+    int      k   = l_checkarg_dim(L, 5);
+    DyArray *a   = l_checkarg_matrix(L, 1, m, k);
+    DyArray *b   = l_checkarg_matrix(L, 2, k, n);
+    int      len = (cast(int64_t, m) * n > INT_MAX) ? -1 : m * n;
+    DyArray *out = l_optarg_matrix_output(L, 6, len, a, b); // [ ...args, out ]
+
+    c_clear_values(out->values, 0, len);
+    if (cast(int64_t, m) * n * k < GEMM_SMALL) {
+        c_gemm_small(m, n, k, a->values, b->values, out->values);
+    } else {
+        size_t      size = size_of_array(out->values, c_gemm_pack_size(m, n, k));
+        lua_Number *pack = new_pointer(L, size);
+        c_gemm(m, n, k, a->values, b->values, out->values, pack);
+        free_pointer(L, pack, size);
+    }
+    return 1;
+}
+
+/**
+ * @brief   Matrix-vector product `out = A * x` of the row-major `m x n`
+ *          matrix `A` and vector `x` of length `n`.
+ *
+ * @exception <args[1:5]>:               type, other
+ *            l_optarg_matrix_output(): memory
+ *
+ * @note    Stack usage:    [ -(4|5), +1, m|v ]
+ *          Stack before:   [ A: dyarray, x: dyarray, m: integer, n: integer, out: dyarray? ]
+ *          Stack after:    [ out: dyarray ]
+ */
+static int gemv_dyarray(lua_State *L)
+{
+    int      m   = l_checkarg_dim(L, 3);
+    int      n   = l_checkarg_dim(L, 4);
+    DyArray *a   = l_checkarg_matrix(L, 1, m, n);
+    DyArray *x   = l_checkarg_matrix(L, 2, n, 1);
+    DyArray *out = l_optarg_matrix_output(L, 5, m, a, x); // [ ...args, out ]
+
+    c_gemv(m, n, a->values, x->values, out->values);
+    return 1;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// ELEMENTWISE MATH ------------------------------------------------------- {{{2
+
+/**
+ * @brief   Branch-free kernels for the elementwise math methods, so that the
+ *          loops over them vectorize. A loop calling `exp()` from libm cannot,
+ *          since each call is opaque to the compiler.
+ *
+ * @note    Worst error seen against `long double` libm over 10^7 random
+ *          arguments each, spread over the whole range that does not
+ *          overflow. glibc's own `double` functions are given for reference:
+ *
+ *          exp, log        < 1.5 ulp   (glibc: 0.51 ulp)
+ *          sin, cos        < 2.5 ulp   (glibc: 0.52 ulp), for |x| <= 2^20;
+ *                                      blocks with larger |x| use libm
+ *          tanh            < 3.5 ulp   (glibc: 2.2 ulp)
+ *          sigmoid         < 2.5 ulp   (same as `1 / (1 + exp(-x))` in libm)
+ *          floor, ceil, round and pow are exact or libm, see `pow_dyarray()`
+ *
+ *          Special values follow C99: `exp(-inf) = 0`, `log(0) = -inf`,
+ *          `log(x < 0)` is NaN, NaN in gives NaN out.
+ *
+ * @note    All of this assumes `lua_Number` is an IEEE 754 double.
+ */
+
+typedef enum {
+    MATH_EXP,
+    MATH_LOG,
+    MATH_SIN,
+    MATH_COS,
+    MATH_TANH,
+    MATH_SIGMOID,
+    MATH_FLOOR,
+    MATH_CEIL,
+    MATH_ROUND,
+} MathOp;
+
+// Elements per block; `sin()` and `cos()` decide per block whether any
+// argument is too large for the fast path.
+#define MATH_BLOCK          256
+
+// Adding then subtracting this rounds to an integer, which is left in the
+// low bits of the sum. Valid for `|x| < 2^51`.
+#define MATH_ROUNDER        0x1.8p52
+
+#define MATH_LN2_HI         6.93147180369123816490e-01 // Low 32 bits are zero.
+#define MATH_LN2_LO         1.90821492927058770002e-10
+#define MATH_EXP_MAX        709.782712893383973096     // log(DBL_MAX)
+#define MATH_EXP_MIN        -745.133219101941108420    // log(DBL_TRUE_MIN)
+
+// pi/2 in three pieces of 33 bits, so `n * piece` is exact for `n < 2^20`.
+#define MATH_PIO2_1         1.57079632673412561417e+00
+#define MATH_PIO2_2         6.07710050630396597660e-11
+#define MATH_PIO2_3         2.02226624871116645580e-21
+#define MATH_TRIG_MAX       0x1p20
+
+static inline uint64_t c_as_bits(lua_Number x)
+{
+    uint64_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+static inline lua_Number c_from_bits(uint64_t u)
+{
+    lua_Number x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+/**
+ * @brief   `2^n` for integral `n` in `[-1022, 1023]`, built from its bits.
+ *
+ * @note    The bit tricks here and below stick to unsigned integers and
+ *          doubles: AVX2 has neither 64-bit arithmetic shifts nor conversions
+ *          between 64-bit integers and doubles, and a single one of those
+ *          keeps the whole loop from vectorizing.
+ */
+static inline lua_Number c_math_exp2i(lua_Number n)
+{
+    // The low bits of `n + MATH_ROUNDER` are `n` in two's complement, and the
+    // shift drops everything above the 11 bits of the exponent field.
+    return c_from_bits((c_as_bits(n + MATH_ROUNDER) + 1023) << 52);
+}
+
+/**
+ * @brief   `exp(x) = 2^n * exp(r)` with `|r| <= ln(2)/2`, `exp(r)` being the
+ *          Taylor polynomial of degree 13 (truncation error below 2^-57).
+ *          `2^n` is applied as two factors so that results in the subnormal
+ *          range and `n = 1024` need no special case.
+ */
+static inline lua_Number c_math_exp(lua_Number x)
+{
+    lua_Number xc = isgreater(x, MATH_EXP_MAX) ? MATH_EXP_MAX
+                  : isless(x, MATH_EXP_MIN) ? MATH_EXP_MIN : x;
+    lua_Number n  = (xc * 1.44269504088896340736 + MATH_ROUNDER) - MATH_ROUNDER;
+    lua_Number n1 = (n * 0.5 + MATH_ROUNDER) - MATH_ROUNDER;
+    lua_Number r  = (xc - n * MATH_LN2_HI) - n * MATH_LN2_LO;
+    lua_Number p;
+
+    p = 1.6059043836821613e-10;
+    p = p * r + 2.08767569878681e-09;
+    p = p * r + 2.505210838544172e-08;
+    p = p * r + 2.755731922398589e-07;
+    p = p * r + 2.7557319223985893e-06;
+    p = p * r + 2.48015873015873e-05;
+    p = p * r + 0.0001984126984126984;
+    p = p * r + 0.001388888888888889;
+    p = p * r + 0.008333333333333333;
+    p = p * r + 0.041666666666666664;
+    p = p * r + 0.16666666666666666;
+    p = p * r + 0.5;
+    p = p * r + 1;
+    p = p * r + 1;
+    p = p * c_math_exp2i(n1) * c_math_exp2i(n - n1);
+
+    p = isgreater(x, MATH_EXP_MAX) ? HUGE_VAL : isless(x, MATH_EXP_MIN) ? 0 : p;
+    return (x != x) ? x : p;
+}
+
+/**
+ * @brief   fdlibm's `log()`: `x = 2^e * m` with `sqrt(2)/2 <= m < sqrt(2)`,
+ *          then `log(m) = log(1 + f)` by a minimax polynomial in
+ *          `s = f / (2 + f)`.
+ */
+static inline lua_Number c_math_log(lua_Number x)
+{
+    const lua_Number Lg1 = 6.666666666666735130e-01, Lg2 = 3.999999999940941908e-01,
+                     Lg3 = 2.857142874366239149e-01, Lg4 = 2.222219843214978396e-01,
+                     Lg5 = 1.818357216161805012e-01, Lg6 = 1.531383769920937332e-01,
+                     Lg7 = 1.479819860511658591e-01;
+    // Scale subnormals into the normal range so the exponent field is exact.
+    int        sub = isless(x, DBL_MIN);
+    uint64_t   u   = c_as_bits(sub ? x * 0x1p54 : x);
+    lua_Number e   = c_from_bits(((u >> 52) & 0x7ff) | c_as_bits(MATH_ROUNDER))
+                   - (MATH_ROUNDER + 1023) - (sub ? 54 : 0);
+    lua_Number m   = c_from_bits((u & UINT64_C(0x000fffffffffffff)) | UINT64_C(0x3ff0000000000000));
+
+    int        big = isgreater(m, 1.41421356237309504880);
+    lua_Number f, s, z, w, R, hfsq, y;
+
+    f    = (big ? 0.5 * m : m) - 1;
+    e    = big ? e + 1 : e;
+    s    = f / (2 + f);
+    z    = s * s;
+    w    = z * z;
+    R    = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7)))
+         + w * (Lg2 + w * (Lg4 + w * Lg6));
+    hfsq = 0.5 * f * f;
+    y    = e * MATH_LN2_HI - ((hfsq - (s * (hfsq + R) + e * MATH_LN2_LO)) - f);
+
+    y = (x == HUGE_VAL || x != x) ? x : y;
+    y = (x == 0) ? -HUGE_VAL : y;
+    return isless(x, 0) ? NAN : y;
+}
+
+/**
+ * @brief   fdlibm's kernels for `sin()` and `cos()` on `|x| <= pi/4`.
+ */
+static inline lua_Number c_math_ksin(lua_Number x)
+{
+    lua_Number z = x * x;
+    lua_Number r = 8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04
+                 + z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08
+                 + z * 1.58969099521155010221e-10)));
+    return x + z * x * (-1.66666666666666324348e-01 + z * r);
+}
+
+static inline lua_Number c_math_kcos(lua_Number x)
+{
+    lua_Number z  = x * x;
+    lua_Number r  = z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03
+                  + z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07
+                  + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+    lua_Number hz = 0.5 * z;
+    lua_Number w  = 1 - hz;
+    return w + (((1 - w) - hz) + z * r);
+}
+
+/**
+ * @brief   `sin(x)`, or `cos(x)` if `is_cos`, for `|x| <= MATH_TRIG_MAX`:
+ *          reduce to `x = n * pi/2 + r` and pick the kernel and sign by the
+ *          quadrant `n mod 4`, where `cos(x) = sin(x + pi/2)`.
+ */
+static inline lua_Number c_math_sincos(lua_Number x, int is_cos)
+{
+    lua_Number t = x * 6.36619772367581382433e-01 + MATH_ROUNDER;
+    lua_Number n = t - MATH_ROUNDER;
+    uint64_t   q = c_as_bits(t) - c_as_bits(MATH_ROUNDER) + cast(uint64_t, is_cos);
+    lua_Number r = ((x - n * MATH_PIO2_1) - n * MATH_PIO2_2) - n * MATH_PIO2_3;
+    lua_Number v = (q & 1) ? c_math_kcos(r) : c_math_ksin(r);
+    return (q & 2) ? -v : v;
+}
+
+/**
+ * @brief   For `|x| >= 0.55`, `1 - 2 / (exp(2|x|) + 1)`. Below that the
+ *          subtraction would cancel, so use `e / (e + 2)` with `e = expm1(2|x|)`
+ *          from its Taylor series instead, accurate since `2|x| < 1.1`.
+ */
+static inline lua_Number c_math_tanh(lua_Number x)
+{
+    lua_Number a = fabs(x);
+    lua_Number y = 2 * a;
+    lua_Number e, small, big;
+
+    e = 4.110317623312165e-19;
+    e = e * y + 8.22063524662433e-18;
+    e = e * y + 1.5619206968586225e-16;
+    e = e * y + 2.8114572543455206e-15;
+    e = e * y + 4.779477332387385e-14;
+    e = e * y + 7.647163731819816e-13;
+    e = e * y + 1.1470745597729725e-11;
+    e = e * y + 1.6059043836821613e-10;
+    e = e * y + 2.08767569878681e-09;
+    e = e * y + 2.505210838544172e-08;
+    e = e * y + 2.755731922398589e-07;
+    e = e * y + 2.7557319223985893e-06;
+    e = e * y + 2.48015873015873e-05;
+    e = e * y + 0.0001984126984126984;
+    e = e * y + 0.001388888888888889;
+    e = e * y + 0.008333333333333333;
+    e = e * y + 0.041666666666666664;
+    e = e * y + 0.16666666666666666;
+    e = e * y + 0.5;
+    e = e * y + 1;
+    e = e * y;
+    small = e / (e + 2);
+    big   = 1 - 2 / (c_math_exp(y) + 1);
+    return copysign(isless(a, 0.55) ? small : big, x);
+}
+
+static inline lua_Number c_math_sigmoid(lua_Number x)
+{
+    return 1 / (1 + c_math_exp(-x));
+}
+
+#define MATH_LOOP(fn)                                                          \
+    do {                                                                       \
+        for (int i = 0; i < len; i++)                                          \
+            dst[i] = fn(src[i]);                                               \
+    } while (0)
+
+/**
+ * @brief   `dst[i] = op(src[i])` for `i` in `[0, len)`. `dst` may alias `src`.
+ */
+static void c_math_values(lua_Number *dst, const lua_Number *src, int len, MathOp op)
+{
+    DBG_PRINTFLN("math op %d over indexes 0 to %d", cast_int(op), len);
+    switch (op) {
+    case MATH_EXP:      MATH_LOOP(c_math_exp);     break;
+    case MATH_LOG:      MATH_LOOP(c_math_log);     break;
+    case MATH_TANH:     MATH_LOOP(c_math_tanh);    break;
+    case MATH_SIGMOID:  MATH_LOOP(c_math_sigmoid); break;
+    case MATH_FLOOR:    MATH_LOOP(floor);          break;
+    case MATH_CEIL:     MATH_LOOP(ceil);           break;
+    case MATH_ROUND:    MATH_LOOP(round);          break;
+    case MATH_SIN:
+    case MATH_COS:
+        for (int start = 0; start < len; start += MATH_BLOCK) {
+            int        is_cos = (op == MATH_COS);
+            int        stop   = (len - start < MATH_BLOCK) ? len : start + MATH_BLOCK;
+            int        slow   = 0;
+            // Also true for NaN and infinities.
+            for (int i = start; i < stop; i++)
+                slow |= !(fabs(src[i]) <= MATH_TRIG_MAX);
+            if (!slow) {
+                for (int i = start; i < stop; i++)
+                    dst[i] = c_math_sincos(src[i], is_cos);
+            } else {
+                for (int i = start; i < stop; i++)
+                    dst[i] = is_cos ? cos(src[i]) : sin(src[i]);
+            }
+        }
+        break;
+    }
+}
+
+#undef MATH_LOOP
+
+/**
+ * @brief   `dst[i] = src[i] ^ p` for `i` in `[0, len)`. `dst` may alias `src`.
+ *
+ * @note    The exponents 1, 2, 3 and -1 are plain multiplications or a
+ *          division, which are exact or correctly rounded and vectorize. Any
+ *          other exponent goes through libm's `pow()`. Note that 0.5 is not
+ *          special-cased as `sqrt()`, which differs for `-0` and `-inf`.
+ */
+static void c_pow_values(lua_Number *dst, const lua_Number *src, int len, lua_Number p)
+{
+    if (p == 1) {
+        memmove(dst, src, sizeof(*dst) * len);
+    } else if (p == 2) {
+        for (int i = 0; i < len; i++)
+            dst[i] = src[i] * src[i];
+    } else if (p == 3) {
+        for (int i = 0; i < len; i++)
+            dst[i] = src[i] * src[i] * src[i];
+    } else if (p == -1) {
+        for (int i = 0; i < len; i++)
+            dst[i] = 1 / src[i];
+    } else {
+        for (int i = 0; i < len; i++)
+            dst[i] = pow(src[i], p);
+    }
+}
+
+/**
+ * @exception <args[:]>:          type
+ *            l_optarg_output():  memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ *          Stack before:   [ self: dyarray, out: dyarray? ]
+ *          Stack after:    [ self, out, out ]
+ *
+ * @note    Pass `self` as `out` to apply `op` in-place.
+ */
+static int c_math_dyarray(lua_State *L, MathOp op)
+{
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    int      len  = self->length;
+    DyArray *out  = l_optarg_output(L, 2, len);
+    c_math_values(out->values, self->values, len, op);
+    return 1;
+}
+
+static int exp_dyarray(lua_State *L)
+{
+    return c_math_dyarray(L, MATH_EXP);
+}
+
+static int log_dyarray(lua_State *L)
+{
+    return c_math_dyarray(L, MATH_LOG);
+}
+
+static int sin_dyarray(lua_State *L)
+{
+    return c_math_dyarray(L, MATH_SIN);
+}
+
+static int cos_dyarray(lua_State *L)
+{
+    return c_math_dyarray(L, MATH_COS);
+}
+
+static int tanh_dyarray(lua_State *L)
+{
+    return c_math_dyarray(L, MATH_TANH);
+}
+
+// `1 / (1 + exp(-x))`
+static int sigmoid_dyarray(lua_State *L)
+{
+    return c_math_dyarray(L, MATH_SIGMOID);
+}
+
+static int floor_dyarray(lua_State *L)
+{
+    return c_math_dyarray(L, MATH_FLOOR);
+}
+
+static int ceil_dyarray(lua_State *L)
+{
+    return c_math_dyarray(L, MATH_CEIL);
+}
+
+// Halfway cases round away from zero, like C's `round()`.
+static int round_dyarray(lua_State *L)
+{
+    return c_math_dyarray(L, MATH_ROUND);
+}
+
+/**
+ * @brief   `out[i] = self[i] ^ p`, or `self[i] ^ p[i]` if `p` is a dyarray.
+ *
+ * @exception <args[:]>:          type
+ *            <args[2]>:          length mismatch
+ *            l_optarg_output():  memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ *          Stack before:   [ self: dyarray, p: number|dyarray, out: dyarray? ]
+ *          Stack after:    [ self, p, out, out ]
+ *
+ * @note    See `c_pow_values()` for which exponents avoid libm.
+ */
+static int pow_dyarray(lua_State *L)
+{
+    DyArray    *self  = l_checkarg_dyarray(L, 1);
+    int         len   = self->length;
+    DyArray    *other = NULL;
+    lua_Number  p     = 0;
+    lua_Number *dst, *src;
+
+    if (lua_type(L, 2) == LUA_TNUMBER) {
+        p = lua_tonumber(L, 2);
+    } else {
+        other = l_checkarg_dyarray(L, 2);
+        luaL_argcheck(L, other->length == len, 2, "length mismatch");
+    }
+
+    // Growing `out` may move its values, so only look at pointers afterwards.
+    dst = l_optarg_output(L, 3, len)->values;
+    src = self->values;
+    if (other != NULL) {
+        for (int i = 0; i < len; i++)
+            dst[i] = pow(src[i], other->values[i]);
+    } else {
+        c_pow_values(dst, src, len, p);
+    }
+    return 1;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// 1}}} ------------------------------------------------------------------------
+
+// METATABLES ------------------------------------------------------------- {{{1
+
+/**
+ * @exception <args[1]>:         type
+ *            lua_pushfstring(): memory
+ *            luaL_add*:         memory
+ *
+ * @note    Stack usage:    [ -1, +1, m|v ]
+ *          Stack before:   [ self ]
+ *          Stack after:    [ tostring(self) ]
+ */
+static int mt_tostring(lua_State *L)
+{
+    DyArray    *self = l_checkarg_dyarray(L, 1);
+    int         len  = self->length;
+    luaL_Buffer buf;
+
+    luaL_buffinit(L, &buf);
+    lua_pushfstring(L, LIB_MESSAGE("length = %d, values = {", len));
+    luaL_addvalue(&buf); // [ self, fmt ] -> [ self ]
+
+    for (int i = 0; i < len; i++) {
+        lua_pushnumber(L, self->values[i]);
+        luaL_addvalue(&buf); // [ self, self.values[i] ] -> [ self ]
+        if (i < len - 1)
+            luaL_addstring(&buf, ", ");
+    }
+
+    luaL_addchar(&buf, '}');
+    luaL_pushresult(&buf);
+    return 1;
+}
+
+/**
+ * @exception <args[2]>: type, index, field
+ *
+ * @note    Stack usage:  [ -2, +1, v ]
+ *          Stack before: [ self: dyarray, key: number|string ]
+ *          Stack after:  [ self[key]: number|function ]
+ *
+*/
+static int mt_index(lua_State *L)
+{
+    switch (lua_type(L, 2)) {
+    case LUA_TNUMBER: return get_dyarray(L);
+    case LUA_TSTRING: return get_field(L);
+    default:          break;
+    }
+
+    lua_getglobal(L, "tostring"); // [ self, key, tostring ]
+    lua_pushvalue(L, 2);          // [ self, key, tostring, key ]
+    return bad_field(L, call_tostring(L, 3, 4));
+}
+
+/**
+ * @brief   `dyarray.values` is not managed by Lua, we must free it ourselves.
+ *          Think of this like a pseudo-destructor.
+ *
+ * @exception <args[1]>: type
+ *
+ * @note    Stack usage:    [ -1, 0, - ]
+ *          Stack before:   [ self: dyarray ]
+ *          Stack after:    []
+ *          Side effect:    free(self.values)
+ */
+static int mt_gc(lua_State *L)
+{
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    DBG_PRINTFLN("free buffer of length %d", self->length);
 
     // osize > 0 && nsize == 0 invokes the equivalent of free(ptr).
     free_pointer(L, self->values, size_of_total(self));
@@ -575,6 +2383,1937 @@ static int mt_gc(lua_State *L)
 
 // 1}}} ------------------------------------------------------------------------
 
+// HEAP ------------------------------------------------------------------- {{{1
+
+#define HEAP_MTNAME     LIB_MTNAME ".heap"
+
+/**
+ * @brief   Binary heap laid out in the usual implicit way: the children of C
+ *          index `i` live at `2*i + 1` and `2*i + 2`. Values reuse `DyArray`
+ *          storage so the same growth policy applies.
+ */
+typedef struct {
+    DyArray      store;    // store.values[0] is the top of the heap.
+    lua_Integer *payloads; // Parallel to `store.values`, NULL until first used.
+    int          is_max;   // Max-heap if nonzero, else min-heap.
+} Heap;
+
+static const char *const heap_kinds[] = {"min", "max", NULL};
+
+// HEAP KERNELS ----------------------------------------------------------- {{{2
+
+// Does `a` belong nearer to the top than `b`?
+#define heap_before(is_max, a, b)   ((is_max) ? (a) > (b) : (a) < (b))
+
+static void c_heap_swap(lua_Number *values, lua_Integer *payloads, int i, int j)
+{
+    lua_Number tmp = values[i];
+    values[i] = values[j];
+    values[j] = tmp;
+    if (payloads != NULL) {
+        lua_Integer p = payloads[i];
+        payloads[i] = payloads[j];
+        payloads[j] = p;
+    }
+}
+
+static void c_heap_sift_up(lua_Number *values, lua_Integer *payloads, int i, int is_max)
+{
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!heap_before(is_max, values[i], values[parent]))
+            break;
+        c_heap_swap(values, payloads, i, parent);
+        i = parent;
+    }
+}
+
+// Assumes `len` is the number of active heap elements.
+static void c_heap_sift_down(lua_Number *values, lua_Integer *payloads, int len,
+                             int i, int is_max)
+{
+    for (;;) {
+        int left  = 2 * i + 1;
+        int right = left + 1;
+        int best  = i;
+        if (left < len && heap_before(is_max, values[left], values[best]))
+            best = left;
+        if (right < len && heap_before(is_max, values[right], values[best]))
+            best = right;
+        if (best == i)
+            break;
+        c_heap_swap(values, payloads, i, best);
+        i = best;
+    }
+}
+
+// Floyd's bottom-up construction, O(n) as opposed to `n` calls to sift-up.
+static void c_heapify(lua_Number *values, lua_Integer *payloads, int len, int is_max)
+{
+    DBG_PRINTFLN("heapify indexes 0 to %d", len);
+    for (int i = len / 2 - 1; i >= 0; i--)
+        c_heap_sift_down(values, payloads, len, i, is_max);
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// HEAP METHODS ----------------------------------------------------------- {{{2
+
+static Heap *l_checkarg_heap(lua_State *L, int argn)
+{
+    return l_checkarg_udata(L, argn, UPVALUE_HEAP_MT, HEAP_MTNAME);
+}
+
+/**
+ * @brief   Ensure `self` can hold `nlen` elements, keeping `payloads` in step
+ *          with `store.values`.
+ *
+ * @exception resize_pointer(): memory
+ */
+static void c_heap_reserve(lua_State *L, Heap *self, int nlen)
+{
+    int ocap = self->store.capacity;
+    c_reserve_values(L, &self->store, nlen);
+    if (self->payloads != NULL && self->store.capacity != ocap) {
+        size_t osz = size_of_array(self->payloads, ocap);
+        size_t nsz = size_of_array(self->payloads, self->store.capacity);
+        self->payloads = resize_pointer(L, self->payloads, osz, nsz);
+    }
+}
+
+// Lazily allocate `payloads` the first time one is given to us.
+static lua_Integer *c_heap_payloads(lua_State *L, Heap *self)
+{
+    if (self->payloads == NULL) {
+        int cap = self->store.capacity;
+        self->payloads = new_pointer(L, size_of_array(self->payloads, cap));
+        for (int i = 0; i < cap; i++)
+            self->payloads[i] = 0;
+    }
+    return self->payloads;
+}
+
+/**
+ * @brief   Push the top of `self` as one or two values, depending on whether
+ *          payloads are in use.
+ *
+ * @note    Assumes `self.store.length > 0`.
+ */
+static int c_heap_pushtop(lua_State *L, Heap *self)
+{
+    lua_pushnumber(L, self->store.values[0]);
+    if (self->payloads == NULL)
+        return 1;
+    lua_pushinteger(L, self->payloads[0]);
+    return 2;
+}
+
+/**
+ * @exception <args[1]>: option
+ *            lua_newuserdata(), new_pointer(): memory
+ *
+ * @note    Stack usage:    [ -(0|1), +1, m|v ]
+ *          Stack before:   [ kind: ("min"|"max")? ]
+ *          Stack after:    [ heap ]
+ */
+static int new_heap(lua_State *L)
+{
+    int   is_max = luaL_checkoption(L, 1, "min", heap_kinds);
+    int   cap    = next_power_of_2(0);
+    Heap *self   = lua_newuserdata(L, sizeof(*self)); // [ kind, self ]
+
+    DBG_PRINTFLN("new %s-heap of capacity %d", heap_kinds[is_max], cap);
+    // Set these first so `__gc` is safe even if the allocation below throws.
+    self->store.length   = 0;
+    self->store.capacity = 0;
+    self->store.values   = NULL;
+    self->payloads       = NULL;
+    self->is_max         = is_max;
+    lua_pushvalue(L, UPVALUE_HEAP_MT); // [ kind, self, mt ]
+    lua_setmetatable(L, -2);           // [ kind, self ]
+
+    self->store.values   = new_pointer(L, size_of_values(&self->store, cap));
+    self->store.capacity = cap;
+    return 1;
+}
+
+/**
+ * @exception <args[:]>:        type
+ *            c_heap_reserve(): memory
+ *
+ * @note    Stack usage:    [ -(2|3), +1, m|v ]
+ *          Stack before:   [ self: heap, v: number, payload: integer? ]
+ *          Stack after:    [ self ]
+ */
+static int push_heap(lua_State *L)
+{
+    Heap      *self = l_checkarg_heap(L, 1);
+    lua_Number n    = luaL_checknumber(L, 2);
+    int        len  = self->store.length;
+
+    c_heap_reserve(L, self, len + 1);
+    if (!lua_isnoneornil(L, 3))
+        c_heap_payloads(L, self)[len] = luaL_checkinteger(L, 3);
+    else if (self->payloads != NULL)
+        self->payloads[len] = 0;
+
+    self->store.values[len] = n;
+    self->store.length      = len + 1;
+    c_heap_sift_up(self->store.values, self->payloads, len, self->is_max);
+    lua_pushvalue(L, 1);
+    return 1;
+}
+
+/**
+ * @exception <args[1]>: type
+ *            len <= 0:  index
+ *
+ * @note    Stack usage:    [ -1, +(1|2), v ]
+ *          Stack before:   [ self: heap ]
+ *          Stack after:    [ top: number, payload: integer? ]
+ */
+static int pop_heap(lua_State *L)
+{
+    Heap *self = l_checkarg_heap(L, 1);
+    int   len  = self->store.length;
+    int   nret;
+
+    if (len <= 0)
+        return LIB_ERROR(L, "Nothing to pop, have %d elements", len);
+    nret = c_heap_pushtop(L, self);
+    c_heap_swap(self->store.values, self->payloads, 0, len - 1);
+    self->store.length = len - 1;
+    c_heap_sift_down(self->store.values, self->payloads, len - 1, 0, self->is_max);
+    return nret;
+}
+
+/**
+ * @note    Stack usage:    [ -1, +(1|2), v ]
+ *          Stack before:   [ self: heap ]
+ *          Stack after:    [ top: number?, payload: integer? ]
+ *
+ * @note    Returns nil if the heap is empty.
+ */
+static int peek_heap(lua_State *L)
+{
+    Heap *self = l_checkarg_heap(L, 1);
+    if (self->store.length <= 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    return c_heap_pushtop(L, self);
+}
+
+/**
+ * @brief   Pop the top and push `v` in a single sift-down, which is cheaper
+ *          than a separate `pop()` and `push()`.
+ *
+ * @exception <args[:]>: type
+ *            len <= 0:  index
+ *
+ * @note    Stack usage:    [ -(2|3), +(1|2), m|v ]
+ *          Stack before:   [ self: heap, v: number, payload: integer? ]
+ *          Stack after:    [ old_top: number, old_payload: integer? ]
+ */
+static int replace_top_heap(lua_State *L)
+{
+    Heap      *self = l_checkarg_heap(L, 1);
+    lua_Number n    = luaL_checknumber(L, 2);
+    int        len  = self->store.length;
+    int        nret;
+
+    if (len <= 0)
+        return LIB_ERROR(L, "Nothing to replace, have %d elements", len);
+    if (!lua_isnoneornil(L, 3))
+        c_heap_payloads(L, self);
+    nret = c_heap_pushtop(L, self);
+    self->store.values[0] = n;
+    if (self->payloads != NULL)
+        self->payloads[0] = luaL_optinteger(L, 3, 0);
+    c_heap_sift_down(self->store.values, self->payloads, len, 0, self->is_max);
+    return nret;
+}
+
+/**
+ * @brief   Replace the contents of `self` with a copy of `src` in O(n).
+ *
+ * @exception <args[:]>:        type
+ *            c_heap_reserve(): memory
+ *
+ * @note    Stack usage:    [ -(2|3), +1, m|v ]
+ *          Stack before:   [ self: heap, src: dyarray, payloads: dyarray? ]
+ *          Stack after:    [ self ]
+ *
+ * @note    If given, `payloads` must be the same length as `src`.
+ */
+static int heapify_heap(lua_State *L)
+{
+    Heap    *self = l_checkarg_heap(L, 1);
+    DyArray *src  = l_checkarg_dyarray(L, 2);
+    DyArray *p    = NULL;
+    int      len  = src->length;
+
+    // Check and allocate everything first so that `self` is left as it was
+    // if anything throws.
+    if (!lua_isnoneornil(L, 3)) {
+        p = l_checkarg_dyarray(L, 3);
+        luaL_argcheck(L, p->length == len, 3, "length mismatch with values");
+    }
+    c_heap_reserve(L, self, len);
+    if (p != NULL)
+        c_heap_payloads(L, self);
+
+    c_copy_values(self->store.values, src->values, len);
+    self->store.length = len;
+    if (p != NULL) {
+        for (int i = 0; i < len; i++)
+            self->payloads[i] = cast(lua_Integer, p->values[i]);
+    } else if (self->payloads != NULL) {
+        for (int i = 0; i < len; i++)
+            self->payloads[i] = 0;
+    }
+    c_heapify(self->store.values, self->payloads, len, self->is_max);
+    lua_pushvalue(L, 1);
+    return 1;
+}
+
+static int length_heap(lua_State *L)
+{
+    lua_pushinteger(L, l_checkarg_heap(L, 1)->store.length);
+    return 1;
+}
+
+static int mt_heap_tostring(lua_State *L)
+{
+    Heap *self = l_checkarg_heap(L, 1);
+    lua_pushfstring(L, LIB_MESSAGE("%s-heap, length = %d",
+                                   heap_kinds[self->is_max],
+                                   self->store.length));
+    return 1;
+}
+
+static int mt_heap_gc(lua_State *L)
+{
+    Heap *self = l_checkarg_heap(L, 1);
+    int   cap  = self->store.capacity;
+    DBG_PRINTFLN("free heap of length %d", self->store.length);
+    free_pointer(L, self->store.values, size_of_total(&self->store));
+    if (self->payloads != NULL)
+        free_pointer(L, self->payloads, size_of_array(self->payloads, cap));
+    return 0;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+/**
+ * @brief   The `k` largest values of `self` in descending order. Runs in
+ *          O(n log k) using a bounded min-heap held in the output buffer.
+ *
+ * @exception <args[:]>:       type
+ *            (k < 0):         argument
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -2, +1, m|v ]
+ *          Stack before:   [ self: dyarray, k: integer ]
+ *          Stack after:    [ top: dyarray ]
+ */
+static int topk_dyarray(lua_State *L)
+{
+    DyArray    *self = l_checkarg_dyarray(L, 1);
+    int         k    = luaL_checkint(L, 2);
+    int         len  = self->length;
+    int         cap;
+    DyArray    *out;
+    lua_Number *top;
+
+    luaL_argcheck(L, k >= 0, 2, "negative count");
+    if (k > len)
+        k = len;
+    cap = next_power_of_2(k);
+    out = c_new_dyarray(L, k, cap);
+    top = c_clear_values(out->values, k, cap);
+
+    c_copy_values(top, self->values, k);
+    c_heapify(top, NULL, k, 0);
+    for (int i = k; i < len; i++) {
+        if (self->values[i] > top[0]) {
+            top[0] = self->values[i];
+            c_heap_sift_down(top, NULL, k, 0, 0);
+        }
+    }
+
+    // Heapsort in place: moving each minimum to the back leaves us descending.
+    for (int n = k - 1; n > 0; n--) {
+        c_heap_swap(top, NULL, 0, n);
+        c_heap_sift_down(top, NULL, n, 0, 0);
+    }
+    return 1;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// STATISTICS ------------------------------------------------------------- {{{1
+
+// Ranges at most this long are finished off by insertion sort.
+#define SELECT_CUTOFF   16
+
+// In-place ascending heapsort, the fallback that bounds introselect.
+static void c_heapsort(lua_Number *values, int len)
+{
+    c_heapify(values, NULL, len, 1);
+    for (int end = len - 1; end > 0; end--) {
+        c_heap_swap(values, NULL, 0, end);
+        c_heap_sift_down(values, NULL, end, 0, 1);
+    }
+}
+
+static void c_insertion_sort(lua_Number *values, int len)
+{
+    for (int i = 1; i < len; i++) {
+        lua_Number v = values[i];
+        int        j = i;
+        for (; j > 0 && values[j - 1] > v; j--)
+            values[j] = values[j - 1];
+        values[j] = v;
+    }
+}
+
+/**
+ * @brief   Introselect: partially order `values[lo:hi]`, which must not hold
+ *          NaN, so that `values[k]` is what a full sort would put there, with
+ *          nothing greater before it and nothing smaller after it.
+ *
+ * @note    Quickselect with a median-of-3 pivot, `O(n)` on average. After
+ *          `2*log2(n)` rounds that fail to shrink the range we give up on the
+ *          pivots and heapsort what is left, which bounds the worst case at
+ *          `O(n log n)` like `std::nth_element()`.
+ */
+static void c_select_kth(lua_Number *values, int lo, int hi, int k)
+{
+    int depth = 2 * ilog2_u64(cast(uint64_t, hi - lo) | 1);
+
+    while (hi - lo > SELECT_CUTOFF) {
+        int        mid = lo + (hi - lo) / 2;
+        lua_Number a = values[lo], b = values[mid], c = values[hi - 1];
+        lua_Number pivot;
+        int        i = lo, j = hi - 1;
+
+        if (depth-- == 0) {
+            c_heapsort(values + lo, hi - lo);
+            return;
+        }
+        // Median of 3, so both scans below are bounded by an element.
+        pivot = (a < b) ? ((b < c) ? b : (a < c) ? c : a)
+                        : ((a < c) ? a : (b < c) ? c : b);
+        while (i <= j) {
+            while (values[i] < pivot)
+                i++;
+            while (values[j] > pivot)
+                j--;
+            if (i <= j) {
+                c_heap_swap(values, NULL, i, j);
+                i++;
+                j--;
+            }
+        }
+        // Now `values[lo:j+1] <= pivot`, `values[i:hi] >= pivot` and anything
+        // in between equals `pivot`.
+        if (k <= j)
+            hi = j + 1;
+        else if (k >= i)
+            lo = i;
+        else
+            return;
+    }
+    c_insertion_sort(values + lo, hi - lo);
+}
+
+/**
+ * @brief   Copy the non-NaN values of `self` into a scratch dyarray pushed
+ *          onto the stack, for the selection functions to reorder.
+ *
+ * @exception c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ */
+static DyArray *l_push_sample(lua_State *L, DyArray *self)
+{
+    DyArray    *tmp = c_new_dyarray(L, 0, next_power_of_2(self->length));
+    lua_Number *dst = tmp->values;
+    int         n   = 0;
+
+    for (int i = 0; i < self->length; i++) {
+        dst[n] = self->values[i];
+        n     += (self->values[i] == self->values[i]);
+    }
+    tmp->length = n;
+    return tmp;
+}
+
+/**
+ * @brief   The `q`-quantile of `values[lo:len]`, interpolating linearly
+ *          between closest ranks as R's type 7 and NumPy's default do. Leaves
+ *          `values[rank]` in its sorted position, so that a later call for a
+ *          larger `q` can pass `rank` as `lo`.
+ *
+ * @note    Everything in `values[0:lo]` must be no greater than the rest.
+ */
+static lua_Number c_quantile(lua_Number *values, int len, int lo, lua_Number q, int *rank)
+{
+    lua_Number h = q * (len - 1);
+    int        k = cast_int(floor(h));
+    lua_Number v, next;
+
+    if (len == 0)
+        return NAN;
+    c_select_kth(values, lo, len, k);
+    *rank = k;
+    v     = values[k];
+    if (k + 1 >= len || h == k)
+        return v;
+    // Everything past `k` is at least `v`, so the next rank is their minimum.
+    next = values[k + 1];
+    for (int i = k + 2; i < len; i++)
+        next = (values[i] < next) ? values[i] : next;
+    return v + (h - k) * (next - v);
+}
+
+static lua_Number l_checkarg_q(lua_State *L, int argn)
+{
+    lua_Number q = luaL_checknumber(L, argn);
+    luaL_argcheck(L, 0 <= q && q <= 1, argn, "quantile must be in [0, 1]");
+    return q;
+}
+
+/**
+ * @exception <args[1]>: type
+ *
+ * @note    Stack usage:    [ -1, +1, v ]
+ *          Stack before:   [ self: dyarray ]
+ *          Stack after:    [ mean: number ]
+ */
+static int mean_dyarray(lua_State *L)
+{
+    DyArray   *self = l_checkarg_dyarray(L, 1);
+    lua_Number sum  = 0;
+    for (int i = 0; i < self->length; i++)
+        sum += self->values[i];
+    lua_pushnumber(L, (self->length > 0) ? sum / self->length : NAN);
+    return 1;
+}
+
+/**
+ * @brief   Variance with `ddof` delta degrees of freedom: 0, the default, for
+ *          the population variance and 1 for the unbiased sample variance.
+ *          NaN if there are no more than `ddof` elements.
+ *
+ * @note    Two passes, the second with the usual correction term, which is
+ *          far more accurate than the one-pass `E[x^2] - E[x]^2` and still
+ *          vectorizes.
+ */
+static lua_Number c_variance(const lua_Number *values, int len, int ddof)
+{
+    lua_Number mean = 0, ss = 0, comp = 0;
+
+    if (len - ddof <= 0)
+        return NAN;
+    for (int i = 0; i < len; i++)
+        mean += values[i];
+    mean /= len;
+    for (int i = 0; i < len; i++) {
+        lua_Number d = values[i] - mean;
+        ss   += d * d;
+        comp += d;
+    }
+    return (ss - comp * comp / len) / (len - ddof);
+}
+
+/**
+ * @exception <args[1:2]>: type
+ *
+ * @note    Stack usage:    [ -(1|2), +1, v ]
+ *          Stack before:   [ self: dyarray, ddof: integer? ]
+ *          Stack after:    [ variance: number ]
+ */
+static int variance_dyarray(lua_State *L)
+{
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    int      ddof = luaL_optint(L, 2, 0);
+    luaL_argcheck(L, ddof >= 0, 2, "negative degrees of freedom");
+    lua_pushnumber(L, c_variance(self->values, self->length, ddof));
+    return 1;
+}
+
+// Square root of `variance_dyarray()`.
+static int std_dyarray(lua_State *L)
+{
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    int      ddof = luaL_optint(L, 2, 0);
+    luaL_argcheck(L, ddof >= 0, 2, "negative degrees of freedom");
+    lua_pushnumber(L, sqrt(c_variance(self->values, self->length, ddof)));
+    return 1;
+}
+
+/**
+ * @brief   The `q`-quantile in `O(n)` on average, without sorting. NaNs are
+ *          ignored; the result is NaN if nothing else is left. `self` is not
+ *          modified.
+ *
+ * @exception <args[1:2]>:     type, other
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -2, +1, m|v ]
+ *          Stack before:   [ self: dyarray, q: number ]
+ *          Stack after:    [ quantile: number ]
+ */
+static int quantile_dyarray(lua_State *L)
+{
+    DyArray   *self = l_checkarg_dyarray(L, 1);
+    lua_Number q    = l_checkarg_q(L, 2);
+    DyArray   *tmp  = l_push_sample(L, self); // [ self, q, tmp ]
+    int        rank;
+    lua_pushnumber(L, c_quantile(tmp->values, tmp->length, 0, q, &rank));
+    return 1;
+}
+
+// `self:quantile(0.5)`.
+static int median_dyarray(lua_State *L)
+{
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    DyArray *tmp  = l_push_sample(L, self); // [ self, tmp ]
+    int      rank;
+    lua_pushnumber(L, c_quantile(tmp->values, tmp->length, 0, 0.5, &rank));
+    return 1;
+}
+
+typedef struct {
+    lua_Number q;
+    int        pos; // Where the result goes.
+} QuantileReq;
+
+static int c_compare_reqs(const void *a, const void *b)
+{
+    lua_Number x = cast(const QuantileReq *, a)->q;
+    lua_Number y = cast(const QuantileReq *, b)->q;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief   Several quantiles at once, in the order given. They are computed in
+ *          ascending order, each selection only looking at what lies past the
+ *          previous rank, so asking for p50, p90, p99 and p999 together costs
+ *          little more than asking for one.
+ *
+ * @exception <args[1:2]>:     type, other
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -2, +1, m|v ]
+ *          Stack before:   [ self: dyarray, qs: dyarray|number[] ]
+ *          Stack after:    [ quantiles: dyarray ]
+ */
+static int quantiles_dyarray(lua_State *L)
+{
+    DyArray     *self = l_checkarg_dyarray(L, 1);
+    int          is_table = lua_istable(L, 2);
+    DyArray     *qs   = is_table ? NULL : l_checkarg_dyarray(L, 2);
+    int          m    = is_table ? cast_int(lua_objlen(L, 2)) : qs->length;
+    QuantileReq *reqs = lua_newuserdata(L, size_of_array(reqs, m > 0 ? m : 1)); // [ self, qs, reqs ]
+    DyArray     *out  = c_new_dyarray(L, m, next_power_of_2(m));              // [ ..., reqs, out ]
+    DyArray     *tmp;
+    int          lo   = 0;
+
+    for (int i = 0; i < m; i++) {
+        if (is_table) {
+            lua_rawgeti(L, 2, i + 1); // [ ..., out, qs[i + 1] ]
+            reqs[i].q = lua_isnumber(L, -1) ? lua_tonumber(L, -1) : NAN;
+            lua_pop(L, 1);            // [ ..., out ]
+        } else {
+            reqs[i].q = qs->values[i];
+        }
+        reqs[i].pos = i;
+        luaL_argcheck(L, 0 <= reqs[i].q && reqs[i].q <= 1, 2,
+                      "quantiles must be numbers in [0, 1]");
+    }
+    qsort(reqs, cast(size_t, m), sizeof(reqs[0]), &c_compare_reqs);
+
+    tmp = l_push_sample(L, self); // [ ..., out, tmp ]
+    for (int i = 0; i < m; i++)
+        out->values[reqs[i].pos] = c_quantile(tmp->values, tmp->length, lo, reqs[i].q, &lo);
+    c_clear_values(out->values, m, out->capacity);
+    lua_pop(L, 1);                // [ ..., out ]
+    return 1;
+}
+
+/**
+ * @brief   Counts of the values in each of `bins` equal-width bins spanning
+ *          `[lo, hi]`, by default the range of the data. The last bin is
+ *          closed, so `hi` itself is counted; values outside the range and
+ *          NaNs are not.
+ *
+ * @exception <args[1:4]>:     type, other
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -(2|4), +1, m|v ]
+ *          Stack before:   [ self: dyarray, bins: integer, lo: number?, hi: number? ]
+ *          Stack after:    [ counts: dyarray ]
+ */
+static int histogram_dyarray(lua_State *L)
+{
+    DyArray    *self = l_checkarg_dyarray(L, 1);
+    int         bins = luaL_checkint(L, 2);
+    lua_Number  lo, hi, scale;
+    lua_Number *counts;
+
+    luaL_argcheck(L, bins > 0, 2, "need at least one bin");
+    if (lua_isnoneornil(L, 3) || lua_isnoneornil(L, 4)) {
+        lua_Number min = HUGE_VAL, max = -HUGE_VAL;
+        for (int i = 0; i < self->length; i++) {
+            lua_Number v = self->values[i];
+            min = (v < min) ? v : min;
+            max = (v > max) ? v : max;
+        }
+        // Like NumPy, widen an empty or single-valued range to width 1.
+        if (!(min < max)) {
+            min = (min <= max) ? min - 0.5 : 0;
+            max = min + 1;
+        }
+        lo = luaL_optnumber(L, 3, min);
+        hi = luaL_optnumber(L, 4, max);
+    } else {
+        lo = luaL_checknumber(L, 3);
+        hi = luaL_checknumber(L, 4);
+    }
+    luaL_argcheck(L, lo < hi, 4, "empty range");
+
+    counts = c_new_dyarray(L, bins, next_power_of_2(bins))->values;
+    c_clear_values(counts, 0, next_power_of_2(bins));
+    scale = bins / (hi - lo);
+    for (int i = 0; i < self->length; i++) {
+        lua_Number v = self->values[i];
+        if (lo <= v && v <= hi) {
+            int b = cast_int((v - lo) * scale);
+            counts[(b < bins) ? b : bins - 1] += 1;
+        }
+    }
+    return 1;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// RANDOM ----------------------------------------------------------------- {{{1
+
+#define RNG_MTNAME      LIB_MTNAME ".rng"
+#define RNG_LANES       4
+#define RNG_DEFAULT_SEED 0x853c49e6748fea9bULL
+
+/**
+ * @brief   xoshiro256++ (Blackman and Vigna), run as `RNG_LANES` independent
+ *          streams in lockstep. Lane `l` starts `l * 2^128` steps after lane
+ *          0, so the streams never overlap, and keeping the state as
+ *          `s[word][lane]` lets the compiler step all lanes with one vector
+ *          instruction per operation.
+ *
+ * @note    Outputs are handed out lane by lane, one step at a time, through
+ *          `buffer`. Bulk fills produce exactly the same sequence as drawing
+ *          one number at a time, so results only depend on the seed.
+ */
+typedef struct {
+    uint64_t s[4][RNG_LANES];
+    uint64_t buffer[RNG_LANES];
+    int      next; // Index of the next unused output in `buffer`.
+} Rng;
+
+static const char *const rng_dists[] = {"uniform", "normal", NULL};
+
+// RANDOM KERNELS --------------------------------------------------------- {{{2
+
+static uint64_t c_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+// One output per lane, into `out[0:RNG_LANES]`.
+static void c_rng_step(Rng *self, uint64_t *out)
+{
+    uint64_t (*s)[RNG_LANES] = self->s;
+    for (int l = 0; l < RNG_LANES; l++) {
+        uint64_t t = s[1][l] << 17;
+        out[l]   = c_rotl(s[0][l] + s[3][l], 23) + s[0][l];
+        s[2][l] ^= s[0][l];
+        s[3][l] ^= s[1][l];
+        s[1][l] ^= s[2][l];
+        s[0][l] ^= s[3][l];
+        s[2][l] ^= t;
+        s[3][l]  = c_rotl(s[3][l], 45);
+    }
+}
+
+static uint64_t c_rng_next(Rng *self)
+{
+    if (self->next == RNG_LANES) {
+        c_rng_step(self, self->buffer);
+        self->next = 0;
+    }
+    return self->buffer[self->next++];
+}
+
+// Uniform on `[0, 1)` with all 53 bits of precision.
+#define rng_to_unit(x)      (cast(lua_Number, (x) >> 11) * 0x1.0p-53)
+
+// Uniform on `(0, 1)`, for taking logarithms.
+#define rng_to_open_unit(x) ((cast(lua_Number, (x) >> 11) + 0.5) * 0x1.0p-53)
+
+// Jump polynomials: 2^128 steps, for the lanes, and 2^192, for `split()`.
+static const uint64_t rng_jump[4] = {
+    0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+    0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL,
+};
+
+static const uint64_t rng_long_jump[4] = {
+    0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+    0x77710069854ee241ULL, 0x39109bb02acbe635ULL,
+};
+
+// Jump the state of lane `l` ahead, stepping it alone as plain xoshiro256++.
+static void c_rng_jump_lane(Rng *self, int l, const uint64_t *jump)
+{
+    uint64_t s[4], acc[4] = {0, 0, 0, 0};
+
+    for (int w = 0; w < 4; w++)
+        s[w] = self->s[w][l];
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            uint64_t t = s[1] << 17;
+            if (jump[i] & (UINT64_C(1) << b)) {
+                for (int w = 0; w < 4; w++)
+                    acc[w] ^= s[w];
+            }
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3]  = c_rotl(s[3], 45);
+        }
+    }
+    for (int w = 0; w < 4; w++)
+        self->s[w][l] = acc[w];
+}
+
+static void c_rng_seed(Rng *self, uint64_t seed)
+{
+    // splitmix64, as recommended for filling the xoshiro state.
+    for (int w = 0; w < 4; w++) {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        self->s[w][0] = z ^ (z >> 31);
+    }
+    for (int l = 1; l < RNG_LANES; l++) {
+        for (int w = 0; w < 4; w++)
+            self->s[w][l] = self->s[w][l - 1];
+        c_rng_jump_lane(self, l, rng_jump);
+    }
+    self->next = RNG_LANES;
+}
+
+// Uniform integer on `[0, n)` without bias (Lemire's multiply-shift).
+static uint32_t c_rng_below(Rng *self, uint32_t n)
+{
+    uint64_t m = (c_rng_next(self) >> 32) * n;
+    if (cast(uint32_t, m) < n) {
+        uint32_t t = -n % n;
+        while (cast(uint32_t, m) < t)
+            m = (c_rng_next(self) >> 32) * n;
+    }
+    return cast(uint32_t, m >> 32);
+}
+
+/**
+ * @brief   `dst[i] = lo + scale * u` for uniform `u` on `[0, 1)`. Whole steps
+ *          go straight from the lanes into `dst`; only the ends go through
+ *          `buffer`.
+ */
+static void c_rng_fill_uniform(Rng *self, lua_Number *dst, int n,
+                               lua_Number lo, lua_Number scale)
+{
+    uint64_t out[RNG_LANES];
+    int      i = 0;
+
+    for (; i < n && self->next < RNG_LANES; i++)
+        dst[i] = lo + scale * rng_to_unit(c_rng_next(self));
+    for (; i + RNG_LANES <= n; i += RNG_LANES) {
+        c_rng_step(self, out);
+        for (int l = 0; l < RNG_LANES; l++)
+            dst[i + l] = lo + scale * rng_to_unit(out[l]);
+    }
+    for (; i < n; i++)
+        dst[i] = lo + scale * rng_to_unit(c_rng_next(self));
+}
+
+/**
+ * @brief   Normal deviates by the Box-Muller transform, which turns each pair
+ *          of uniforms into a pair of normals. Unlike the polar method it
+ *          never rejects, so the uniforms can be drawn in bulk into `dst`
+ *          first and transformed in place by a loop without branches.
+ */
+static void c_rng_fill_normal(Rng *self, lua_Number *dst, int n,
+                              lua_Number mu, lua_Number sigma)
+{
+    const lua_Number two_pi = 6.283185307179586476925;
+    int              even   = n - n % 2;
+
+    c_rng_fill_uniform(self, dst, even, 0, 1);
+    for (int i = 0; i < even; i += 2) {
+        // `1 - u` is on `(0, 1]`, so the logarithm is finite.
+        lua_Number r = sigma * sqrt(-2 * log(1 - dst[i]));
+        lua_Number t = two_pi * dst[i + 1];
+        dst[i]     = mu + r * cos(t);
+        dst[i + 1] = mu + r * sin(t);
+    }
+    if (even < n) {
+        lua_Number r = sigma * sqrt(-2 * log(1 - rng_to_unit(c_rng_next(self))));
+        dst[even] = mu + r * cos(two_pi * rng_to_unit(c_rng_next(self)));
+    }
+}
+
+// Fisher-Yates.
+static void c_rng_shuffle(Rng *self, lua_Number *values, int n)
+{
+    for (int i = n - 1; i > 0; i--) {
+        int        j   = cast_int(c_rng_below(self, cast(uint32_t, i + 1)));
+        lua_Number tmp = values[i];
+        values[i] = values[j];
+        values[j] = tmp;
+    }
+}
+
+/**
+ * @brief   Reservoir sampling by Li's Algorithm L: `k` of the `n` values of
+ *          `src`, without replacement, into `dst`. Rather than drawing once
+ *          per element it draws how many elements to skip, which takes
+ *          `O(k (1 + log(n / k)))` draws instead of `O(n)`.
+ */
+static void c_rng_sample(Rng *self, lua_Number *dst, const lua_Number *src, int n, int k)
+{
+    lua_Number w;
+    lua_Number i = k - 1;
+
+    if (k == 0)
+        return;
+    for (int j = 0; j < k; j++)
+        dst[j] = src[j];
+    w = exp(log(rng_to_open_unit(c_rng_next(self))) / k);
+    for (;;) {
+        i += floor(log(rng_to_open_unit(c_rng_next(self))) / log1p(-w)) + 1;
+        if (i >= n)
+            break;
+        dst[c_rng_below(self, cast(uint32_t, k))] = src[cast_int(i)];
+        w *= exp(log(rng_to_open_unit(c_rng_next(self))) / k);
+    }
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// RANDOM METHODS --------------------------------------------------------- {{{2
+
+static Rng *l_checkarg_rng(lua_State *L, int argn)
+{
+    return l_checkarg_udata(L, argn, UPVALUE_RNG_MT, RNG_MTNAME);
+}
+
+// The generator at `args[argn]`, or the module's own if none or nil.
+static Rng *l_optarg_rng(lua_State *L, int argn)
+{
+    if (lua_isnoneornil(L, argn))
+        return lua_touserdata(L, UPVALUE_RNG);
+    return l_checkarg_rng(L, argn);
+}
+
+// On 5.3+ all 64 bits of an integer seed count. Other seeds are numbers that
+// must fit an int64_t, as converting NaN, inf or anything past 2^63 is
+// undefined.
+static uint64_t l_checkarg_seed(lua_State *L, int argn)
+{
+    lua_Number x;
+#if LUA_VERSION_NUM >= 503
+    if (lua_isinteger(L, argn))
+        return cast(uint64_t, lua_tointeger(L, argn));
+#endif
+    x = luaL_checknumber(L, argn);
+    luaL_argcheck(L, -0x1p63 <= x && x < 0x1p63, argn, "seed out of range");
+    return cast(uint64_t, cast(int64_t, x));
+}
+
+/**
+ * @exception lua_newuserdata(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ */
+static Rng *l_push_rng(lua_State *L, int mt_idx)
+{
+    Rng *self = lua_newuserdata(L, sizeof(*self)); // [ ...args, self ]
+    lua_pushvalue(L, mt_idx);                       // [ ...args, self, mt ]
+    lua_setmetatable(L, -2);                        // [ ...args, self ]
+    return self;
+}
+
+/**
+ * @brief   A new generator. Without a seed it is seeded from the module's own
+ *          generator, so a program that calls `dyarray.seed()` once is
+ *          reproducible from there on.
+ *
+ * @exception <args[1]>:        type
+ *            lua_newuserdata(): memory
+ *
+ * @note    Stack usage:    [ -(0|1), +1, m|v ]
+ *          Stack before:   [ seed: integer? ]
+ *          Stack after:    [ rng: dyarray.rng ]
+ */
+static int new_rng(lua_State *L)
+{
+    uint64_t seed = lua_isnoneornil(L, 1)
+                  ? c_rng_next(lua_touserdata(L, UPVALUE_RNG))
+                  : l_checkarg_seed(L, 1);
+    c_rng_seed(l_push_rng(L, UPVALUE_RNG_MT), seed);
+    return 1;
+}
+
+/**
+ * @note    Stack usage:    [ -1, +0, v ]
+ *          Stack before:   [ self: dyarray.rng, seed: integer ]
+ *          Stack after:    [ self: dyarray.rng ]
+ */
+static int seed_rng(lua_State *L)
+{
+    Rng *self = l_checkarg_rng(L, 1);
+    c_rng_seed(self, l_checkarg_seed(L, 2));
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   Reseed the generator used when none is passed in.
+ *
+ * @note    Stack usage:    [ -1, +0, v ]
+ *          Stack before:   [ seed: integer ]
+ *          Stack after:    []
+ */
+static int seed_dyarray(lua_State *L)
+{
+    c_rng_seed(lua_touserdata(L, UPVALUE_RNG), l_checkarg_seed(L, 1));
+    return 0;
+}
+
+/**
+ * @brief   Split off an independent generator: the new one carries on from
+ *          where `self` was, and `self` jumps `2^192` steps ahead, so the two
+ *          never overlap. Give one to each array or task that needs its own
+ *          reproducible stream.
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ *          Stack before:   [ self: dyarray.rng ]
+ *          Stack after:    [ self: dyarray.rng, child: dyarray.rng ]
+ */
+static int split_rng(lua_State *L)
+{
+    Rng *self  = l_checkarg_rng(L, 1);
+    Rng *child = l_push_rng(L, UPVALUE_RNG_MT); // [ self, child ]
+
+    *child = *self;
+    for (int l = 0; l < RNG_LANES; l++)
+        c_rng_jump_lane(self, l, rng_long_jump);
+    self->next = RNG_LANES;
+    return 1;
+}
+
+/**
+ * @brief   Like `math.random()`: uniform on `[0, 1)` without arguments, on
+ *          `[1, m]` with one and on `[m, n]` with two.
+ *
+ * @note    Stack usage:    [ -0, +1, v ]
+ *          Stack before:   [ self: dyarray.rng, m: integer?, n: integer? ]
+ *          Stack after:    [ ..., x: number ]
+ */
+static int random_rng(lua_State *L)
+{
+    Rng        *self = l_checkarg_rng(L, 1);
+    lua_Integer lo, hi;
+
+    if (lua_isnoneornil(L, 2)) {
+        lua_pushnumber(L, rng_to_unit(c_rng_next(self)));
+        return 1;
+    }
+    lo = lua_isnoneornil(L, 3) ? 1 : luaL_checkinteger(L, 2);
+    hi = luaL_checkinteger(L, lua_isnoneornil(L, 3) ? 2 : 3);
+    luaL_argcheck(L, lo <= hi && cast(uint64_t, hi - lo) < UINT32_MAX, 2,
+                  "interval is empty or too large");
+    lua_pushinteger(L, lo + c_rng_below(self, cast(uint32_t, hi - lo + 1)));
+    return 1;
+}
+
+static int mt_rng_tostring(lua_State *L)
+{
+    lua_pushfstring(L, RNG_MTNAME ": %p", l_checkarg_rng(L, 1));
+    return 1;
+}
+
+/**
+ * @brief   Overwrite every element with a uniform deviate on `[lo, hi)`,
+ *          `[0, 1)` by default.
+ *
+ * @exception <args[1:4]>: type
+ *
+ * @note    Stack usage:    [ -(0|1|2|3), +0, v ]
+ *          Stack before:   [ self: dyarray, lo: number?, hi: number?, rng: dyarray.rng? ]
+ *          Stack after:    [ self: dyarray ]
+ */
+static int fill_uniform_dyarray(lua_State *L)
+{
+    DyArray   *self = l_checkarg_dyarray(L, 1);
+    lua_Number lo   = luaL_optnumber(L, 2, 0);
+    lua_Number hi   = luaL_optnumber(L, 3, 1);
+    Rng       *rng  = l_optarg_rng(L, 4);
+    c_rng_fill_uniform(rng, self->values, self->length, lo, hi - lo);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   Overwrite every element with a normal deviate of mean `mu` and
+ *          standard deviation `sigma`, 0 and 1 by default.
+ *
+ * @exception <args[1:4]>: type
+ *
+ * @note    Stack usage:    [ -(0|1|2|3), +0, v ]
+ *          Stack before:   [ self: dyarray, mu: number?, sigma: number?, rng: dyarray.rng? ]
+ *          Stack after:    [ self: dyarray ]
+ */
+static int fill_normal_dyarray(lua_State *L)
+{
+    DyArray   *self  = l_checkarg_dyarray(L, 1);
+    lua_Number mu    = luaL_optnumber(L, 2, 0);
+    lua_Number sigma = luaL_optnumber(L, 3, 1);
+    Rng       *rng   = l_optarg_rng(L, 4);
+    c_rng_fill_normal(rng, self->values, self->length, mu, sigma);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   Shuffle in place, every permutation being equally likely.
+ *
+ * @note    Stack usage:    [ -(0|1), +0, v ]
+ *          Stack before:   [ self: dyarray, rng: dyarray.rng? ]
+ *          Stack after:    [ self: dyarray ]
+ */
+static int shuffle_dyarray(lua_State *L)
+{
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    Rng     *rng  = l_optarg_rng(L, 2);
+    c_rng_shuffle(rng, self->values, self->length);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   `k` elements picked at random without replacement, as a new
+ *          dyarray. Their order is not meaningful; shuffle the result if
+ *          it matters.
+ *
+ * @exception <args[1:3]>:     type, other
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -(1|2), +1, m|v ]
+ *          Stack before:   [ self: dyarray, k: integer, rng: dyarray.rng? ]
+ *          Stack after:    [ sample: dyarray ]
+ */
+static int sample_dyarray(lua_State *L)
+{
+    DyArray *self = l_checkarg_dyarray(L, 1);
+    int      k    = luaL_checkint(L, 2);
+    Rng     *rng  = l_optarg_rng(L, 3);
+    DyArray *out;
+
+    luaL_argcheck(L, 0 <= k && k <= self->length, 2, "sample size out of range");
+    out = c_new_dyarray(L, k, next_power_of_2(k));
+    c_rng_sample(rng, out->values, self->values, self->length, k);
+    c_clear_values(out->values, k, out->capacity);
+    return 1;
+}
+
+/**
+ * @brief   A new dyarray of `n` deviates from `dist`, "uniform" on `[0, 1)`
+ *          by default or standard "normal".
+ *
+ * @exception <args[1:3]>:     type, other
+ *            c_new_dyarray(): memory
+ *
+ * @note    Stack usage:    [ -(1|2|3), +1, m|v ]
+ *          Stack before:   [ n: integer, dist: string?, rng: dyarray.rng? ]
+ *          Stack after:    [ ..., a: dyarray ]
+ */
+static int random_dyarray(lua_State *L)
+{
+    int      n    = luaL_checkint(L, 1);
+    int      dist = luaL_checkoption(L, 2, "uniform", rng_dists);
+    Rng     *rng  = l_optarg_rng(L, 3);
+    DyArray *out;
+
+    luaL_argcheck(L, n >= 0, 1, "negative length");
+    out = c_new_dyarray(L, n, next_power_of_2(n));
+    if (dist == 0)
+        c_rng_fill_uniform(rng, out->values, n, 0, 1);
+    else
+        c_rng_fill_normal(rng, out->values, n, 0, 1);
+    c_clear_values(out->values, n, out->capacity);
+    return 1;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// 1}}} ------------------------------------------------------------------------
+
+// EXPRESSIONS ------------------------------------------------------------ {{{1
+
+#define EXPR_MTNAME     LIB_MTNAME ".expr"
+
+// Elements per block. Each stack slot of `c_expr_block()` is one block, so a
+// few of them stay in L1 no matter how long the inputs are.
+#define EXPR_BLOCK      256
+
+// Longest program an expression may have. Reusing a subexpression copies its
+// program, so `e = e * e` doubles it every time.
+#define EXPR_MAX_OPS    256
+
+/**
+ * @brief   Instructions of the stack machine that evaluates an expression.
+ *          Binary operations pop two blocks and push one, or take one block
+ *          and the constant `ExprOp.k`, see `ExprSide`.
+ */
+typedef enum {
+    EXPR_LOAD, // Push the current block of `inputs[arg]`.
+    EXPR_ADD,
+    EXPR_SUB,
+    EXPR_MUL,
+    EXPR_DIV,
+    EXPR_POW,
+    EXPR_NEG,
+    EXPR_ABS,
+    EXPR_SQRT,
+    EXPR_MATH, // `c_math_values()` with `MathOp` `arg`.
+} ExprCode;
+
+#define expr_is_binary(code)    ((code) >= EXPR_ADD && (code) <= EXPR_POW)
+
+// Where a binary operation finds its operands.
+typedef enum {
+    EXPR_K_NONE,  // `x op y`, both from the stack.
+    EXPR_K_RIGHT, // `x op k`
+    EXPR_K_LEFT,  // `k op x`
+} ExprSide;
+
+typedef struct {
+    ExprCode   code;
+    int        arg;   // Input index, `ExprSide` or `MathOp`, by `code`.
+    lua_Number k;
+} ExprOp;
+
+/**
+ * @brief   Lazily evaluated elementwise expression over dyarrays, as a postfix
+ *          program. Nothing is computed until `eval()` or a reduction, which
+ *          then run the whole program one block at a time: each input is read
+ *          once and no temporary arrays are made.
+ *
+ * @note    Inputs are read when evaluating, not when building, so changes to
+ *          them in between show. They must all have the same length by then.
+ */
+typedef struct {
+    ExprOp   *ops;
+    DyArray **inputs;  // Distinct, in order of first use.
+    int       nops;
+    int       ninputs;
+    int       depth;   // Stack slots needed to evaluate.
+    int       ref;     // Registry reference to the operands, see `l_push_expr()`.
+} Expr;
+
+// One side of a new expression: a constant if `nops == 0`.
+typedef struct {
+    const ExprOp   *ops;
+    DyArray *const *inputs;
+    int             nops;
+    int             ninputs;
+    int             depth;
+    int             argn;
+    lua_Number      k;
+    ExprOp          load;  // Program of a bare dyarray.
+    DyArray        *input;
+} ExprOperand;
+
+static const char *const expr_math_names[] = {
+    "exp", "log", "sin", "cos", "tanh", "sigmoid", "floor", "ceil", "round",
+};
+
+// Symbols for `ExprCode` up to `EXPR_SQRT`, used by `__tostring`.
+static const char *const expr_code_names[] = {
+    "x", "+", "-", "*", "/", "^", "-", "abs", "sqrt",
+};
+
+// EXPRESSION KERNELS ----------------------------------------------------- {{{2
+
+#define expr_add(x, y)  ((x) + (y))
+#define expr_sub(x, y)  ((x) - (y))
+#define expr_mul(x, y)  ((x) * (y))
+#define expr_div(x, y)  ((x) / (y))
+
+#define EXPR_BINARY(fn)                                                        \
+    do {                                                                       \
+        if (op->arg == EXPR_K_RIGHT) {                                         \
+            for (int i = 0; i < n; i++)                                        \
+                dst[i] = fn(x[i], op->k);                                      \
+        } else if (op->arg == EXPR_K_LEFT) {                                   \
+            for (int i = 0; i < n; i++)                                        \
+                dst[i] = fn(op->k, x[i]);                                      \
+        } else {                                                               \
+            for (int i = 0; i < n; i++)                                        \
+                dst[i] = fn(x[i], y[i]);                                       \
+        }                                                                      \
+    } while (0)
+
+// One block per stack slot, then the stack itself, see `c_expr_block()`.
+#define size_of_scratch(self)                                                  \
+    (cast(size_t, (self)->depth) * (sizeof(lua_Number) * EXPR_BLOCK + sizeof(lua_Number *)))
+
+/**
+ * @brief   Run the program of `self` over the `n <= EXPR_BLOCK` elements from
+ *          index `start` of every input.
+ *
+ * @param   scratch `size_of_scratch(self)` bytes. Stack slot `i` points to
+ *                  block `i` of it, or right into an input for slots that only
+ *                  load one, so inputs are never copied.
+ *
+ * @return  The result, either in `scratch` or in one of the inputs.
+ */
+static const lua_Number *c_expr_block(const Expr *self, lua_Number *scratch,
+                                      int start, int n)
+{
+    const lua_Number **stack = cast(const lua_Number **, scratch + self->depth * EXPR_BLOCK);
+    int                top   = 0;
+
+    for (int p = 0; p < self->nops; p++) {
+        const ExprOp     *op = &self->ops[p];
+        const lua_Number *x, *y = NULL;
+        lua_Number       *dst;
+
+        if (op->code == EXPR_LOAD) {
+            stack[top++] = self->inputs[op->arg]->values + start;
+            continue;
+        }
+        if (expr_is_binary(op->code) && op->arg == EXPR_K_NONE)
+            y = stack[--top];
+        x   = stack[top - 1];
+        dst = scratch + (top - 1) * EXPR_BLOCK;
+
+        switch (op->code) {
+        case EXPR_ADD:  EXPR_BINARY(expr_add); break;
+        case EXPR_SUB:  EXPR_BINARY(expr_sub); break;
+        case EXPR_MUL:  EXPR_BINARY(expr_mul); break;
+        case EXPR_DIV:  EXPR_BINARY(expr_div); break;
+        case EXPR_POW:
+            if (op->arg == EXPR_K_RIGHT)
+                c_pow_values(dst, x, n, op->k);
+            else
+                EXPR_BINARY(pow);
+            break;
+        case EXPR_NEG:
+            for (int i = 0; i < n; i++)
+                dst[i] = -x[i];
+            break;
+        case EXPR_ABS:
+            for (int i = 0; i < n; i++)
+                dst[i] = fabs(x[i]);
+            break;
+        case EXPR_SQRT:
+            for (int i = 0; i < n; i++)
+                dst[i] = sqrt(x[i]);
+            break;
+        case EXPR_MATH:
+            c_math_values(dst, x, n, cast(MathOp, op->arg));
+            break;
+        case EXPR_LOAD:
+            break;
+        }
+        stack[top - 1] = dst;
+    }
+    return stack[0];
+}
+
+#undef EXPR_BINARY
+
+// 2}}} ------------------------------------------------------------------------
+
+// EXPRESSION METHODS ----------------------------------------------------- {{{2
+
+static Expr *l_checkarg_expr(lua_State *L, int argn)
+{
+    return l_checkarg_udata(L, argn, UPVALUE_EXPR_MT, EXPR_MTNAME);
+}
+
+/**
+ * @brief   Describe `args[argn]`, a number, dyarray or expression, as one side
+ *          of a new expression.
+ *
+ * @exception <args[argn]>: type
+ */
+static void l_expr_operand(lua_State *L, int argn, ExprOperand *o)
+{
+    o->argn = argn;
+    if (lua_type(L, argn) == LUA_TNUMBER) {
+        o->nops    = 0;
+        o->ninputs = 0;
+        o->depth   = 0;
+        o->k       = lua_tonumber(L, argn);
+        return;
+    }
+    if (lua_touserdata(L, argn) != NULL && lua_getmetatable(L, argn)) { // [ ...args, mt ]
+        int is_expr  = lua_rawequal(L, -1, UPVALUE_EXPR_MT);
+        int is_array = lua_rawequal(L, -1, UPVALUE_MT);
+        lua_pop(L, 1);                                                  // [ ...args ]
+        if (is_expr) {
+            Expr *e = lua_touserdata(L, argn);
+            o->ops     = e->ops;
+            o->inputs  = e->inputs;
+            o->nops    = e->nops;
+            o->ninputs = e->ninputs;
+            o->depth   = e->depth;
+            return;
+        }
+        if (is_array) {
+            o->load.code = EXPR_LOAD;
+            o->load.arg  = 0;
+            o->load.k    = 0;
+            o->input     = lua_touserdata(L, argn);
+            o->ops       = &o->load;
+            o->inputs    = &o->input;
+            o->nops      = 1;
+            o->ninputs   = 1;
+            o->depth     = 1;
+            return;
+        }
+    }
+    luaL_typerror(L, argn, "number, dyarray or " EXPR_MTNAME);
+}
+
+/**
+ * @brief   Push the expression that runs the program of `a`, then that of `b`
+ *          if not NULL, then `last` if not NULL. The inputs of `b` are merged
+ *          into those of `a`, and the new expression keeps both operands
+ *          alive through a registry reference to a table holding them.
+ *
+ * @exception lua_newuserdata(), new_pointer(), luaL_ref(): memory
+ *            <for-body>: expression too long
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ */
+static Expr *l_push_expr(lua_State *L, const ExprOperand *a, const ExprOperand *b,
+                         const ExprOp *last)
+{
+    DyArray *inputs[EXPR_MAX_OPS];
+    int      remap[EXPR_MAX_OPS];
+    int      nops    = a->nops + ((b != NULL) ? b->nops : 0) + ((last != NULL) ? 1 : 0);
+    int      ninputs = a->ninputs;
+    int      depth   = a->depth;
+    int      n       = 0;
+    Expr    *self;
+
+    if (nops > EXPR_MAX_OPS)
+        LIB_ERROR(L, "expression too long (%d operations), eval() part of it first", nops);
+
+    // Each input has at least one load, so there are no more than `nops`.
+    for (int i = 0; i < a->ninputs; i++)
+        inputs[i] = a->inputs[i];
+    if (b != NULL) {
+        for (int j = 0; j < b->ninputs; j++) {
+            int i = 0;
+            while (i < ninputs && inputs[i] != b->inputs[j])
+                i++;
+            if (i == ninputs)
+                inputs[ninputs++] = b->inputs[j];
+            remap[j] = i;
+        }
+        // `a` leaves its result on the stack while `b` runs.
+        if (1 + b->depth > depth)
+            depth = 1 + b->depth;
+    }
+
+    self = lua_newuserdata(L, sizeof(*self));     // [ ...args, self ]
+    self->ops     = NULL;
+    self->inputs  = NULL;
+    self->nops    = 0;
+    self->ninputs = 0;
+    self->depth   = depth;
+    self->ref     = LUA_NOREF; // So `__gc` is safe if anything below throws.
+    lua_pushvalue(L, UPVALUE_EXPR_MT);            // [ ...args, self, mt ]
+    lua_setmetatable(L, -2);                      // [ ...args, self ]
+
+    self->ops     = new_pointer(L, size_of_array(self->ops, nops));
+    self->nops    = nops;
+    self->inputs  = new_pointer(L, size_of_array(self->inputs, ninputs));
+    self->ninputs = ninputs;
+    memcpy(self->inputs, inputs, size_of_array(inputs, ninputs));
+
+    for (int p = 0; p < a->nops; p++)
+        self->ops[n++] = a->ops[p];
+    for (int p = 0; b != NULL && p < b->nops; p++) {
+        self->ops[n] = b->ops[p];
+        if (b->ops[p].code == EXPR_LOAD)
+            self->ops[n].arg = remap[b->ops[p].arg];
+        n++;
+    }
+    if (last != NULL)
+        self->ops[n] = *last;
+
+    lua_createtable(L, 2, 0);                     // [ ...args, self, operands ]
+    lua_pushvalue(L, a->argn);                    // [ ..., operands, a ]
+    lua_rawseti(L, -2, 1);                        // [ ..., operands ] ; operands[1] = a
+    if (b != NULL) {
+        lua_pushvalue(L, b->argn);                // [ ..., operands, b ]
+        lua_rawseti(L, -2, 2);                    // [ ..., operands ] ; operands[2] = b
+    }
+    self->ref = luaL_ref(L, LUA_REGISTRYINDEX);   // [ ...args, self ]
+    return self;
+}
+
+/**
+ * @exception <args[1:2]>: type
+ *            l_push_expr(): memory, expression too long
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ *          Stack before:   [ x: number|dyarray|expr, y: number|dyarray|expr ]
+ *          Stack after:    [ x, y, expr ]
+ */
+static int c_expr_binary(lua_State *L, ExprCode code)
+{
+    ExprOperand x, y;
+    ExprOp      op;
+
+    l_expr_operand(L, 1, &x);
+    l_expr_operand(L, 2, &y);
+    op.code = code;
+    op.k    = 0;
+    if (x.nops == 0) {
+        luaL_argcheck(L, y.nops > 0, 2, EXPR_MTNAME " or dyarray expected");
+        op.arg = EXPR_K_LEFT;
+        op.k   = x.k;
+        l_push_expr(L, &y, NULL, &op);
+    } else if (y.nops == 0) {
+        op.arg = EXPR_K_RIGHT;
+        op.k   = y.k;
+        l_push_expr(L, &x, NULL, &op);
+    } else {
+        op.arg = EXPR_K_NONE;
+        l_push_expr(L, &x, &y, &op);
+    }
+    return 1;
+}
+
+/**
+ * @exception <args[1]>: type
+ *            l_push_expr(): memory, expression too long
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ *          Stack before:   [ self: expr ]
+ *          Stack after:    [ self, expr ]
+ */
+static int c_expr_unary(lua_State *L, ExprCode code, int arg)
+{
+    ExprOperand x;
+    ExprOp      op;
+
+    l_checkarg_expr(L, 1);
+    l_expr_operand(L, 1, &x);
+    op.code = code;
+    op.arg  = arg;
+    op.k    = 0;
+    l_push_expr(L, &x, NULL, &op);
+    return 1;
+}
+
+/**
+ * @brief   Start an expression over `self`: `dyarray.expr(a)` or `a:lazy()`.
+ *          Build on it with the arithmetic operators, with numbers, dyarrays
+ *          and other expressions, and with methods like `sqrt()`.
+ *
+ * @exception <args[1]>: type
+ *            l_push_expr(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ *          Stack before:   [ self: dyarray ]
+ *          Stack after:    [ self, expr ]
+ */
+static int expr_dyarray(lua_State *L)
+{
+    ExprOperand x;
+    l_checkarg_dyarray(L, 1);
+    l_expr_operand(L, 1, &x);
+    l_push_expr(L, &x, NULL, NULL);
+    return 1;
+}
+
+static int mt_expr_add(lua_State *L)
+{
+    return c_expr_binary(L, EXPR_ADD);
+}
+
+static int mt_expr_sub(lua_State *L)
+{
+    return c_expr_binary(L, EXPR_SUB);
+}
+
+static int mt_expr_mul(lua_State *L)
+{
+    return c_expr_binary(L, EXPR_MUL);
+}
+
+static int mt_expr_div(lua_State *L)
+{
+    return c_expr_binary(L, EXPR_DIV);
+}
+
+// Also the `pow()` method.
+static int mt_expr_pow(lua_State *L)
+{
+    return c_expr_binary(L, EXPR_POW);
+}
+
+static int mt_expr_unm(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_NEG, 0);
+}
+
+static int abs_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_ABS, 0);
+}
+
+static int sqrt_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_SQRT, 0);
+}
+
+static int exp_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_MATH, MATH_EXP);
+}
+
+static int log_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_MATH, MATH_LOG);
+}
+
+static int sin_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_MATH, MATH_SIN);
+}
+
+static int cos_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_MATH, MATH_COS);
+}
+
+static int tanh_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_MATH, MATH_TANH);
+}
+
+static int sigmoid_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_MATH, MATH_SIGMOID);
+}
+
+static int floor_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_MATH, MATH_FLOOR);
+}
+
+static int ceil_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_MATH, MATH_CEIL);
+}
+
+static int round_expr(lua_State *L)
+{
+    return c_expr_unary(L, EXPR_MATH, MATH_ROUND);
+}
+
+/**
+ * @brief   The length every input has now.
+ *
+ * @exception <for-body>: length mismatch
+ */
+static int l_expr_length(lua_State *L, const Expr *self)
+{
+    int len = self->inputs[0]->length;
+    for (int i = 1; i < self->ninputs; i++) {
+        if (self->inputs[i]->length != len)
+            LIB_ERROR(L, "expression inputs differ in length (%d and %d)",
+                      len, self->inputs[i]->length);
+    }
+    return len;
+}
+
+/**
+ * @brief   Evaluate into `out`, a new dyarray if not given. `out` may be one
+ *          of the inputs: each block is read in full before it is written.
+ *
+ * @exception <args[1:2]>:       type
+ *            l_expr_length():   length mismatch
+ *            l_optarg_output(), new_pointer(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ *          Stack before:   [ self: expr, out: dyarray? ]
+ *          Stack after:    [ self, out, out ]
+ */
+static int eval_expr(lua_State *L)
+{
+    Expr       *self    = l_checkarg_expr(L, 1);
+    int         len     = l_expr_length(L, self);
+    lua_Number *dst     = l_optarg_output(L, 2, len)->values;
+    lua_Number *scratch = new_pointer(L, size_of_scratch(self));
+
+    DBG_PRINTFLN("eval %d operations over indexes 0 to %d", self->nops, len);
+    for (int start = 0; start < len; start += EXPR_BLOCK) {
+        int n = (len - start < EXPR_BLOCK) ? len - start : EXPR_BLOCK;
+        memmove(dst + start, c_expr_block(self, scratch, start, n),
+                size_of_array(dst, n));
+    }
+    free_pointer(L, scratch, size_of_scratch(self));
+    return 1;
+}
+
+// Reduce each block on its own first, which for sums also keeps the error
+// down compared to one running total.
+#define REDUCE_BLOCK(fn, identity)                                             \
+    do {                                                                       \
+        lua_Number part = (identity);                                          \
+        for (int i = 0; i < n; i++)                                            \
+            part = fn(part, r[i]);                                             \
+        acc = fn(acc, part);                                                   \
+    } while (0)
+
+/**
+ * @brief   Fold the values of `self` with `op` without storing them.
+ *
+ * @exception l_expr_length(): length mismatch
+ *            new_pointer():   memory
+ *
+ * @note    An empty expression reduces to the identity of `op`, e.g. 0 for
+ *          "sum" and `-inf` for "max".
+ */
+static lua_Number l_expr_reduce(lua_State *L, const Expr *self, ScanOp op, int *len)
+{
+    lua_Number  acc;
+    lua_Number *scratch;
+
+    *len    = l_expr_length(L, self);
+    scratch = new_pointer(L, size_of_scratch(self));
+    acc     = (op == SCAN_SUM) ? 0 : (op == SCAN_PROD) ? 1
+            : (op == SCAN_MAX) ? -HUGE_VAL : HUGE_VAL;
+
+    DBG_PRINTFLN("reduce %d operations over indexes 0 to %d", self->nops, *len);
+    for (int start = 0; start < *len; start += EXPR_BLOCK) {
+        int               n = (*len - start < EXPR_BLOCK) ? *len - start : EXPR_BLOCK;
+        const lua_Number *r = c_expr_block(self, scratch, start, n);
+        switch (op) {
+        case SCAN_SUM:  REDUCE_BLOCK(scan_sum, 0);          break;
+        case SCAN_PROD: REDUCE_BLOCK(scan_prod, 1);         break;
+        case SCAN_MAX:  REDUCE_BLOCK(scan_max, -HUGE_VAL);  break;
+        case SCAN_MIN:  REDUCE_BLOCK(scan_min, HUGE_VAL);   break;
+        }
+    }
+    free_pointer(L, scratch, size_of_scratch(self));
+    return acc;
+}
+
+#undef REDUCE_BLOCK
+
+/**
+ * @exception <args[1:2]>:    type, option
+ *            l_expr_reduce(): length mismatch, memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ *          Stack before:   [ self: expr, op: string ]
+ *          Stack after:    [ self, op, result: number ]
+ *
+ * @note    `op` is one of "sum", "prod", "max" or "min", as for `scan()`.
+ */
+static int reduce_expr(lua_State *L)
+{
+    Expr  *self = l_checkarg_expr(L, 1);
+    ScanOp op   = cast(ScanOp, luaL_checkoption(L, 2, NULL, scan_ops));
+    int    len;
+    lua_pushnumber(L, l_expr_reduce(L, self, op, &len));
+    return 1;
+}
+
+static int sum_expr(lua_State *L)
+{
+    int len;
+    lua_pushnumber(L, l_expr_reduce(L, l_checkarg_expr(L, 1), SCAN_SUM, &len));
+    return 1;
+}
+
+static int max_expr(lua_State *L)
+{
+    int len;
+    lua_pushnumber(L, l_expr_reduce(L, l_checkarg_expr(L, 1), SCAN_MAX, &len));
+    return 1;
+}
+
+static int min_expr(lua_State *L)
+{
+    int len;
+    lua_pushnumber(L, l_expr_reduce(L, l_checkarg_expr(L, 1), SCAN_MIN, &len));
+    return 1;
+}
+
+// NaN if empty, like `dyarray.mean()`.
+static int mean_expr(lua_State *L)
+{
+    int        len;
+    lua_Number sum = l_expr_reduce(L, l_checkarg_expr(L, 1), SCAN_SUM, &len);
+    lua_pushnumber(L, (len > 0) ? sum / len : NAN);
+    return 1;
+}
+
+static int length_expr(lua_State *L)
+{
+    lua_pushinteger(L, l_expr_length(L, l_checkarg_expr(L, 1)));
+    return 1;
+}
+
+/**
+ * @brief   The program written out in infix, inputs numbered `x1`, `x2`, ...
+ *          in order of first use.
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ *          Stack before:   [ self: expr ]
+ *          Stack after:    [ self, s: string ]
+ */
+static int mt_expr_tostring(lua_State *L)
+{
+    Expr *self = l_checkarg_expr(L, 1);
+
+    luaL_checkstack(L, self->depth + 2, "expression too deep to print");
+    for (int p = 0; p < self->nops; p++) {
+        const ExprOp *op  = &self->ops[p];
+        const char   *sym = (op->code == EXPR_MATH) ? expr_math_names[op->arg]
+                                                    : expr_code_names[op->code];
+        switch (op->code) {
+        case EXPR_LOAD:
+            lua_pushfstring(L, "x%d", op->arg + 1);             // [ ..., x ]
+            break;
+        case EXPR_ADD:
+        case EXPR_SUB:
+        case EXPR_MUL:
+        case EXPR_DIV:
+        case EXPR_POW:
+            if (op->arg == EXPR_K_NONE) {
+                lua_pushfstring(L, "(%s %s %s)", lua_tostring(L, -2), sym,
+                                lua_tostring(L, -1));           // [ ..., x, y, s ]
+                lua_replace(L, -3);                             // [ ..., s, y ]
+                lua_pop(L, 1);                                  // [ ..., s ]
+                break;
+            }
+            if (op->arg == EXPR_K_RIGHT)
+                lua_pushfstring(L, "(%s %s %f)", lua_tostring(L, -1), sym, op->k);
+            else
+                lua_pushfstring(L, "(%f %s %s)", op->k, sym, lua_tostring(L, -1));
+            lua_replace(L, -2);                                 // [ ..., s ]
+            break;
+        case EXPR_NEG:
+            lua_pushfstring(L, "-%s", lua_tostring(L, -1));     // [ ..., x, s ]
+            lua_replace(L, -2);                                 // [ ..., s ]
+            break;
+        default:
+            lua_pushfstring(L, "%s(%s)", sym, lua_tostring(L, -1));
+            lua_replace(L, -2);
+            break;
+        }
+    }
+    lua_pushfstring(L, EXPR_MTNAME ": %s", lua_tostring(L, -1));
+    return 1;
+}
+
+static int mt_expr_gc(lua_State *L)
+{
+    Expr *self = l_checkarg_expr(L, 1);
+    DBG_PRINTFLN("free expression of %d operations", self->nops);
+    free_pointer(L, self->ops, size_of_array(self->ops, self->nops));
+    free_pointer(L, self->inputs, size_of_array(self->inputs, self->ninputs));
+    luaL_unref(L, LUA_REGISTRYINDEX, self->ref);
+    self->ops     = NULL;
+    self->inputs  = NULL;
+    self->nops    = 0;
+    self->ninputs = 0;
+    self->ref     = LUA_NOREF;
+    return 0;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+// 1}}} ------------------------------------------------------------------------
+
+// C API ------------------------------------------------------------------ {{{1
+
+// See `src/dyarray.h`. These wrap the internal helpers so that other modules
+// share our allocator and growth policy. They run as part of other modules'
+// functions, which don't have our upvalues, so the metatable comes from the
+// registry here.
+
+static DyArray *api_check(lua_State *L, int argn)
+{
+    return dyarray_check(L, argn);
+}
+
+static DyArray *api_push_new(lua_State *L, int len)
+{
+    int      cap  = next_power_of_2(len);
+    DyArray *self;
+
+    luaL_getmetatable(L, LIB_MTNAME);                     // [ mt ]
+    self = c_new_dyarray_mt(L, len, cap, lua_gettop(L)); // [ mt, self ]
+    lua_remove(L, -2);                                    // [ self ]
+    c_clear_values(self->values, 0, cap);
+    return self;
+}
+
+static lua_Number *api_data(DyArray *self)
+{
+    return self->values;
+}
+
+static void api_reserve(lua_State *L, DyArray *self, int n)
+{
+    c_reserve_values(L, self, n);
+}
+
+static int api_length(DyArray *self)
+{
+    return self->length;
+}
+
+static const DyArray_API lib_api = {
+    DYARRAY_API_VERSION,
+    &api_check,
+    &api_push_new,
+    &api_data,
+    &api_reserve,
+    &api_length,
+};
+
+// 1}}} ------------------------------------------------------------------------
+
 static const luaL_Reg lib_fns[] = {
     {"new",         &new_dyarray},
     {"get",         &get_dyarray},
@@ -592,6 +4331,73 @@ static const luaL_Reg lib_fns[] = {
     {"resize",      &resize_dyarray},
     {"copy",        &copy_dyarray},
     {"length",      &length_dyarray},
+    {"ptr",         &ptr_dyarray},
+    {"unsafe",      &unsafe_dyarray},
+
+    // Scans and differences
+    {"scan",        &scan_dyarray},
+    {"cumsum",      &cumsum_dyarray},
+    {"cumprod",     &cumprod_dyarray},
+    {"cummax",      &cummax_dyarray},
+    {"diff",        &diff_dyarray},
+
+    // Masks
+    {"lt",          &lt_dyarray},
+    {"le",          &le_dyarray},
+    {"gt",          &gt_dyarray},
+    {"ge",          &ge_dyarray},
+    {"eq",          &eq_dyarray},
+    {"between",     &between_dyarray},
+    {"compress",    &compress_dyarray},
+    {"where",       &where_dyarray},
+
+    // Gather and select
+    {"gather",      &gather_dyarray},
+    {"scatter",     &scatter_dyarray},
+    {"select",      &select_dyarray},
+    {"unique",      &unique_dyarray},
+
+    // Linear algebra
+    {"gemm",        &gemm_dyarray},
+    {"gemv",        &gemv_dyarray},
+
+    // Elementwise math
+    {"exp",         &exp_dyarray},
+    {"log",         &log_dyarray},
+    {"sin",         &sin_dyarray},
+    {"cos",         &cos_dyarray},
+    {"tanh",        &tanh_dyarray},
+    {"sigmoid",     &sigmoid_dyarray},
+    {"pow",         &pow_dyarray},
+    {"floor",       &floor_dyarray},
+    {"ceil",        &ceil_dyarray},
+    {"round",       &round_dyarray},
+
+    // Heap
+    {"heap",        &new_heap},
+    {"topk",        &topk_dyarray},
+
+    // Statistics
+    {"mean",        &mean_dyarray},
+    {"variance",    &variance_dyarray},
+    {"std",         &std_dyarray},
+    {"quantile",    &quantile_dyarray},
+    {"quantiles",   &quantiles_dyarray},
+    {"median",      &median_dyarray},
+    {"histogram",   &histogram_dyarray},
+
+    // Lazy expressions
+    {"expr",        &expr_dyarray},
+    {"lazy",        &expr_dyarray},
+
+    // Random
+    {"rng",         &new_rng},
+    {"seed",        &seed_dyarray},
+    {"random",      &random_dyarray},
+    {"fill_uniform", &fill_uniform_dyarray},
+    {"fill_normal", &fill_normal_dyarray},
+    {"shuffle",     &shuffle_dyarray},
+    {"sample",      &sample_dyarray},
     {NULL,          NULL},
 };
 
@@ -604,6 +4410,95 @@ static const luaL_Reg mt_fns[] = {
     {NULL,         NULL},
 };
 
+static const luaL_Reg heap_fns[] = {
+    {"push",        &push_heap},
+    {"pop",         &pop_heap},
+    {"peek",        &peek_heap},
+    {"replace_top", &replace_top_heap},
+    {"heapify",     &heapify_heap},
+    {"length",      &length_heap},
+    {"__len",       &length_heap},
+    {"__tostring",  &mt_heap_tostring},
+    {"__gc",        &mt_heap_gc},
+    {NULL,          NULL},
+};
+
+static const luaL_Reg rng_fns[] = {
+    {"seed",        &seed_rng},
+    {"split",       &split_rng},
+    {"random",      &random_rng},
+    {"__tostring",  &mt_rng_tostring},
+    {NULL,          NULL},
+};
+
+static const luaL_Reg expr_fns[] = {
+    {"eval",        &eval_expr},
+    {"reduce",      &reduce_expr},
+    {"sum",         &sum_expr},
+    {"mean",        &mean_expr},
+    {"max",         &max_expr},
+    {"min",         &min_expr},
+    {"length",      &length_expr},
+    {"pow",         &mt_expr_pow},
+    {"abs",         &abs_expr},
+    {"sqrt",        &sqrt_expr},
+    {"exp",         &exp_expr},
+    {"log",         &log_expr},
+    {"sin",         &sin_expr},
+    {"cos",         &cos_expr},
+    {"tanh",        &tanh_expr},
+    {"sigmoid",     &sigmoid_expr},
+    {"floor",       &floor_expr},
+    {"ceil",        &ceil_expr},
+    {"round",       &round_expr},
+    {"__add",       &mt_expr_add},
+    {"__sub",       &mt_expr_sub},
+    {"__mul",       &mt_expr_mul},
+    {"__div",       &mt_expr_div},
+    {"__pow",       &mt_expr_pow},
+    {"__unm",       &mt_expr_unm},
+    {"__len",       &length_expr},
+    {"__tostring",  &mt_expr_tostring},
+    {"__gc",        &mt_expr_gc},
+    {NULL,          NULL},
+};
+
+static const luaL_Reg no_fns[] = {
+    {NULL,          NULL},
+};
+
+#define SHARED_UPVALUES     5
+
+/**
+ * @brief   Register `l` into the table on top of the stack, with the values at
+ *          stack indexes 1 to `SHARED_UPVALUES` as upvalues: the dyarray, heap
+ *          and rng metatables, the default generator and the expression
+ *          metatable.
+ *
+ * @note    Stack usage:    [ -0, +0, m ]
+ */
+static void l_register_shared(lua_State *L, const luaL_Reg *l)
+{
+    for (int i = 1; i <= SHARED_UPVALUES; i++)
+        lua_pushvalue(L, i);               // [ ..., t, mt, heap_mt, rng_mt, rng, expr_mt ]
+    luaL_setfuncs(L, l, SHARED_UPVALUES);  // [ ..., t ]
+}
+
+/**
+ * @brief   Fill the metatable at stack index `mt_idx` with `l`, and make it its
+ *          own `__index` so that `l` also provides the methods.
+ *
+ * @note    Stack usage:    [ -0, +0, m ]
+ */
+static void l_register_class(lua_State *L, int mt_idx, const luaL_Reg *l)
+{
+    lua_pushvalue(L, mt_idx);            // [ ..., t ]
+    lua_pushvalue(L, mt_idx);            // [ ..., t, t ]
+    lua_setfield(L, -2, "__index");      // [ ..., t ] ; t.__index = t
+    l_register_shared(L, l);
+    lua_pop(L, 1);                       // [ ... ]
+}
+
 LIB_EXPORT int luaopen_dyarray(lua_State *L)
 {
     // Intern error message so we don't need to allocate it later on.
@@ -612,12 +4507,31 @@ LIB_EXPORT int luaopen_dyarray(lua_State *L)
     lua_pushcfunction(L, &dump_table); // [ dump_table ]
     lua_setglobal(L, "dump_table");    // [] ; _G.dump_table == dump_table
 
+    // Publish the C API for other modules, see `src/dyarray.h`.
+    lua_pushlightuserdata(L, cast(void *, &lib_api)); // [ api ]
+    lua_setfield(L, LUA_REGISTRYINDEX, DYARRAY_API_KEY); // []
+
+    // Every function gets the metatables and the default generator as
+    // upvalues, see `UPVALUE_MT`. `l_register_shared()` finds them at stack
+    // indexes 1 to 5, so drop the arguments `require()` gave us first.
     // See:
     // https://www.lua.org/manual/5.1/manual.html#luaL_newmetatable
     // https://www.lua.org/manual/5.1/manual.html#luaL_register
+    // https://www.lua.org/manual/5.2/manual.html#luaL_setfuncs
+    lua_settop(L, 0);                    // []
     luaL_newmetatable(L, LIB_MTNAME);    // [ mt ]
-    luaL_register(L, NULL, mt_fns);      // [ mt ], reg(mt, mt_fns)
-    luaL_register(L, LIB_NAME, lib_fns); // [ mt, dyarray ], reg(_G.dyarray, lib_fns)
+    luaL_newmetatable(L, HEAP_MTNAME);   // [ mt, heap_mt ]
+    luaL_newmetatable(L, RNG_MTNAME);    // [ mt, heap_mt, rng_mt ]
+    c_rng_seed(l_push_rng(L, 3), RNG_DEFAULT_SEED); // [ mt, heap_mt, rng_mt, rng ]
+    luaL_newmetatable(L, EXPR_MTNAME);   // [ mt, heap_mt, rng_mt, rng, expr_mt ]
+    l_register_class(L, 2, heap_fns);
+    l_register_class(L, 3, rng_fns);
+    l_register_class(L, 5, expr_fns);
+    lua_pushvalue(L, 1);                 // [ ..., expr_mt, mt ]
+    l_register_shared(L, mt_fns);        // [ ..., expr_mt, mt ], reg(mt, mt_fns)
+    lua_pop(L, 1);                       // [ mt, heap_mt, rng_mt, rng, expr_mt ]
 
+    luaL_register(L, LIB_NAME, no_fns);  // [ ..., expr_mt, dyarray ] ; _G.dyarray = dyarray
+    l_register_shared(L, lib_fns);       // [ ..., expr_mt, dyarray ], reg(dyarray, lib_fns)
     return 1;
 }
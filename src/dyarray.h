@@ -0,0 +1,133 @@
+/**
+ * @brief   Public C API of the `dyarray` module, for other C modules that want
+ *          to take and return dyarrays without going through Lua method calls.
+ *
+ * @note    Include this after `common.h`.
+ *
+ * @note    The `DyArray` layout is public so that callers can read and write
+ *          `values[0:length]` directly. Anything that allocates, however,
+ *          must go through the function table that `luaopen_dyarray()` stores
+ *          in the registry under `DYARRAY_API_KEY`. That way separately
+ *          compiled modules never need to link against `dyarray` and always
+ *          agree with it on the growth policy and the allocator.
+ *
+ *          DyArray    *a = dyarray_check(L, 1);
+ *          DyArray    *b = dyarray_push_new(L, dyarray_length(a));
+ *          lua_Number *x = dyarray_data(a);
+ *          lua_Number *y = dyarray_data(b);
+ *          for (int i = 0; i < dyarray_length(a); i++)
+ *              y[i] = 2 * x[i];
+ */
+#ifndef DYARRAY_H
+#define DYARRAY_H
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#define DYARRAY_MTNAME          "C_Modules" "dyarray"
+#define DYARRAY_API_KEY         DYARRAY_MTNAME ".api"
+#define DYARRAY_API_VERSION     1
+
+typedef struct {
+    int         length;   // #Active, also 1 past last written C index.
+    int         capacity; // #Allocated, also 1 past last valid C index.
+    lua_Number *values;   // Heap-allocated 1D array.
+} DyArray;
+
+#define size_of_values(self, n) size_of_array((self)->values, n)
+#define size_of_active(self)    size_of_values(self, (self)->length)
+#define size_of_total(self)     size_of_values(self, (self)->capacity)
+
+/**
+ * @brief   Function table published by the `dyarray` module. Only ever append
+ *          new members, and bump `DYARRAY_API_VERSION` when doing so.
+ */
+typedef struct {
+    int         version;
+
+    // Throws if `args[argn]` is not a dyarray.
+    DyArray    *(*check)(lua_State *L, int argn);
+
+    // [ 0, +1, m ] Push a new dyarray of `len` zeroes.
+    DyArray    *(*push_new)(lua_State *L, int len);
+
+    // Valid until the next call that may grow `self`.
+    lua_Number *(*data)(DyArray *self);
+
+    // Grow `self` to hold at least `n` elements; the length is unchanged and
+    // new slots are zeroed. May move `self->values`.
+    void        (*reserve)(lua_State *L, DyArray *self, int n);
+
+    int         (*length)(DyArray *self);
+} DyArray_API;
+
+/**
+ * @brief   Fetch the function table from the registry, loading the `dyarray`
+ *          module first if need be.
+ *
+ * @note    This is a registry lookup, so hot loops should fetch the table
+ *          once per call rather than once per element. Don't keep it across
+ *          calls either: the table lives in the `dyarray` shared library,
+ *          which is unloaded when its `lua_State` is closed.
+ *
+ * @exception require(): any
+ *            version mismatch: other
+ */
+static inline const DyArray_API *dyarray_api(lua_State *L)
+{
+    const DyArray_API *api;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, DYARRAY_API_KEY); // [ api? ]
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);                                   // []
+        lua_getglobal(L, "require");                     // [ require ]
+        lua_pushliteral(L, "dyarray");                   // [ require, "dyarray" ]
+        lua_call(L, 1, 0);                               // []
+        lua_getfield(L, LUA_REGISTRYINDEX, DYARRAY_API_KEY);
+    }
+    api = lua_touserdata(L, -1);
+    lua_pop(L, 1); // []
+    if (api == NULL || api->version != DYARRAY_API_VERSION)
+        luaL_error(L, "dyarray: C API version %d required", DYARRAY_API_VERSION);
+    return api;
+}
+
+/**
+ * @brief   Like `luaL_checkudata()`, this throws if `args[argn]` is not a
+ *          dyarray. The `dyarray` module must have been loaded already so that
+ *          its metatable is in the registry.
+ */
+static inline DyArray *dyarray_check(lua_State *L, int argn)
+{
+    return luaL_checkudata(L, argn, DYARRAY_MTNAME);
+}
+
+static inline lua_Number *dyarray_data(DyArray *self)
+{
+    return self->values;
+}
+
+static inline int dyarray_length(DyArray *self)
+{
+    return self->length;
+}
+
+/**
+ * @exception memory
+ *
+ * @note    Stack usage:    [ 0, +1, m ]
+ */
+static inline DyArray *dyarray_push_new(lua_State *L, int len)
+{
+    return dyarray_api(L)->push_new(L, len);
+}
+
+/**
+ * @exception memory
+ */
+static inline void dyarray_reserve(lua_State *L, DyArray *self, int n)
+{
+    dyarray_api(L)->reserve(L, self, n);
+}
+
+#endif // DYARRAY_H
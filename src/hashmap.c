@@ -0,0 +1,623 @@
+/**
+ * @name    Flat Numeric Hash Map
+ *
+ * @brief   An open-addressing map from numbers to numbers, laid out like a
+ *          Swiss table: a flat array of key-value slots plus one control
+ *          byte per slot. Lookups probe a whole group of control bytes at a
+ *          time and only touch the slots whose 7-bit hash fragment matches.
+ *
+ * @note    Each slot is 16 bytes plus 1 control byte, so at the maximum load
+ *          factor of 7/8 an entry costs a little over 19 bytes.
+ *
+ * @note    Control bytes are probed 8 at a time using plain 64-bit integer
+ *          arithmetic ("SIMD within a register") so that the same code works
+ *          under both MSVC and GCC-like compilers. This assumes a
+ *          little-endian target.
+ *
+ * @see     https://abseil.io/about/design/swisstables
+ */
+#define LIB_NAME "hashmap"
+#include "common.h"
+#include "dyarray.h"
+#include <math.h>
+#include <string.h>
+
+#define GROUP_WIDTH     8
+#define CTRL_EMPTY      cast(uint8_t, 0x80)
+#define CTRL_DELETED    cast(uint8_t, 0xFE)
+#define GROUP_LSBS      UINT64_C(0x0101010101010101)
+#define GROUP_MSBS      UINT64_C(0x8080808080808080)
+
+typedef struct {
+    lua_Number key;
+    lua_Number value;
+} Slot;
+
+typedef struct {
+    int      length;     // #Live entries.
+    int      tombstones; // #Deleted slots, which still lengthen probes.
+    int      capacity;   // #Slots, always a power of 2 no less than 8.
+    Slot    *slots;      // `capacity` key-value pairs, then the control bytes.
+    uint8_t *ctrl;       // `capacity + GROUP_WIDTH` bytes, tail mirrors head.
+} HashMap;
+
+// Slots and control bytes share one allocation so a failed resize never leaks.
+#define size_of_table(cap)  (sizeof(Slot) * (cap) + (cap) + GROUP_WIDTH)
+#define table_ctrl(slots, cap) cast(uint8_t *, (slots) + (cap))
+#define max_load(cap)       ((cap) - (cap) / 8)
+
+// Largest capacity: a power of 2 that fits in an `int` and whose table size,
+// see `size_of_table()`, still fits in a `size_t` on 32-bit targets.
+#define MAX_CAPACITY        ((sizeof(size_t) > 4) ? (1 << 30) : (1 << 26))
+#define MAX_COUNT           max_load(MAX_CAPACITY)
+#define is_full(c)          (((c) & 0x80) == 0)
+
+// HELPERS ----------------------------------------------------------------- {{{
+
+static HashMap *l_checkarg_hashmap(lua_State *L, int argn)
+{
+    return luaL_checkudata(L, argn, LIB_MTNAME);
+}
+
+// Lua tables reject NaN keys as well, since NaN never compares equal to itself.
+static lua_Number l_checkarg_key(lua_State *L, int argn)
+{
+    lua_Number k = luaL_checknumber(L, argn);
+    luaL_argcheck(L, k == k, argn, "key is NaN");
+    return k;
+}
+
+static int bad_field(lua_State *L, const char *field)
+{
+    return LIB_ERROR(L, "Unknown field " LUA_QS, field);
+}
+
+/**
+ * @brief   Hash the bit pattern of `k`, after folding -0 into +0 so that keys
+ *          which compare equal also hash equal.
+ *
+ * @see     https://xorshift.di.unimi.it/splitmix64.c
+ */
+static uint64_t c_hash_key(lua_Number k)
+{
+    uint64_t h;
+    if (k == 0)
+        k = 0;
+    memcpy(&h, &k, sizeof(h));
+    h ^= h >> 30;
+    h *= UINT64_C(0xBF58476D1CE4E5B9);
+    h ^= h >> 27;
+    h *= UINT64_C(0x94D049BB133111EB);
+    h ^= h >> 31;
+    return h;
+}
+
+#define hash_h1(h)  cast(size_t, (h) >> 7)
+#define hash_h2(h)  cast(uint8_t, (h) & 0x7F)
+
+// GROUPS ----------------------------------------------------------------- {{{2
+
+static uint64_t c_group_load(const uint8_t *ctrl)
+{
+    uint64_t g;
+    memcpy(&g, ctrl, sizeof(g));
+    return g;
+}
+
+// High bit set in each byte equal to `h2`. May report rare false positives,
+// which are harmless since the caller compares keys anyway.
+static uint64_t c_group_match(uint64_t g, uint8_t h2)
+{
+    uint64_t x = g ^ (GROUP_LSBS * h2);
+    return (x - GROUP_LSBS) & ~x & GROUP_MSBS;
+}
+
+// High bit set in each byte equal to `CTRL_EMPTY`.
+static uint64_t c_group_match_empty(uint64_t g)
+{
+    return (g & (~g << 6)) & GROUP_MSBS;
+}
+
+// High bit set in each byte equal to `CTRL_EMPTY` or `CTRL_DELETED`.
+static uint64_t c_group_match_free(uint64_t g)
+{
+    return g & GROUP_MSBS;
+}
+
+// Byte offset of the lowest reported match. Assumes `mask != 0`.
+#define group_first(mask)   (ctz_u64(mask) / 8)
+#define group_next(mask)    ((mask) & ((mask) - 1))
+
+// 2}}} ------------------------------------------------------------------------
+
+// Also writes the mirrored byte so group loads near the end wrap around.
+static void c_set_ctrl(HashMap *self, size_t i, uint8_t c)
+{
+    self->ctrl[i] = c;
+    if (i < GROUP_WIDTH)
+        self->ctrl[self->capacity + i] = c;
+}
+
+// Index of the slot holding `key`, or -1 if not present.
+static int c_find_slot(HashMap *self, lua_Number key, uint64_t hash)
+{
+    size_t  mask = cast(size_t, self->capacity - 1);
+    size_t  pos  = hash_h1(hash) & mask;
+    uint8_t h2   = hash_h2(hash);
+
+    // Triangular probing over groups visits every group exactly once when the
+    // capacity is a power of 2.
+    for (size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+        uint64_t g = c_group_load(&self->ctrl[pos]);
+        for (uint64_t m = c_group_match(g, h2); m != 0; m = group_next(m)) {
+            size_t i = (pos + group_first(m)) & mask;
+            if (self->slots[i].key == key)
+                return cast_int(i);
+        }
+        if (c_group_match_empty(g) != 0)
+            return -1;
+        pos = (pos + step) & mask;
+    }
+}
+
+// Index of the first empty or deleted slot along the probe sequence of `hash`.
+// Assumes there is at least one such slot.
+static size_t c_find_free(const uint8_t *ctrl, int capacity, uint64_t hash)
+{
+    size_t mask = cast(size_t, capacity - 1);
+    size_t pos  = hash_h1(hash) & mask;
+    for (size_t step = GROUP_WIDTH;; step += GROUP_WIDTH) {
+        uint64_t m = c_group_match_free(c_group_load(&ctrl[pos]));
+        if (m != 0)
+            return (pos + group_first(m)) & mask;
+        pos = (pos + step) & mask;
+    }
+}
+
+// Smallest power-of-2 capacity that holds `n <= MAX_COUNT` entries under the
+// load factor.
+static int c_capacity_for(int n)
+{
+    int cap = GROUP_WIDTH;
+    while (max_load(cap) < n)
+        cap *= 2;
+    return cap;
+}
+
+/**
+ * @brief   Move every live entry into freshly allocated arrays of `ncap` slots.
+ *          This also drops all tombstones.
+ *
+ * @exception new_pointer(): memory
+ */
+static void c_rehash(lua_State *L, HashMap *self, int ncap)
+{
+    Slot    *nslots = new_pointer(L, size_of_table(ncap));
+    uint8_t *nctrl  = table_ctrl(nslots, ncap);
+    int      ocap   = self->capacity;
+
+    DBG_PRINTFLN("rehash from %d to %d slots", ocap, ncap);
+    memset(nctrl, CTRL_EMPTY, ncap + GROUP_WIDTH);
+    for (int i = 0; i < ocap; i++) {
+        if (is_full(self->ctrl[i])) {
+            Slot    *slot = &self->slots[i];
+            uint64_t hash = c_hash_key(slot->key);
+            size_t   j    = c_find_free(nctrl, ncap, hash);
+            nctrl[j] = hash_h2(hash);
+            if (j < GROUP_WIDTH)
+                nctrl[ncap + j] = hash_h2(hash);
+            nslots[j] = *slot;
+        }
+    }
+    free_pointer(L, self->slots, size_of_table(ocap));
+    self->ctrl       = nctrl;
+    self->slots      = nslots;
+    self->capacity   = ncap;
+    self->tombstones = 0;
+}
+
+// Make room for `n` live entries without further rehashing.
+static void c_reserve(lua_State *L, HashMap *self, int n)
+{
+    int ncap = c_capacity_for(n);
+    if (ncap > self->capacity)
+        c_rehash(L, self, ncap);
+}
+
+/**
+ * @exception c_rehash(): memory
+ */
+static void c_insert(lua_State *L, HashMap *self, lua_Number key, lua_Number value)
+{
+    uint64_t hash = c_hash_key(key);
+    int      i    = c_find_slot(self, key, hash);
+    size_t   j;
+
+    if (i >= 0) {
+        self->slots[i].value = value;
+        return;
+    }
+
+    // Tombstones count towards the load since they never end a probe.
+    if (self->length + self->tombstones + 1 > max_load(self->capacity)) {
+        int ncap;
+        if (self->length >= MAX_COUNT)
+            LIB_ERROR(L, "too many entries, at most %d fit", MAX_COUNT);
+        ncap = c_capacity_for(self->length + 1);
+        c_rehash(L, self, (ncap > self->capacity) ? self->capacity * 2 : self->capacity);
+    }
+    j = c_find_free(self->ctrl, self->capacity, hash);
+    if (self->ctrl[j] == CTRL_DELETED)
+        self->tombstones -= 1;
+    c_set_ctrl(self, j, hash_h2(hash));
+    self->slots[j].key   = key;
+    self->slots[j].value = value;
+    self->length += 1;
+}
+
+static void c_erase(HashMap *self, int i)
+{
+    c_set_ctrl(self, cast(size_t, i), CTRL_DELETED);
+    self->length     -= 1;
+    self->tombstones += 1;
+}
+
+// }}} -------------------------------------------------------------------------
+
+// METHODS ---------------------------------------------------------------- {{{1
+
+/**
+ * @brief   `args[argn]` as a number of entries. Read as a number so that
+ *          out-of-range values are caught before they are converted to `int`.
+ *
+ * @exception <args[argn]>: type, count out of range
+ */
+static int l_checkarg_count(lua_State *L, int argn)
+{
+    lua_Number n = luaL_checknumber(L, argn);
+    if (!(n >= 0 && n <= MAX_COUNT)) // Also NaN.
+        luaL_argerror(L, argn, lua_pushfstring(L, "count must be in [0, %d]", MAX_COUNT));
+    return cast_int(n);
+}
+
+/**
+ * @exception <args[1]>:     type, count out of range
+ *            new_pointer(): memory
+ *
+ * @note    Stack usage:    [ -(0|1), +1, m|v ]
+ *          Stack before:   [ n: integer? ]
+ *          Stack after:    [ self: hashmap ]
+ */
+static int new_hashmap(lua_State *L)
+{
+    int      n    = lua_isnoneornil(L, 1) ? 0 : l_checkarg_count(L, 1);
+    int      cap  = c_capacity_for(n);
+    HashMap *self = lua_newuserdata(L, sizeof(*self)); // [ n, self ]
+
+    DBG_PRINTFLN("new " LIB_QNAME " of capacity %d", cap);
+    // Set these first so `__gc` is safe even if an allocation below throws.
+    self->length     = 0;
+    self->tombstones = 0;
+    self->capacity   = 0;
+    self->ctrl       = NULL;
+    self->slots      = NULL;
+    luaL_getmetatable(L, LIB_MTNAME); // [ n, self, mt ]
+    lua_setmetatable(L, -2);          // [ n, self ]
+
+    self->slots    = new_pointer(L, size_of_table(cap));
+    self->ctrl     = table_ctrl(self->slots, cap);
+    self->capacity = cap;
+    memset(self->ctrl, CTRL_EMPTY, cap + GROUP_WIDTH);
+    return 1;
+}
+
+/**
+ * @exception <args[:]>: type
+ *
+ * @note    Stack usage:    [ -2, +1, v ]
+ *          Stack before:   [ self: hashmap, key: number ]
+ *          Stack after:    [ self[key]: number? ]
+ */
+static int get_hashmap(lua_State *L)
+{
+    HashMap   *self = l_checkarg_hashmap(L, 1);
+    lua_Number key  = l_checkarg_key(L, 2);
+    int        i    = c_find_slot(self, key, c_hash_key(key));
+    if (i >= 0)
+        lua_pushnumber(L, self->slots[i].value);
+    else
+        lua_pushnil(L);
+    return 1;
+}
+
+/**
+ * @exception <args[:]>: type
+ *
+ * @note    Stack usage:    [ -2, +1, v ]
+ *          Stack before:   [ self: hashmap, key: number ]
+ *          Stack after:    [ has: boolean ]
+ */
+static int has_hashmap(lua_State *L)
+{
+    HashMap   *self = l_checkarg_hashmap(L, 1);
+    lua_Number key  = l_checkarg_key(L, 2);
+    lua_pushboolean(L, c_find_slot(self, key, c_hash_key(key)) >= 0);
+    return 1;
+}
+
+/**
+ * @exception <args[:]>: type
+ *
+ * @note    Stack usage:    [ -2, +1, v ]
+ *          Stack before:   [ self: hashmap, key: number ]
+ *          Stack after:    [ old: number? ]
+ */
+static int remove_hashmap(lua_State *L)
+{
+    HashMap   *self = l_checkarg_hashmap(L, 1);
+    lua_Number key  = l_checkarg_key(L, 2);
+    int        i    = c_find_slot(self, key, c_hash_key(key));
+    if (i < 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushnumber(L, self->slots[i].value);
+    c_erase(self, i);
+    return 1;
+}
+
+/**
+ * @exception <args[:]>:  type
+ *            c_insert(): memory
+ *
+ * @note    Stack usage:    [ -3, +1, m|v ]
+ *          Stack before:   [ self: hashmap, key: number, value: number? ]
+ *          Stack after:    [ self ]
+ *          Side effects:   self[key] = value
+ *
+ * @note    Like Lua tables, assigning nil removes the key.
+ */
+static int set_hashmap(lua_State *L)
+{
+    HashMap   *self = l_checkarg_hashmap(L, 1);
+    lua_Number key  = l_checkarg_key(L, 2);
+    if (lua_isnoneornil(L, 3)) {
+        int i = c_find_slot(self, key, c_hash_key(key));
+        if (i >= 0)
+            c_erase(self, i);
+    } else {
+        c_insert(L, self, key, luaL_checknumber(L, 3));
+    }
+    lua_settop(L, 1); // [ self ]
+    return 1;
+}
+
+/**
+ * @brief   Insert `keys[i] => values[i]` for every index in one call, reserving
+ *          space for all of them up front.
+ *
+ * @exception <args[:]>:   type
+ *            <args[2]>:   too many entries
+ *            <args[3]>:   length mismatch
+ *            c_reserve(): memory
+ *
+ * @note    Stack usage:    [ -3, +1, m|v ]
+ *          Stack before:   [ self: hashmap, keys: dyarray, values: dyarray ]
+ *          Stack after:    [ self ]
+ */
+static int insert_many_hashmap(lua_State *L)
+{
+    HashMap *self = l_checkarg_hashmap(L, 1);
+    DyArray *keys = dyarray_check(L, 2);
+    DyArray *vals = dyarray_check(L, 3);
+    int      len  = keys->length;
+
+    luaL_argcheck(L, vals->length == len, 3, "length mismatch with keys");
+    luaL_argcheck(L, len <= MAX_COUNT - self->length, 2, "too many entries");
+    for (int i = 0; i < len; i++) {
+        if (keys->values[i] != keys->values[i])
+            return LIB_ERROR(L, "NaN key at index %d", i + 1);
+    }
+    c_reserve(L, self, self->length + len);
+    for (int i = 0; i < len; i++)
+        c_insert(L, self, keys->values[i], vals->values[i]);
+    lua_settop(L, 1); // [ self ]
+    return 1;
+}
+
+/**
+ * @brief   Look up every key of `keys` in one call. Missing keys yield
+ *          `default`, which is NaN if not given.
+ *
+ * @exception <args[:]>:          type
+ *            dyarray_push_new(): memory
+ *
+ * @note    Stack usage:    [ -(2|3), +1, m|v ]
+ *          Stack before:   [ self: hashmap, keys: dyarray, default: number? ]
+ *          Stack after:    [ values: dyarray ]
+ */
+static int get_many_hashmap(lua_State *L)
+{
+    HashMap    *self = l_checkarg_hashmap(L, 1);
+    DyArray    *keys = dyarray_check(L, 2);
+    lua_Number  def  = luaL_optnumber(L, 3, NAN);
+    int         len  = dyarray_length(keys);
+    lua_Number *src  = dyarray_data(keys);
+    lua_Number *dst  = dyarray_data(dyarray_push_new(L, len));
+
+    for (int i = 0; i < len; i++) {
+        int j = (src[i] == src[i]) ? c_find_slot(self, src[i], c_hash_key(src[i])) : -1;
+        dst[i] = (j >= 0) ? self->slots[j].value : def;
+    }
+    return 1;
+}
+
+/**
+ * @exception <args[:]>:   type
+ *            <args[2]>:   count out of range
+ *            c_reserve(): memory
+ *
+ * @note    Stack usage:    [ -2, +1, m|v ]
+ *          Stack before:   [ self: hashmap, n: integer ]
+ *          Stack after:    [ self ]
+ */
+static int reserve_hashmap(lua_State *L)
+{
+    HashMap *self = l_checkarg_hashmap(L, 1);
+    int      n    = l_checkarg_count(L, 2);
+    c_reserve(L, self, n);
+    lua_settop(L, 1); // [ self ]
+    return 1;
+}
+
+/**
+ * @brief   Remove all entries but keep the allocated slots.
+ *
+ * @note    Stack usage:    [ -1, +1, v ]
+ *          Stack before:   [ self: hashmap ]
+ *          Stack after:    [ self ]
+ */
+static int clear_hashmap(lua_State *L)
+{
+    HashMap *self = l_checkarg_hashmap(L, 1);
+    memset(self->ctrl, CTRL_EMPTY, self->capacity + GROUP_WIDTH);
+    self->length     = 0;
+    self->tombstones = 0;
+    lua_settop(L, 1); // [ self ]
+    return 1;
+}
+
+static int length_hashmap(lua_State *L)
+{
+    lua_pushinteger(L, l_checkarg_hashmap(L, 1)->length);
+    return 1;
+}
+
+/**
+ * @note    Stack before:   []
+ *          Stack after:    [ key: number?, value: number? ]
+ *          Upvalues:       [ self: hashmap, i: integer ]
+ */
+static int next_hashmap(lua_State *L)
+{
+    HashMap *self = lua_touserdata(L, lua_upvalueindex(1));
+    int      i    = cast_int(lua_tointeger(L, lua_upvalueindex(2)));
+
+    for (; i < self->capacity; i++) {
+        if (is_full(self->ctrl[i])) {
+            lua_pushinteger(L, i + 1);
+            lua_replace(L, lua_upvalueindex(2));
+            lua_pushnumber(L, self->slots[i].key);
+            lua_pushnumber(L, self->slots[i].value);
+            return 2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief   `for k, v in self:pairs() do ... end`. Entries come out in slot
+ *          order, which is unspecified. Do not insert while iterating.
+ *
+ * @note    Stack usage:    [ -1, +1, m|v ]
+ *          Stack before:   [ self: hashmap ]
+ *          Stack after:    [ iterator: function ]
+ */
+static int pairs_hashmap(lua_State *L)
+{
+    l_checkarg_hashmap(L, 1);
+    lua_settop(L, 1);                        // [ self ]
+    lua_pushinteger(L, 0);                   // [ self, 0 ]
+    lua_pushcclosure(L, &next_hashmap, 2);   // [ next ]
+    return 1;
+}
+
+/**
+ * @note    Stack usage:    [ -2, +1, v ]
+ *          Stack before:   [ self: hashmap, key: string ]
+ *          Stack after:    [ hashmap[key]: function ]
+ */
+static int get_field(lua_State *L)
+{
+    const char *s = luaL_checkstring(L, 2);
+    lua_getglobal(L, LIB_NAME); // [ self, key, hashmap ]
+    lua_getfield(L, -1, s);     // [ self, key, hashmap, hashmap[key] ]
+    return lua_isnil(L, -1) ? bad_field(L, s) : 1;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// METATABLES ------------------------------------------------------------- {{{1
+
+static int mt_tostring(lua_State *L)
+{
+    HashMap *self = l_checkarg_hashmap(L, 1);
+    lua_pushfstring(L, LIB_MESSAGE("length = %d, capacity = %d",
+                                   self->length, self->capacity));
+    return 1;
+}
+
+/**
+ * @brief   Number keys index the map, string keys look up methods.
+ *
+ * @note    Stack usage:  [ -2, +1, v ]
+ *          Stack before: [ self: hashmap, key: number|string ]
+ *          Stack after:  [ self[key]: number?|function ]
+ */
+static int mt_index(lua_State *L)
+{
+    switch (lua_type(L, 2)) {
+    case LUA_TNUMBER: return get_hashmap(L);
+    case LUA_TSTRING: return get_field(L);
+    default:          break;
+    }
+    return bad_field(L, luaL_typename(L, 2));
+}
+
+static int mt_gc(lua_State *L)
+{
+    HashMap *self = l_checkarg_hashmap(L, 1);
+    DBG_PRINTFLN("free map of length %d", self->length);
+
+    // osize > 0 && nsize == 0 invokes the equivalent of free(ptr).
+    if (self->slots != NULL)
+        free_pointer(L, self->slots, size_of_table(self->capacity));
+    return 0;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+static const luaL_Reg lib_fns[] = {
+    {"new",         &new_hashmap},
+    {"get",         &get_hashmap},
+    {"set",         &set_hashmap},
+    {"has",         &has_hashmap},
+    {"remove",      &remove_hashmap},
+
+    // Bulk operations
+    {"insert_many", &insert_many_hashmap},
+    {"get_many",    &get_many_hashmap},
+    {"reserve",     &reserve_hashmap},
+    {"clear",       &clear_hashmap},
+
+    {"length",      &length_hashmap},
+    {"pairs",       &pairs_hashmap},
+    {NULL,          NULL},
+};
+
+static const luaL_Reg mt_fns[] = {
+    {"__index",    &mt_index},
+    {"__newindex", &set_hashmap},
+    {"__tostring", &mt_tostring},
+    {"__len",      &length_hashmap},
+    {"__gc",       &mt_gc},
+    {NULL,         NULL},
+};
+
+LIB_EXPORT int luaopen_hashmap(lua_State *L)
+{
+    luaL_newmetatable(L, LIB_MTNAME);    // [ mt ]
+    luaL_register(L, NULL, mt_fns);      // [ mt ], reg(mt, mt_fns)
+    luaL_register(L, LIB_NAME, lib_fns); // [ mt, hashmap ], reg(_G.hashmap, lib_fns)
+    return 1;
+}
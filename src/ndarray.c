@@ -0,0 +1,992 @@
+/**
+ * @name    Strided N-D Arrays
+ *
+ * @brief   An N-dimensional view over a `dyarray` buffer: a shape, a stride
+ *          per dimension and an offset, all in elements. Views share their
+ *          buffer, so `reshape()`, `transpose()`, `row()` and `col()` copy
+ *          nothing; only `copy()` and the arithmetic methods allocate.
+ *
+ *          local A = ndarray.new({2, 3}, dyarray.new{1, 2, 3, 4, 5, 6})
+ *          print(A[{2, 1}])          --> 4
+ *          print(A:transpose()[1])   --> ndarray(2) {1, 4}
+ *          A:row(2):mul(10, A:row(2))
+ *          print(A)                  --> ndarray(2x3) {{1, 2, 3}, {40, 50, 60}}
+ *
+ * @note    Indexes are 1-based like everywhere else, and negative ones count
+ *          from the end of their dimension. `a[i]` on an N-D array is the
+ *          (N-1)-D view `a:row(i)`, so `a[i][j]` also works, but `a[{i, j}]`
+ *          and `a:get(i, j)` do so without creating the intermediate view.
+ *
+ * @note    The buffer is an ordinary `dyarray` which may still be resized
+ *          through other references. Every access therefore checks that it
+ *          is still long enough for the view and reads its `values` anew.
+ */
+#define LIB_NAME "ndarray"
+#include "common.h"
+#include "dyarray.h"
+#include <limits.h>
+
+#define NDARRAY_MAX_DIMS    8
+
+// Every function in `lib_fns` and `mt_fns` has our metatable as upvalue 1.
+#define UPVALUE_MT          lua_upvalueindex(1)
+
+typedef struct {
+    DyArray *base;                      // Shared storage, kept alive by `ref`.
+    int      ref;                       // Registry reference to `base`.
+    int      ndim;                      // In `[1, NDARRAY_MAX_DIMS]`.
+    int      offset;                    // C index of the first element.
+    int      size;                      // Product of `shape`.
+    int      span;                      // 1 past the last C index reachable.
+    int      contiguous;                // Row-major with no gaps?
+    int      shape[NDARRAY_MAX_DIMS];
+    int      strides[NDARRAY_MAX_DIMS]; // Nonnegative, in elements.
+} NdArray;
+
+typedef enum {
+    ND_ADD,
+    ND_SUB,
+    ND_MUL,
+    ND_DIV,
+    ND_COPY, // dst = x
+    ND_FILL, // dst = y
+} NdOp;
+
+// HELPERS ----------------------------------------------------------------- {{{
+
+static NdArray *l_checkarg_ndarray(lua_State *L, int argn)
+{
+    return l_checkarg_udata(L, argn, UPVALUE_MT, LIB_MTNAME);
+}
+
+static int l_isndarray(lua_State *L, int i)
+{
+    int ok = 0;
+    if (lua_type(L, i) == LUA_TUSERDATA && lua_getmetatable(L, i)) {
+        ok = lua_rawequal(L, -1, UPVALUE_MT);
+        lua_pop(L, 1);
+    }
+    return ok;
+}
+
+/**
+ * @brief   Recompute the derived fields after `shape`, `strides`, `offset`
+ *          or `ndim` changed.
+ */
+static void c_nd_update(NdArray *self)
+{
+    int size   = 1;
+    int last   = self->offset;
+    int expect = 1;
+
+    self->contiguous = 1;
+    for (int k = self->ndim - 1; k >= 0; k--) {
+        if (self->shape[k] != 1 && self->strides[k] != expect)
+            self->contiguous = 0;
+        expect *= self->shape[k];
+        size   *= self->shape[k];
+        if (self->shape[k] > 0)
+            last += (self->shape[k] - 1) * self->strides[k];
+    }
+    self->size = size;
+    self->span = (size == 0) ? 0 : last + 1;
+}
+
+// Row-major strides for the current shape.
+static void c_nd_default_strides(NdArray *self)
+{
+    int stride = 1;
+    for (int k = self->ndim - 1; k >= 0; k--) {
+        self->strides[k] = stride;
+        stride *= self->shape[k];
+    }
+}
+
+/**
+ * @brief   `self.base.values + self.offset`, after checking that the buffer
+ *          still covers the view.
+ *
+ * @exception <args[argn]>: other
+ */
+static lua_Number *l_nd_data(lua_State *L, NdArray *self, int argn)
+{
+    if (self->span > self->base->length)
+        luaL_argerror(L, argn, "buffer was shrunk below the size of the view");
+    return self->base->values + self->offset;
+}
+
+/**
+ * @brief   Read a shape given as an integer (1-D) or as a table of integers.
+ *          `-1` is allowed in at most one place if `allow_infer` is set, and
+ *          is returned as is.
+ *
+ * @exception <args[argn]>: type, other
+ *
+ * @return  The number of dimensions.
+ */
+static int l_checkarg_shape(lua_State *L, int argn, int *shape, int allow_infer)
+{
+    int ndim;
+    int ninfer = 0;
+
+    if (lua_type(L, argn) == LUA_TNUMBER) {
+        shape[0] = luaL_checkint(L, argn);
+        ndim     = 1;
+    } else {
+        luaL_checktype(L, argn, LUA_TTABLE);
+        ndim = cast_int(lua_objlen(L, argn));
+        luaL_argcheck(L, ndim >= 1, argn, "need at least 1 dimension");
+        luaL_argcheck(L, ndim <= NDARRAY_MAX_DIMS, argn, "too many dimensions");
+        for (int k = 0; k < ndim; k++) {
+            lua_rawgeti(L, argn, k + 1); // [ ...args, shape[k + 1] ]
+            if (!lua_isnumber(L, -1))
+                luaL_argerror(L, argn, "dimensions must be integers");
+            shape[k] = cast_int(lua_tointeger(L, -1));
+            lua_pop(L, 1);               // [ ...args ]
+        }
+    }
+    for (int k = 0; k < ndim; k++) {
+        if (shape[k] == -1 && allow_infer)
+            ninfer++;
+        else if (shape[k] < 0)
+            luaL_argerror(L, argn, "negative dimension");
+    }
+    luaL_argcheck(L, ninfer <= 1, argn, "only one dimension can be -1");
+    return ndim;
+}
+
+// Number of elements of `shape[0:ndim]`, or -1 if that does not fit an `int`.
+static int c_shape_size(const int *shape, int ndim)
+{
+    int size = 1;
+    for (int k = 0; k < ndim; k++) {
+        if (shape[k] != 0 && size > INT_MAX / shape[k])
+            return -1;
+        size *= shape[k];
+    }
+    return size;
+}
+
+/**
+ * @brief   Resolve a 1-based, possibly negative index along dimension `k`.
+ *
+ * @exception <args[argn]>: index
+ */
+static int l_nd_index(lua_State *L, NdArray *self, int k, lua_Integer i, int argn)
+{
+    lua_Integer n = self->shape[k];
+    lua_Integer c = (i < 0) ? n + i : i - 1;
+    luaL_argcheck(L, 0 <= c && c < n, argn, "index out of range");
+    return cast_int(c);
+}
+
+/**
+ * @brief   Offset of the element whose `ndim` indexes are `args[argn:]`.
+ *
+ * @exception <args[argn:]>: type, index
+ */
+static int l_nd_offset_args(lua_State *L, NdArray *self, int argn)
+{
+    int off = 0;
+    for (int k = 0; k < self->ndim; k++)
+        off += self->strides[k] * l_nd_index(L, self, k, luaL_checkinteger(L, argn + k), argn + k);
+    return off;
+}
+
+/**
+ * @brief   Offset of the element whose `ndim` indexes are in the table at
+ *          `args[argn]`, as in `a[{i, j}]`.
+ *
+ * @exception <args[argn]>: index, other
+ */
+static int l_nd_offset_table(lua_State *L, NdArray *self, int argn)
+{
+    int off = 0;
+    luaL_argcheck(L, cast_int(lua_objlen(L, argn)) == self->ndim, argn,
+                  "wrong number of indexes");
+    for (int k = 0; k < self->ndim; k++) {
+        lua_Integer i;
+        lua_rawgeti(L, argn, k + 1); // [ ...args, t[k + 1] ]
+        if (!lua_isnumber(L, -1))
+            luaL_argerror(L, argn, "indexes must be integers");
+        i = lua_tointeger(L, -1);
+        lua_pop(L, 1);               // [ ...args ]
+        off += self->strides[k] * l_nd_index(L, self, k, i, argn);
+    }
+    return off;
+}
+
+/**
+ * @brief   Push a new ndarray sharing the buffer of `src`, with the same
+ *          shape and strides. The caller adjusts those and then calls
+ *          `c_nd_update()`.
+ *
+ * @exception lua_newuserdata(), luaL_ref(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ */
+static NdArray *l_push_view(lua_State *L, const NdArray *src)
+{
+    NdArray *self = lua_newuserdata(L, sizeof(*self)); // [ ...args, view ]
+
+    *self     = *src;
+    self->ref = LUA_NOREF; // So `__gc` is safe if `luaL_ref()` throws.
+    lua_pushvalue(L, UPVALUE_MT);                       // [ ...args, view, mt ]
+    lua_setmetatable(L, -2);                            // [ ...args, view ]
+    lua_rawgeti(L, LUA_REGISTRYINDEX, src->ref);        // [ ...args, view, base ]
+    self->ref = luaL_ref(L, LUA_REGISTRYINDEX);         // [ ...args, view ]
+    return self;
+}
+
+/**
+ * @brief   Push a row-major ndarray of the given shape over the dyarray at
+ *          `base_idx`, or over a new zeroed one if `base_idx` is 0.
+ *
+ * @exception lua_newuserdata(), luaL_ref(), dyarray_push_new(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ */
+static NdArray *l_push_new(lua_State *L, const int *shape, int ndim, int base_idx)
+{
+    int      size = c_shape_size(shape, ndim);
+    DyArray *base;
+    NdArray *self;
+
+    if (size < 0)
+        luaL_error(L, LIB_MEMERR);
+    if (base_idx == 0) {
+        base = dyarray_push_new(L, size);            // [ ...args, base ]
+    } else {
+        base = dyarray_check(L, base_idx);
+        lua_pushvalue(L, base_idx);                  // [ ...args, base ]
+    }
+    self = lua_newuserdata(L, sizeof(*self));        // [ ...args, base, self ]
+    self->base   = base;
+    self->ref    = LUA_NOREF;
+    self->ndim   = ndim;
+    self->offset = 0;
+    for (int k = 0; k < ndim; k++)
+        self->shape[k] = shape[k];
+    c_nd_default_strides(self);
+    c_nd_update(self);
+    lua_pushvalue(L, UPVALUE_MT);                    // [ ...args, base, self, mt ]
+    lua_setmetatable(L, -2);                         // [ ...args, base, self ]
+    lua_insert(L, -2);                               // [ ...args, self, base ]
+    self->ref = luaL_ref(L, LUA_REGISTRYINDEX);      // [ ...args, self ]
+    return self;
+}
+
+// Push a new contiguous ndarray with the same shape as `src`.
+static NdArray *l_push_like(lua_State *L, const NdArray *src)
+{
+    return l_push_new(L, src->shape, src->ndim, 0);
+}
+
+static int c_same_shape(const NdArray *a, const NdArray *b)
+{
+    if (a->ndim != b->ndim)
+        return 0;
+    for (int k = 0; k < a->ndim; k++) {
+        if (a->shape[k] != b->shape[k])
+            return 0;
+    }
+    return 1;
+}
+
+// }}} -------------------------------------------------------------------------
+
+// ELEMENTWISE ------------------------------------------------------------ {{{1
+
+/**
+ * @brief   `dst[i*ds] = x[i*xs] <op> y[i*ys]` for `i` in `[0, n)`. A stride
+ *          of 0 for `y` broadcasts a scalar. Unit strides get loops of their
+ *          own so that the compiler can vectorize them.
+ */
+static void c_nd_kernel(NdOp op, lua_Number *dst, int ds,
+                        const lua_Number *x, int xs,
+                        const lua_Number *y, int ys, int n)
+{
+#define ND_LOOP(expr)                                                          \
+    if (ds == 1 && xs == 1 && ys == 1) {                                       \
+        for (int i = 0; i < n; i++) {                                          \
+            lua_Number a = x[i], b = y[i];                                     \
+            (void)a, (void)b;                                                  \
+            dst[i] = (expr);                                                   \
+        }                                                                      \
+    } else if (ds == 1 && xs == 1 && ys == 0) {                                \
+        lua_Number b = *y;                                                     \
+        (void)b;                                                               \
+        for (int i = 0; i < n; i++) {                                          \
+            lua_Number a = x[i];                                               \
+            (void)a;                                                           \
+            dst[i] = (expr);                                                   \
+        }                                                                      \
+    } else {                                                                   \
+        for (int i = 0; i < n; i++) {                                          \
+            lua_Number a = x[i * xs], b = y[i * ys];                           \
+            (void)a, (void)b;                                                  \
+            dst[i * ds] = (expr);                                              \
+        }                                                                      \
+    }
+
+    switch (op) {
+    case ND_ADD:  ND_LOOP(a + b); break;
+    case ND_SUB:  ND_LOOP(a - b); break;
+    case ND_MUL:  ND_LOOP(a * b); break;
+    case ND_DIV:  ND_LOOP(a / b); break;
+    case ND_COPY: ND_LOOP(a);     break;
+    case ND_FILL: ND_LOOP(b);     break;
+    }
+#undef ND_LOOP
+}
+
+/**
+ * @brief   Apply `op` over arrays of the same shape, one innermost row at a
+ *          time. If `b` is NULL then `y` points to a scalar. When all of them
+ *          are contiguous the whole thing is a single kernel call.
+ *
+ * @warning `dst` may be the same view as `a` or `b`, but must not otherwise
+ *          overlap them.
+ */
+static void c_nd_apply(NdOp op, const NdArray *out, lua_Number *dst,
+                       const NdArray *a, const lua_Number *x,
+                       const NdArray *b, const lua_Number *y)
+{
+    int last = out->ndim - 1;
+    int n    = out->shape[last];
+    int idx[NDARRAY_MAX_DIMS] = {0};
+    int od = 0, ox = 0, oy = 0;
+
+    if (out->size == 0)
+        return;
+    if (out->contiguous && a->contiguous && (b == NULL || b->contiguous)) {
+        c_nd_kernel(op, dst, 1, x, 1, y, (b == NULL) ? 0 : 1, out->size);
+        return;
+    }
+    for (int row = 0, nrows = out->size / n; row < nrows; row++) {
+        c_nd_kernel(op, dst + od, out->strides[last], x + ox, a->strides[last],
+                    y + oy, (b == NULL) ? 0 : b->strides[last], n);
+        // Odometer over the outer dimensions.
+        for (int k = last - 1; k >= 0; k--) {
+            od += out->strides[k];
+            ox += a->strides[k];
+            oy += (b == NULL) ? 0 : b->strides[k];
+            if (++idx[k] < out->shape[k])
+                break;
+            od -= out->strides[k] * out->shape[k];
+            ox -= a->strides[k] * out->shape[k];
+            oy -= (b == NULL) ? 0 : b->strides[k] * out->shape[k];
+            idx[k] = 0;
+        }
+    }
+}
+
+/**
+ * @brief   Resolve the optional output argument: a new contiguous ndarray
+ *          shaped like `self` if none or nil, else the given one.
+ *
+ * @exception <args[argn]>: type, other
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ */
+static NdArray *l_optarg_output(lua_State *L, int argn, const NdArray *self)
+{
+    NdArray *out;
+    if (lua_isnoneornil(L, argn))
+        return l_push_like(L, self);
+    out = l_checkarg_ndarray(L, argn);
+    luaL_argcheck(L, c_same_shape(self, out), argn, "shape mismatch");
+    lua_pushvalue(L, argn);
+    return out;
+}
+
+/**
+ * @exception <args[2:3]>:      type, other
+ *            l_push_like():    memory
+ *
+ * @note    Stack usage:    [ -(1|2), +1, m|v ]
+ *          Stack before:   [ self: ndarray, other: ndarray|number, out: ndarray? ]
+ *          Stack after:    [ out: ndarray ]
+ */
+static int c_binary_ndarray(lua_State *L, NdOp op)
+{
+    NdArray   *self = l_checkarg_ndarray(L, 1);
+    NdArray   *other = NULL;
+    NdArray   *out;
+    lua_Number scalar = 0;
+    const lua_Number *y;
+
+    if (l_isndarray(L, 2)) {
+        other = lua_touserdata(L, 2);
+        luaL_argcheck(L, c_same_shape(self, other), 2, "shape mismatch");
+    } else {
+        scalar = luaL_checknumber(L, 2);
+    }
+    lua_settop(L, 3);
+    out = l_optarg_output(L, 3, self); // [ self, other, out?, out ]
+    y   = (other == NULL) ? &scalar : l_nd_data(L, other, 2);
+    c_nd_apply(op, out, l_nd_data(L, out, 3), self, l_nd_data(L, self, 1), other, y);
+    return 1;
+}
+
+static int add_ndarray(lua_State *L)
+{
+    return c_binary_ndarray(L, ND_ADD);
+}
+
+static int sub_ndarray(lua_State *L)
+{
+    return c_binary_ndarray(L, ND_SUB);
+}
+
+static int mul_ndarray(lua_State *L)
+{
+    return c_binary_ndarray(L, ND_MUL);
+}
+
+static int div_ndarray(lua_State *L)
+{
+    return c_binary_ndarray(L, ND_DIV);
+}
+
+/**
+ * @note    Stack usage:    [ -1, +0, v ]
+ *          Stack before:   [ self: ndarray, v: number ]
+ *          Stack after:    [ self: ndarray ]
+ */
+static int fill_ndarray(lua_State *L)
+{
+    NdArray   *self = l_checkarg_ndarray(L, 1);
+    lua_Number v    = luaL_checknumber(L, 2);
+    lua_Number *dst = l_nd_data(L, self, 1);
+    c_nd_apply(ND_FILL, self, dst, self, dst, NULL, &v);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @note    Stack usage:    [ -1, +1, v ]
+ *          Stack before:   [ self: ndarray ]
+ *          Stack after:    [ sum: number ]
+ */
+static int sum_ndarray(lua_State *L)
+{
+    NdArray    *self = l_checkarg_ndarray(L, 1);
+    lua_Number *x    = l_nd_data(L, self, 1);
+    lua_Number  sum  = 0;
+    int         last = self->ndim - 1;
+    int         n    = self->shape[last];
+    int         s    = self->strides[last];
+    int         idx[NDARRAY_MAX_DIMS] = {0};
+    int         off  = 0;
+
+    if (self->contiguous) {
+        for (int i = 0; i < self->size; i++)
+            sum += x[i];
+    } else if (self->size > 0) {
+        for (int row = 0, nrows = self->size / n; row < nrows; row++) {
+            for (int i = 0; i < n; i++)
+                sum += x[off + i * s];
+            for (int k = last - 1; k >= 0; k--) {
+                off += self->strides[k];
+                if (++idx[k] < self->shape[k])
+                    break;
+                off -= self->strides[k] * self->shape[k];
+                idx[k] = 0;
+            }
+        }
+    }
+    lua_pushnumber(L, sum);
+    return 1;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// METHODS ---------------------------------------------------------------- {{{1
+
+/**
+ * @brief   `ndarray.new(shape, base?)`. Without `base` the array is backed by
+ *          a new zeroed dyarray; with it, the array is a row-major view of
+ *          its first `prod(shape)` elements.
+ *
+ * @exception <args[1:2]>: type, other
+ *            l_push_new(): memory
+ *
+ * @note    Stack usage:    [ -(1|2), +1, m|v ]
+ *          Stack before:   [ shape: integer|integer[], base: dyarray? ]
+ *          Stack after:    [ self: ndarray ]
+ */
+static int new_ndarray(lua_State *L)
+{
+    int      shape[NDARRAY_MAX_DIMS];
+    int      ndim = l_checkarg_shape(L, 1, shape, 0);
+    NdArray *self;
+
+    if (lua_isnoneornil(L, 2))
+        self = l_push_new(L, shape, ndim, 0);
+    else
+        self = l_push_new(L, shape, ndim, 2);
+    luaL_argcheck(L, self->span <= self->base->length, 2, "dyarray too short for shape");
+    return 1;
+}
+
+/**
+ * @exception <args[2:]>: type, index
+ *
+ * @note    Stack usage:    [ -(1+ndim), +1, v ]
+ *          Stack before:   [ self: ndarray, ...: integer ]
+ *          Stack after:    [ self[...]: number ]
+ */
+static int get_ndarray(lua_State *L)
+{
+    NdArray    *self = l_checkarg_ndarray(L, 1);
+    lua_Number *x    = l_nd_data(L, self, 1);
+    lua_pushnumber(L, x[l_nd_offset_args(L, self, 2)]);
+    return 1;
+}
+
+/**
+ * @exception <args[2:]>: type, index
+ *
+ * @note    Stack usage:    [ -(2+ndim), +1, v ]
+ *          Stack before:   [ self: ndarray, ...: integer, v: number ]
+ *          Stack after:    [ self: ndarray ]
+ */
+static int set_ndarray(lua_State *L)
+{
+    NdArray    *self = l_checkarg_ndarray(L, 1);
+    lua_Number *x    = l_nd_data(L, self, 1);
+    int         off  = l_nd_offset_args(L, self, 2);
+    x[off] = luaL_checknumber(L, 2 + self->ndim);
+    lua_settop(L, 1);
+    return 1;
+}
+
+// `shape()` and `strides()` return one integer per dimension.
+static int shape_ndarray(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    luaL_checkstack(L, self->ndim, NULL);
+    for (int k = 0; k < self->ndim; k++)
+        lua_pushinteger(L, self->shape[k]);
+    return self->ndim;
+}
+
+static int strides_ndarray(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    luaL_checkstack(L, self->ndim, NULL);
+    for (int k = 0; k < self->ndim; k++)
+        lua_pushinteger(L, self->strides[k]);
+    return self->ndim;
+}
+
+static int ndim_ndarray(lua_State *L)
+{
+    lua_pushinteger(L, l_checkarg_ndarray(L, 1)->ndim);
+    return 1;
+}
+
+static int size_ndarray(lua_State *L)
+{
+    lua_pushinteger(L, l_checkarg_ndarray(L, 1)->size);
+    return 1;
+}
+
+static int is_contiguous_ndarray(lua_State *L)
+{
+    lua_pushboolean(L, l_checkarg_ndarray(L, 1)->contiguous);
+    return 1;
+}
+
+/**
+ * @brief   The shared dyarray and the 1-based index of our first element in
+ *          it.
+ *
+ * @note    Stack usage:    [ -1, +2, - ]
+ *          Stack before:   [ self: ndarray ]
+ *          Stack after:    [ base: dyarray, start: integer ]
+ */
+static int base_ndarray(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, self->ref);
+    lua_pushinteger(L, self->offset + 1);
+    return 2;
+}
+
+// VIEWS ------------------------------------------------------------------ {{{2
+
+/**
+ * @brief   Same elements, new shape. One dimension may be `-1`, in which case
+ *          it is inferred from the others. Only contiguous arrays can be
+ *          reshaped without copying, so others must be `copy()`-ed first.
+ *
+ * @exception <args[2]>:     type, other
+ *            l_push_view(): memory
+ *
+ * @note    Stack usage:    [ -2, +1, m|v ]
+ *          Stack before:   [ self: ndarray, shape: integer|integer[] ]
+ *          Stack after:    [ view: ndarray ]
+ */
+static int reshape_ndarray(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    int      shape[NDARRAY_MAX_DIMS];
+    int      ndim  = l_checkarg_shape(L, 2, shape, 1);
+    int      infer = -1;
+    int      known;
+    NdArray *view;
+
+    if (!self->contiguous)
+        return luaL_error(L, LIB_NAME ": cannot reshape a non-contiguous view, copy() it first");
+    for (int k = 0; k < ndim; k++) {
+        if (shape[k] == -1) {
+            infer    = k;
+            shape[k] = 1;
+        }
+    }
+    known = c_shape_size(shape, ndim);
+    if (infer >= 0 && known > 0) {
+        shape[infer] = self->size / known;
+        known       *= shape[infer];
+    }
+    luaL_argcheck(L, known == self->size, 2, "size mismatch");
+
+    view = l_push_view(L, self);
+    view->ndim = ndim;
+    for (int k = 0; k < ndim; k++)
+        view->shape[k] = shape[k];
+    c_nd_default_strides(view);
+    c_nd_update(view);
+    return 1;
+}
+
+/**
+ * @brief   Permute the dimensions by swapping strides; no data moves. With no
+ *          arguments the order is reversed, so a matrix is transposed.
+ *
+ * @exception <args[2:]>:    type, other
+ *            l_push_view(): memory
+ *
+ * @note    Stack usage:    [ -(1+(0|ndim)), +1, m|v ]
+ *          Stack before:   [ self: ndarray, ...: integer ]
+ *          Stack after:    [ view: ndarray ]
+ */
+static int transpose_ndarray(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    int      perm[NDARRAY_MAX_DIMS];
+    int      seen = 0;
+    NdArray *view;
+
+    if (lua_gettop(L) == 1) {
+        for (int k = 0; k < self->ndim; k++)
+            perm[k] = self->ndim - 1 - k;
+    } else {
+        for (int k = 0; k < self->ndim; k++) {
+            perm[k] = luaL_checkint(L, k + 2) - 1;
+            luaL_argcheck(L, 0 <= perm[k] && perm[k] < self->ndim
+                          && !(seen & (1 << perm[k])), k + 2, "not a permutation");
+            seen |= 1 << perm[k];
+        }
+    }
+    view = l_push_view(L, self);
+    for (int k = 0; k < self->ndim; k++) {
+        view->shape[k]   = self->shape[perm[k]];
+        view->strides[k] = self->strides[perm[k]];
+    }
+    c_nd_update(view);
+    return 1;
+}
+
+/**
+ * @brief   Fix index `i` along dimension `k`, dropping that dimension. On a
+ *          1-D array this is the element itself rather than a 0-D view.
+ *
+ * @exception l_push_view(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ */
+static void l_push_select(lua_State *L, NdArray *self, int k, int c)
+{
+    NdArray *view;
+
+    if (self->ndim == 1) {
+        lua_pushnumber(L, l_nd_data(L, self, 1)[c * self->strides[0]]);
+        return;
+    }
+    view = l_push_view(L, self);
+    view->offset += c * self->strides[k];
+    for (int j = k; j < self->ndim - 1; j++) {
+        view->shape[j]   = self->shape[j + 1];
+        view->strides[j] = self->strides[j + 1];
+    }
+    view->ndim--;
+    c_nd_update(view);
+}
+
+/**
+ * @exception <args[2:3]>:   type, index
+ *            l_push_view(): memory
+ *
+ * @note    Stack usage:    [ -3, +1, m|v ]
+ *          Stack before:   [ self: ndarray, axis: integer, i: integer ]
+ *          Stack after:    [ view: ndarray|number ]
+ */
+static int select_ndarray(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    int      k    = luaL_checkint(L, 2) - 1;
+    luaL_argcheck(L, 0 <= k && k < self->ndim, 2, "no such dimension");
+    l_push_select(L, self, k, l_nd_index(L, self, k, luaL_checkinteger(L, 3), 3));
+    return 1;
+}
+
+// `a:row(i)` is `a:select(1, i)`.
+static int row_ndarray(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    l_push_select(L, self, 0, l_nd_index(L, self, 0, luaL_checkinteger(L, 2), 2));
+    return 1;
+}
+
+// `a:col(j)` is `a:select(2, j)`.
+static int col_ndarray(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    luaL_argcheck(L, self->ndim >= 2, 1, "need at least 2 dimensions");
+    l_push_select(L, self, 1, l_nd_index(L, self, 1, luaL_checkinteger(L, 2), 2));
+    return 1;
+}
+
+// 2}}} ------------------------------------------------------------------------
+
+/**
+ * @brief   A contiguous copy with its own buffer.
+ *
+ * @exception l_push_like(): memory
+ *
+ * @note    Stack usage:    [ -1, +1, m ]
+ *          Stack before:   [ self: ndarray ]
+ *          Stack after:    [ copy: ndarray ]
+ */
+static int copy_ndarray(lua_State *L)
+{
+    NdArray    *self = l_checkarg_ndarray(L, 1);
+    lua_Number *x    = l_nd_data(L, self, 1);
+    NdArray    *out  = l_push_like(L, self);
+    c_nd_apply(ND_COPY, out, dyarray_data(out->base), self, x, NULL, x);
+    return 1;
+}
+
+// `self` if already contiguous, else `self:copy()`.
+static int contiguous_ndarray(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    if (!self->contiguous)
+        return copy_ndarray(L);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   The elements in row-major order, as a new dyarray.
+ *
+ * @exception dyarray_push_new(): memory
+ *
+ * @note    Stack usage:    [ -1, +1, m ]
+ *          Stack before:   [ self: ndarray ]
+ *          Stack after:    [ flat: dyarray ]
+ */
+static int flatten_ndarray(lua_State *L)
+{
+    NdArray    *self = l_checkarg_ndarray(L, 1);
+    lua_Number *x    = l_nd_data(L, self, 1);
+    DyArray    *flat = dyarray_push_new(L, self->size);
+    NdArray     out  = *self;
+
+    // Describe the new buffer as a contiguous array of the same shape.
+    out.offset = 0;
+    c_nd_default_strides(&out);
+    c_nd_update(&out);
+    c_nd_apply(ND_COPY, &out, dyarray_data(flat), self, x, NULL, x);
+    return 1;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// METATABLE -------------------------------------------------------------- {{{1
+
+/**
+ * @brief   `a[i]` is `a:row(i)`, `a[{i, j, ...}]` is `a:get(i, j, ...)` and
+ *          strings look up methods.
+ *
+ * @exception <args[2]>: type, index
+ *
+ * @note    Stack usage:    [ -2, +1, m|v ]
+ *          Stack before:   [ self: ndarray, key: integer|integer[]|string ]
+ *          Stack after:    [ self[key]: ndarray|number|function|nil ]
+ */
+static int mt_index(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+
+    switch (lua_type(L, 2)) {
+    case LUA_TNUMBER:
+        l_push_select(L, self, 0, l_nd_index(L, self, 0, lua_tointeger(L, 2), 2));
+        return 1;
+    case LUA_TTABLE:
+        lua_pushnumber(L, l_nd_data(L, self, 1)[l_nd_offset_table(L, self, 2)]);
+        return 1;
+    case LUA_TSTRING:
+        lua_rawget(L, UPVALUE_MT);
+        return 1;
+    default:
+        return luaL_typerror(L, 2, "integer, table or string");
+    }
+}
+
+/**
+ * @brief   `a[{i, j, ...}] = v`, or `a[i] = v` on a 1-D array.
+ *
+ * @exception <args[2:3]>: type, index
+ *
+ * @note    Stack usage:    [ -3, +0, v ]
+ */
+static int mt_newindex(lua_State *L)
+{
+    NdArray    *self = l_checkarg_ndarray(L, 1);
+    lua_Number *x    = l_nd_data(L, self, 1);
+    lua_Number  v    = luaL_checknumber(L, 3);
+    int         off;
+
+    if (lua_type(L, 2) == LUA_TTABLE) {
+        off = l_nd_offset_table(L, self, 2);
+    } else {
+        luaL_argcheck(L, self->ndim == 1, 2, "use a table of indexes");
+        off = self->strides[0] * l_nd_index(L, self, 0, luaL_checkinteger(L, 2), 2);
+    }
+    x[off] = v;
+    return 0;
+}
+
+static int mt_len(lua_State *L)
+{
+    lua_pushinteger(L, l_checkarg_ndarray(L, 1)->shape[0]);
+    return 1;
+}
+
+// Nested braces, one level per dimension.
+static void c_nd_addvalues(luaL_Buffer *buf, const NdArray *self, const lua_Number *x, int k)
+{
+    char num[FORMAT_NUMBER_SIZE];
+
+    luaL_addchar(buf, '{');
+    for (int i = 0; i < self->shape[k]; i++) {
+        const lua_Number *p = x + i * self->strides[k];
+        if (i > 0)
+            luaL_addstring(buf, ", ");
+        if (k == self->ndim - 1)
+            luaL_addlstring(buf, num, cast(size_t, format_number(num, *p)));
+        else
+            c_nd_addvalues(buf, self, p, k + 1);
+    }
+    luaL_addchar(buf, '}');
+}
+
+/**
+ * @note    Stack usage:    [ -1, +1, m|v ]
+ *          Stack before:   [ self: ndarray ]
+ *          Stack after:    [ "ndarray(2x3) {{1, 2, 3}, {4, 5, 6}}" ]
+ */
+static int mt_tostring(lua_State *L)
+{
+    NdArray    *self = l_checkarg_ndarray(L, 1);
+    lua_Number *x    = l_nd_data(L, self, 1);
+    luaL_Buffer buf;
+
+    luaL_buffinit(L, &buf);
+    luaL_addstring(&buf, LIB_NAME "(");
+    for (int k = 0; k < self->ndim; k++) {
+        char num[FORMAT_NUMBER_SIZE];
+        if (k > 0)
+            luaL_addchar(&buf, 'x');
+        luaL_addlstring(&buf, num, cast(size_t, format_number(num, self->shape[k])));
+    }
+    luaL_addstring(&buf, ") ");
+    c_nd_addvalues(&buf, self, x, 0);
+    luaL_pushresult(&buf);
+    return 1;
+}
+
+// Let go of the buffer; it is collected once no view or dyarray uses it.
+static int mt_gc(lua_State *L)
+{
+    NdArray *self = l_checkarg_ndarray(L, 1);
+    luaL_unref(L, LUA_REGISTRYINDEX, self->ref);
+    self->ref = LUA_NOREF;
+    return 0;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+static const luaL_Reg lib_fns[] = {
+    {"new",             &new_ndarray},
+    {NULL,              NULL},
+};
+
+static const luaL_Reg no_fns[] = {
+    {NULL,              NULL},
+};
+
+// Methods and metamethods together; `mt_index()` looks up methods in `mt`.
+static const luaL_Reg mt_fns[] = {
+    {"get",             &get_ndarray},
+    {"set",             &set_ndarray},
+    {"shape",           &shape_ndarray},
+    {"strides",         &strides_ndarray},
+    {"ndim",            &ndim_ndarray},
+    {"size",            &size_ndarray},
+    {"is_contiguous",   &is_contiguous_ndarray},
+    {"base",            &base_ndarray},
+
+    // Views
+    {"reshape",         &reshape_ndarray},
+    {"transpose",       &transpose_ndarray},
+    {"select",          &select_ndarray},
+    {"row",             &row_ndarray},
+    {"col",             &col_ndarray},
+
+    // Copies
+    {"copy",            &copy_ndarray},
+    {"contiguous",      &contiguous_ndarray},
+    {"flatten",         &flatten_ndarray},
+
+    // Elementwise
+    {"add",             &add_ndarray},
+    {"sub",             &sub_ndarray},
+    {"mul",             &mul_ndarray},
+    {"div",             &div_ndarray},
+    {"fill",            &fill_ndarray},
+    {"sum",             &sum_ndarray},
+
+    {"__index",         &mt_index},
+    {"__newindex",      &mt_newindex},
+    {"__len",           &mt_len},
+    {"__tostring",      &mt_tostring},
+    {"__gc",            &mt_gc},
+    {NULL,              NULL},
+};
+
+LIB_EXPORT int luaopen_ndarray(lua_State *L)
+{
+    lua_settop(L, 0);                    // []
+    luaL_newmetatable(L, LIB_MTNAME);    // [ mt ]
+    lua_pushvalue(L, 1);                 // [ mt, mt ]
+    luaL_setfuncs(L, mt_fns, 1);         // [ mt ], reg(mt, mt_fns)
+    luaL_register(L, LIB_NAME, no_fns);  // [ mt, ndarray ] ; _G.ndarray = ndarray
+    lua_pushvalue(L, 1);                 // [ mt, ndarray, mt ]
+    luaL_setfuncs(L, lib_fns, 1);        // [ mt, ndarray ], reg(ndarray, lib_fns)
+    return 1;
+}
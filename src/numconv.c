@@ -0,0 +1,346 @@
+/**
+ * @name    Number Conversions
+ *
+ * @brief   Bulk string <-> number conversion, so that turning thousands of
+ *          literals into numbers (or back) costs one call instead of one
+ *          `tonumber()` or `string.format()` each.
+ *
+ *          local a, nbad = numconv.parse_many{"0x1", "0b101", "42", "1e3"}
+ *          local buf     = numconv.format_many(a, 16)
+ *          print(buf) --> 0x1 0x5 0x2a 0x3e8, one per line
+ *
+ * @note    Also exposes the bit helpers from `common.h` that `dyarray` sizes
+ *          its buffers with: `ilog2`, `next_pow2` and `popcount`.
+ */
+#define LIB_NAME "numconv"
+#include "common.h"
+#include "dyarray.h"
+#include "strbuf.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+#define DIGIT_INVALID   0xFF
+#define BASE_MIN        2
+#define BASE_MAX        36
+
+// Digit value of every byte, `DIGIT_INVALID` for non-digits. Filled in by
+// `luaopen_numconv()`.
+static uint8_t digit_values[256];
+
+// Most digits in each base that always fit in a `uint64_t`. Filled in by
+// `luaopen_numconv()`.
+static int safe_digits[BASE_MAX + 1];
+
+// HELPERS ----------------------------------------------------------------- {{{
+
+static void c_init_tables(void)
+{
+    for (int c = 0; c < 256; c++)
+        digit_values[c] = DIGIT_INVALID;
+    for (int c = '0'; c <= '9'; c++)
+        digit_values[c] = cast(uint8_t, c - '0');
+    for (int c = 'a'; c <= 'z'; c++) {
+        digit_values[c]               = cast(uint8_t, c - 'a' + 10);
+        digit_values[c - 'a' + 'A']   = cast(uint8_t, c - 'a' + 10);
+    }
+    for (int base = BASE_MIN; base <= BASE_MAX; base++) {
+        uint64_t limit = UINT64_MAX / cast(uint64_t, base);
+        uint64_t n     = 1;
+        int      k     = 0;
+        while (n <= limit) {
+            n *= cast(uint64_t, base);
+            k++;
+        }
+        safe_digits[base] = k;
+    }
+}
+
+/**
+ * @brief   Parse `s[0:len]` as digits in `base`, no sign or prefix. The loop
+ *          has no data-dependent branches: invalid digits are OR-ed into a
+ *          flag checked once at the end. Past `safe_digits[base]` digits we
+ *          continue in floating point, like `tonumber()` does.
+ *
+ * @return  0 if `s` is empty or has a non-digit, else 1.
+ */
+static int c_parse_digits(const char *s, size_t len, int base, lua_Number *out)
+{
+    const uint8_t *p    = cast(const uint8_t *, s);
+    size_t         safe = cast(size_t, safe_digits[base]);
+    size_t         i    = 0;
+    unsigned       bad  = (len == 0);
+    uint64_t       acc  = 0;
+    lua_Number     x;
+
+    for (; i < len && i < safe; i++) {
+        unsigned d = digit_values[p[i]];
+        bad |= (d >= cast(unsigned, base));
+        acc  = acc * cast(uint64_t, base) + d;
+    }
+    x = cast(lua_Number, acc);
+    for (; i < len; i++) {
+        unsigned d = digit_values[p[i]];
+        bad |= (d >= cast(unsigned, base));
+        x    = x * base + d;
+    }
+    *out = x;
+    return !bad;
+}
+
+/**
+ * @brief   Parse one literal: optional sign, then `0x` hex, `0b` binary or a
+ *          decimal integer. Anything else, such as fractions, exponents or
+ *          `inf`, goes through `strtod()`. With an explicit `base` there is no
+ *          prefix and no fallback. Surrounding whitespace is ignored.
+ *
+ * @return  0 if `s` is not a valid number, else 1.
+ */
+static int c_parse_number(const char *s, size_t len, int base, lua_Number *out)
+{
+    const char *end = s + len;
+    const char *p;
+    int         neg = 0, ok;
+
+    while (s < end && isspace(cast(unsigned char, *s)))
+        s++;
+    while (end > s && isspace(cast(unsigned char, end[-1])))
+        end--;
+    p = s;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = (*p++ == '-');
+
+    if (base != 0) {
+        ok = c_parse_digits(p, cast(size_t, end - p), base, out);
+    } else if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        ok = c_parse_digits(p + 2, cast(size_t, end - p - 2), 16, out);
+    } else if (end - p > 2 && p[0] == '0' && (p[1] == 'b' || p[1] == 'B')) {
+        ok = c_parse_digits(p + 2, cast(size_t, end - p - 2), 2, out);
+    } else {
+        ok = c_parse_digits(p, cast(size_t, end - p), 10, out);
+    }
+    if (!ok && base == 0 && s < end) {
+        // `s` is part of a Lua string, which is always nul-terminated, but
+        // `end` may have cut trailing spaces off.
+        char *stop;
+        *out = strtod(s, &stop);
+        return stop == end;
+    }
+    if (neg)
+        *out = -*out;
+    return ok;
+}
+
+/**
+ * @brief   Write the integer `n` in `base`, with a `0x` or `0b` prefix for
+ *          bases 16 and 2 so that `c_parse_number()` reads it back.
+ *
+ * @return  Length written. `buf` must have room for 67 chars.
+ */
+static int c_format_integer(char *buf, lua_Number n, int base)
+{
+    static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    char     tmp[64];
+    char    *end = tmp + sizeof(tmp);
+    char    *p   = end;
+    char    *q   = buf;
+    uint64_t u   = cast(uint64_t, fabs(n));
+
+    do {
+        *--p = digits[u % cast(uint64_t, base)];
+        u /= cast(uint64_t, base);
+    } while (u != 0);
+
+    if (n < 0)
+        *q++ = '-';
+    if (base == 16 || base == 2) {
+        *q++ = '0';
+        *q++ = (base == 16) ? 'x' : 'b';
+    }
+    memcpy(q, p, cast(size_t, end - p));
+    return cast_int(q - buf + (end - p));
+}
+
+static int l_optarg_base(lua_State *L, int argn, int def)
+{
+    int base = luaL_optint(L, argn, def);
+    luaL_argcheck(L, base == 0 || (BASE_MIN <= base && base <= BASE_MAX), argn,
+                  "base out of range");
+    return base;
+}
+
+// Non-negative integer argument, as a `uint64_t`.
+static uint64_t l_checkarg_u64(lua_State *L, int argn)
+{
+    lua_Number n = luaL_checknumber(L, argn);
+    luaL_argcheck(L, n >= 0 && n == floor(n) && n < 18446744073709551616.0, argn,
+                  "non-negative integer expected");
+    return cast(uint64_t, n);
+}
+
+// }}} -------------------------------------------------------------------------
+
+// METHODS ---------------------------------------------------------------- {{{1
+
+/**
+ * @brief   Parse every string in `strings[1:#strings]`. Numbers are copied
+ *          as-is. Entries that are not valid numbers become NaN and are
+ *          counted in `nbad`.
+ *
+ * @exception <args[1:2]>:        type
+ *            dyarray_push_new(): memory
+ *
+ * @note    Stack usage:    [ -(1|2), +2, m|v ]
+ *          Stack before:   [ strings: string[], base: integer? ]
+ *          Stack after:    [ values: dyarray, nbad: integer ]
+ *
+ * @note    `base` 0, the default, detects `0x` and `0b` prefixes and also
+ *          accepts anything `tonumber()` does. Otherwise every string must
+ *          be plain digits in that base, like `tonumber(s, base)`.
+ */
+static int parse_many_numconv(lua_State *L)
+{
+    int         base, len, nbad = 0;
+    DyArray    *out;
+    lua_Number *dst;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    base = l_optarg_base(L, 2, 0);
+    len  = cast_int(lua_objlen(L, 1));
+    lua_settop(L, 2);                  // [ strings, base ]
+    out  = dyarray_push_new(L, len);   // [ strings, base, values ]
+    dst  = dyarray_data(out);
+
+    for (int i = 0; i < len; i++) {
+        size_t      slen;
+        const char *s;
+        lua_rawgeti(L, 1, i + 1); // [ strings, base, values, strings[i + 1] ]
+        if (lua_type(L, -1) == LUA_TNUMBER) {
+            dst[i] = lua_tonumber(L, -1);
+        } else if (lua_type(L, -1) == LUA_TSTRING) {
+            s = lua_tolstring(L, -1, &slen);
+            if (!c_parse_number(s, slen, base, &dst[i])) {
+                dst[i] = NAN;
+                nbad++;
+            }
+        } else {
+            dst[i] = NAN;
+            nbad++;
+        }
+        lua_pop(L, 1); // [ strings, base, values ]
+    }
+    lua_pushinteger(L, nbad); // [ strings, base, values, nbad ]
+    return 2;
+}
+
+/**
+ * @brief   Format every element of `values` in `base`, separated by `sep`,
+ *          into a strbuf without making a Lua string per element.
+ *
+ * @exception <args[1:4]>:     type
+ *            <args[1]>:       non-integer in a base other than 10
+ *            strbuf_reserve(): memory
+ *
+ * @note    Stack usage:    [ -(1|2|3|4), +1, m|v ]
+ *          Stack before:   [ values: dyarray, base: integer?, sep: string?, out: strbuf? ]
+ *          Stack after:    [ out: strbuf ]
+ *
+ * @note    `base` defaults to 10, which formats like `tostring()`. Other
+ *          bases only take integers, and 16 and 2 get a `0x`/`0b` prefix.
+ *          `sep` defaults to `"\n"`. If `out` is given we append to it.
+ */
+static int format_many_numconv(lua_State *L)
+{
+    DyArray    *self = dyarray_check(L, 1);
+    int         base = l_optarg_base(L, 2, 10);
+    size_t      seplen;
+    const char *sep  = luaL_optlstring(L, 3, "\n", &seplen);
+    StrBuf     *out;
+    lua_Number *src  = dyarray_data(self);
+    int         len  = dyarray_length(self);
+
+    luaL_argcheck(L, base != 0, 2, "base out of range");
+    if (lua_isnoneornil(L, 4)) {
+        lua_settop(L, 3);         // [ values, base, sep ]
+        out = strbuf_push_new(L); // [ values, base, sep, out ]
+    } else {
+        out = strbuf_check(L, 4);
+        lua_settop(L, 4);         // [ values, base, sep, out ]
+    }
+
+    for (int i = 0; i < len; i++) {
+        // Room for a `FORMAT_NUMBER_SIZE` number or a 64-digit binary literal.
+        char *p = strbuf_reserve(L, out, 80 + seplen);
+        int   n;
+        if (base == 10) {
+            n = format_number(p, src[i]);
+        } else {
+            if (src[i] != floor(src[i]) || fabs(src[i]) >= 18446744073709551616.0)
+                return LIB_ERROR(L, "Cannot format %f in base %d", src[i], base);
+            n = c_format_integer(p, src[i], base);
+        }
+        if (i < len - 1) {
+            memcpy(p + n, sep, seplen);
+            n += cast_int(seplen);
+        }
+        out->length += cast(size_t, n);
+    }
+    return 1;
+}
+
+/**
+ * @note    Stack usage:    [ -1, +1, v ]
+ *          Stack before:   [ n: integer ]
+ *          Stack after:    [ floor(log2(n)): integer ]
+ */
+static int ilog2_numconv(lua_State *L)
+{
+    uint64_t n = l_checkarg_u64(L, 1);
+    luaL_argcheck(L, n > 0, 1, "positive integer expected");
+    lua_pushinteger(L, ilog2_u64(n));
+    return 1;
+}
+
+/**
+ * @brief   Smallest power of 2 no less than `n`, so `next_pow2(0)` is 1.
+ *
+ * @note    Stack usage:    [ -1, +1, v ]
+ *          Stack before:   [ n: integer ]
+ *          Stack after:    [ p: integer ]
+ */
+static int next_pow2_numconv(lua_State *L)
+{
+    uint64_t p = next_pow2_u64(l_checkarg_u64(L, 1));
+    luaL_argcheck(L, p != 0, 1, "result would not fit in 64 bits");
+    // Powers of 2 are exact as a `lua_Number` even past 2^53.
+    lua_pushnumber(L, cast(lua_Number, p));
+    return 1;
+}
+
+/**
+ * @note    Stack usage:    [ -1, +1, v ]
+ *          Stack before:   [ n: integer ]
+ *          Stack after:    [ #set bits: integer ]
+ */
+static int popcount_numconv(lua_State *L)
+{
+    lua_pushinteger(L, popcount_u64(l_checkarg_u64(L, 1)));
+    return 1;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+static const luaL_Reg lib_fns[] = {
+    {"parse_many",  &parse_many_numconv},
+    {"format_many", &format_many_numconv},
+    {"ilog2",       &ilog2_numconv},
+    {"next_pow2",   &next_pow2_numconv},
+    {"popcount",    &popcount_numconv},
+    {NULL,          NULL},
+};
+
+LIB_EXPORT int luaopen_numconv(lua_State *L)
+{
+    c_init_tables();
+    luaL_register(L, LIB_NAME, lib_fns); // [ numconv ], reg(_G.numconv, lib_fns)
+    return 1;
+}
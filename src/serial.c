@@ -0,0 +1,525 @@
+/**
+ * @name    Binary Serialization
+ *
+ * @brief   Compact binary encoding of nested Lua values, for checkpointing
+ *          large state without going through text. `serial.pack(v)` returns a
+ *          string that `serial.unpack(s)` turns back into an equal value.
+ *
+ * @note    Supported values are nil, booleans, numbers, strings, tables and
+ *          dyarrays. Tables that appear more than once, including cycles, are
+ *          written once and referenced by id afterwards, so the unpacked value
+ *          has the same shape of sharing as the original.
+ *
+ * @note    The format is meant for the machine that wrote it, or one like it:
+ *          doubles are stored in native byte order, and `unpack()` refuses
+ *          input written with the other byte order.
+ *
+ *          header:     "LS" version:u8 flags:u8
+ *          value:      tag:u8 payload
+ *          TAG_INT:    zigzag varint
+ *          TAG_NUMBER: 8 bytes
+ *          TAG_STRING: len:varint bytes
+ *          TAG_TABLE:  narr:varint nhash:u32 value[narr] (key value)[nhash]
+ *          TAG_REF:    id:varint, 1-based in order of first appearance
+ *          TAG_DYARRAY: len:varint double[len]
+ */
+#define LIB_NAME "serial"
+#include "common.h"
+#include "dyarray.h"
+#include <math.h>
+#include <string.h>
+
+#define SERIAL_VERSION      1
+#define SERIAL_FLAG_LE      0x01
+#define SERIAL_HEADER_SIZE  4
+#define SERIAL_MAX_DEPTH    200 // Each level recurses on the C stack.
+#define SERIAL_INIT_SIZE    256
+
+enum {
+    TAG_NIL,
+    TAG_FALSE,
+    TAG_TRUE,
+    TAG_INT,
+    TAG_NUMBER,
+    TAG_STRING,
+    TAG_TABLE,
+    TAG_REF,
+    TAG_DYARRAY,
+};
+
+// HELPERS ----------------------------------------------------------------- {{{
+
+static int c_is_little_endian(void)
+{
+    const uint16_t one = 1;
+    return *cast(const uint8_t *, &one) == 1;
+}
+
+static int bad_value(lua_State *L, int i)
+{
+    return LIB_ERROR(L, "Cannot pack a %s value", luaL_typename(L, i));
+}
+
+static int bad_input(lua_State *L, const char *why)
+{
+    return LIB_ERROR(L, "Cannot unpack: %s", why);
+}
+
+/**
+ * @brief   Numbers that are integers are written as varints. On 5.3+ this
+ *          follows the integer subtype so that `1.0` stays a float.
+ */
+static int l_tointeger(lua_State *L, int i, int64_t *out)
+{
+#if LUA_VERSION_NUM >= 503
+    if (!lua_isinteger(L, i))
+        return 0;
+    *out = cast(int64_t, lua_tointeger(L, i));
+    return 1;
+#else
+    lua_Number n = lua_tonumber(L, i);
+    // Exclusive upper bound since 2^63 itself is not representable.
+    if (n != floor(n) || n < -9223372036854775808.0 || n >= 9223372036854775808.0)
+        return 0;
+    *out = cast(int64_t, n);
+    return 1;
+#endif
+}
+
+static void l_pushint64(lua_State *L, int64_t i)
+{
+#if LUA_VERSION_NUM >= 503
+    lua_pushinteger(L, cast(lua_Integer, i));
+#else
+    // `lua_Integer` is only `ptrdiff_t` here, which may be 32 bits.
+    lua_pushnumber(L, cast(lua_Number, i));
+#endif
+}
+
+// }}} -------------------------------------------------------------------------
+
+// WRITER ----------------------------------------------------------------- {{{1
+
+/**
+ * @brief   Growable output buffer. The bytes live in a userdata "box" at
+ *          `box_idx` so that they are collected even if we throw halfway;
+ *          growing allocates a bigger box and replaces the old one in place.
+ */
+typedef struct {
+    lua_State *L;
+    uint8_t   *data;
+    size_t     length;
+    size_t     capacity;
+    int        box_idx;
+    int        refs_idx; // Stack index of `{[table] = id}`.
+    int        nrefs;
+} Writer;
+
+/**
+ * @exception lua_newuserdata(): memory
+ */
+static uint8_t *c_write_reserve(Writer *W, size_t n)
+{
+    if (W->length + n > W->capacity) {
+        size_t   ncap = W->capacity * 2;
+        uint8_t *tmp;
+        while (ncap < W->length + n)
+            ncap *= 2;
+        tmp = lua_newuserdata(W->L, ncap); // [ ..., nbox ]
+        memcpy(tmp, W->data, W->length);
+        lua_replace(W->L, W->box_idx);     // [ ... ] ; old box is now garbage
+        W->data     = tmp;
+        W->capacity = ncap;
+    }
+    return W->data + W->length;
+}
+
+static void c_write_bytes(Writer *W, const void *src, size_t n)
+{
+    memcpy(c_write_reserve(W, n), src, n);
+    W->length += n;
+}
+
+static void c_write_u8(Writer *W, uint8_t b)
+{
+    *c_write_reserve(W, 1) = b;
+    W->length++;
+}
+
+// LEB128: 7 bits per byte, high bit set on all but the last.
+static void c_write_varint(Writer *W, uint64_t u)
+{
+    uint8_t *p = c_write_reserve(W, 10);
+    uint8_t *q = p;
+    while (u >= 0x80) {
+        *q++ = cast(uint8_t, u | 0x80);
+        u >>= 7;
+    }
+    *q++ = cast(uint8_t, u);
+    W->length += cast(size_t, q - p);
+}
+
+static void c_write_int(Writer *W, int64_t i)
+{
+    // Zigzag so that small negative numbers stay short too.
+    uint64_t u = (cast(uint64_t, i) << 1) ^ cast(uint64_t, i >> 63);
+    c_write_u8(W, TAG_INT);
+    c_write_varint(W, u);
+}
+
+static int l_isdyarray(lua_State *L, int i)
+{
+    int ok;
+    if (!lua_getmetatable(L, i))             // [ ..., mt? ]
+        return 0;
+    luaL_getmetatable(L, DYARRAY_MTNAME);    // [ ..., mt, dyarray_mt ]
+    ok = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);                           // [ ... ]
+    return ok;
+}
+
+static void c_write_value(Writer *W, int v_idx, int depth);
+
+/**
+ * @brief   Write the array part `t[1:narr]`, then every other key as a pair.
+ *          The pair count is only known afterwards, so it is a fixed-size
+ *          field patched at the end.
+ *
+ * @note    Stack usage:    [ -0, +0, m|e ]
+ */
+static void c_write_table(Writer *W, int t_idx, int depth)
+{
+    lua_State *L    = W->L;
+    size_t     narr = lua_objlen(L, t_idx);
+    size_t     at;
+    uint32_t   nhash = 0;
+
+    luaL_checkstack(L, 6, LIB_NAME ": table too deeply nested");
+    c_write_u8(W, TAG_TABLE);
+    c_write_varint(W, narr);
+    at = W->length;
+    c_write_reserve(W, sizeof(nhash));
+    W->length += sizeof(nhash);
+
+    for (size_t i = 1; i <= narr; i++) {
+        lua_rawgeti(L, t_idx, cast_int(i)); // [ ..., t[i] ]
+        c_write_value(W, lua_gettop(L), depth + 1);
+        lua_pop(L, 1);                      // [ ... ]
+    }
+
+    lua_pushnil(L); // [ ..., nil ]
+    while (lua_next(L, t_idx)) {
+        // [ ..., k, t[k] ]
+        int k_idx = lua_gettop(L) - 1;
+        if (lua_type(L, k_idx) == LUA_TNUMBER) {
+            lua_Number k = lua_tonumber(L, k_idx);
+            if (1 <= k && k <= cast(lua_Number, narr) && k == floor(k)) {
+                lua_pop(L, 1); // [ ..., k ] ; already written
+                continue;
+            }
+        }
+        c_write_value(W, k_idx, depth + 1);
+        c_write_value(W, k_idx + 1, depth + 1);
+        nhash++;
+        lua_pop(L, 1); // [ ..., k ]
+    }
+    memcpy(W->data + at, &nhash, sizeof(nhash));
+}
+
+/**
+ * @exception bad_value(): other
+ *
+ * @note    Stack usage:    [ -0, +0, m|e ]
+ */
+static void c_write_value(Writer *W, int v_idx, int depth)
+{
+    lua_State *L = W->L;
+    int64_t    i;
+
+    if (depth > SERIAL_MAX_DEPTH)
+        LIB_ERROR(L, "Cannot pack tables nested deeper than %d", SERIAL_MAX_DEPTH);
+
+    switch (lua_type(L, v_idx)) {
+    case LUA_TNIL:
+        c_write_u8(W, TAG_NIL);
+        break;
+    case LUA_TBOOLEAN:
+        c_write_u8(W, lua_toboolean(L, v_idx) ? TAG_TRUE : TAG_FALSE);
+        break;
+    case LUA_TNUMBER:
+        if (l_tointeger(L, v_idx, &i)) {
+            c_write_int(W, i);
+        } else {
+            lua_Number n = lua_tonumber(L, v_idx);
+            c_write_u8(W, TAG_NUMBER);
+            c_write_bytes(W, &n, sizeof(n));
+        }
+        break;
+    case LUA_TSTRING: {
+        size_t      len;
+        const char *s = lua_tolstring(L, v_idx, &len);
+        c_write_u8(W, TAG_STRING);
+        c_write_varint(W, len);
+        c_write_bytes(W, s, len);
+        break;
+    }
+    case LUA_TTABLE:
+        lua_pushvalue(L, v_idx);      // [ ..., t ]
+        lua_rawget(L, W->refs_idx);   // [ ..., refs[t] ]
+        if (!lua_isnil(L, -1)) {
+            c_write_u8(W, TAG_REF);
+            c_write_varint(W, cast(uint64_t, lua_tointeger(L, -1)));
+            lua_pop(L, 1);            // [ ... ]
+            break;
+        }
+        lua_pop(L, 1);                // [ ... ]
+        lua_pushvalue(L, v_idx);      // [ ..., t ]
+        lua_pushinteger(L, ++W->nrefs);
+        lua_rawset(L, W->refs_idx);   // [ ... ] ; refs[t] = nrefs
+        c_write_table(W, v_idx, depth);
+        break;
+    case LUA_TUSERDATA:
+        if (l_isdyarray(L, v_idx)) {
+            DyArray *a = lua_touserdata(L, v_idx);
+            c_write_u8(W, TAG_DYARRAY);
+            c_write_varint(W, cast(uint64_t, a->length));
+            c_write_bytes(W, a->values, size_of_active(a));
+            break;
+        }
+        // Else fall through
+    default:
+        bad_value(L, v_idx);
+        break;
+    }
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// READER ----------------------------------------------------------------- {{{1
+
+typedef struct {
+    lua_State     *L;
+    const uint8_t *p;
+    const uint8_t *end;
+    int            refs_idx; // Stack index of `{[id] = table}`.
+    int            nrefs;
+} Reader;
+
+static const uint8_t *c_read_bytes(Reader *R, size_t n)
+{
+    const uint8_t *p = R->p;
+    if (cast(size_t, R->end - p) < n)
+        bad_input(R->L, "truncated");
+    R->p += n;
+    return p;
+}
+
+static uint64_t c_read_varint(Reader *R)
+{
+    uint64_t u = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t b = *c_read_bytes(R, 1);
+        u |= cast(uint64_t, b & 0x7F) << shift;
+        if (b < 0x80)
+            return u;
+    }
+    bad_input(R->L, "bad varint");
+    return 0;
+}
+
+// Read a count of items that each take at least 1 byte, so that garbage
+// input cannot make us preallocate more than the input could hold.
+static int c_read_count(Reader *R, size_t item_size)
+{
+    uint64_t n = c_read_varint(R);
+    if (n > INT32_MAX || n * item_size > cast(uint64_t, R->end - R->p))
+        bad_input(R->L, "bad length");
+    return cast_int(n);
+}
+
+static void c_read_value(Reader *R, int depth);
+
+/**
+ * @note    Stack usage:    [ -0, +1, m|e ]
+ */
+static void c_read_table(Reader *R, int depth)
+{
+    lua_State *L    = R->L;
+    int        narr = c_read_count(R, 1);
+    uint32_t   nhash;
+    int        t_idx;
+
+    memcpy(&nhash, c_read_bytes(R, sizeof(nhash)), sizeof(nhash));
+    if (nhash > cast(size_t, R->end - R->p) / 2)
+        bad_input(L, "bad length");
+
+    luaL_checkstack(L, 6, LIB_NAME ": table too deeply nested");
+    lua_createtable(L, narr, cast_int(nhash)); // [ ..., t ]
+    t_idx = lua_gettop(L);
+    lua_pushvalue(L, t_idx);                   // [ ..., t, t ]
+    lua_rawseti(L, R->refs_idx, ++R->nrefs);   // [ ..., t ] ; refs[nrefs] = t
+
+    for (int i = 1; i <= narr; i++) {
+        c_read_value(R, depth + 1); // [ ..., t, v ]
+        lua_rawseti(L, t_idx, i);   // [ ..., t ] ; t[i] = v
+    }
+    for (uint32_t i = 0; i < nhash; i++) {
+        c_read_value(R, depth + 1); // [ ..., t, k ]
+        if (lua_isnil(L, -1)
+            || (lua_type(L, -1) == LUA_TNUMBER && lua_tonumber(L, -1) != lua_tonumber(L, -1)))
+            bad_input(L, "nil or NaN key");
+        c_read_value(R, depth + 1); // [ ..., t, k, v ]
+        lua_rawset(L, t_idx);       // [ ..., t ] ; t[k] = v
+    }
+}
+
+/**
+ * @exception bad_input(): other
+ *
+ * @note    Stack usage:    [ -0, +1, m|e ]
+ */
+static void c_read_value(Reader *R, int depth)
+{
+    lua_State *L = R->L;
+
+    if (depth > SERIAL_MAX_DEPTH)
+        bad_input(L, "nested too deeply");
+
+    switch (*c_read_bytes(R, 1)) {
+    case TAG_NIL:
+        lua_pushnil(L);
+        break;
+    case TAG_FALSE:
+        lua_pushboolean(L, 0);
+        break;
+    case TAG_TRUE:
+        lua_pushboolean(L, 1);
+        break;
+    case TAG_INT: {
+        uint64_t u = c_read_varint(R);
+        l_pushint64(L, cast(int64_t, (u >> 1) ^ (~(u & 1) + 1)));
+        break;
+    }
+    case TAG_NUMBER: {
+        lua_Number n;
+        memcpy(&n, c_read_bytes(R, sizeof(n)), sizeof(n));
+        lua_pushnumber(L, n);
+        break;
+    }
+    case TAG_STRING: {
+        int len = c_read_count(R, 1);
+        lua_pushlstring(L, cast(const char *, c_read_bytes(R, len)), len);
+        break;
+    }
+    case TAG_TABLE:
+        c_read_table(R, depth);
+        break;
+    case TAG_REF: {
+        uint64_t id = c_read_varint(R);
+        if (id == 0 || id > cast(uint64_t, R->nrefs))
+            bad_input(L, "bad reference");
+        lua_rawgeti(L, R->refs_idx, cast_int(id));
+        break;
+    }
+    case TAG_DYARRAY: {
+        int      len = c_read_count(R, sizeof(lua_Number));
+        DyArray *a   = dyarray_push_new(L, len);
+        memcpy(dyarray_data(a), c_read_bytes(R, size_of_active(a)), size_of_active(a));
+        break;
+    }
+    default:
+        bad_input(L, "bad tag");
+        break;
+    }
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// METHODS ---------------------------------------------------------------- {{{1
+
+/**
+ * @exception <args[1]>:          other
+ *            lua_newuserdata(): memory
+ *
+ * @note    Stack usage:    [ -1, +1, m|e ]
+ *          Stack before:   [ v: any ]
+ *          Stack after:    [ s: string ]
+ */
+static int pack_serial(lua_State *L)
+{
+    Writer  W;
+    uint8_t header[SERIAL_HEADER_SIZE] = {'L', 'S', SERIAL_VERSION, 0};
+
+    luaL_checkany(L, 1);
+    lua_settop(L, 1);      // [ v ]
+    lua_newtable(L);       // [ v, refs ]
+    W.L        = L;
+    W.refs_idx = 2;
+    W.nrefs    = 0;
+    W.data     = lua_newuserdata(L, SERIAL_INIT_SIZE); // [ v, refs, box ]
+    W.box_idx  = 3;
+    W.length   = 0;
+    W.capacity = SERIAL_INIT_SIZE;
+
+    if (c_is_little_endian())
+        header[3] |= SERIAL_FLAG_LE;
+    c_write_bytes(&W, header, sizeof(header));
+    c_write_value(&W, 1, 0);
+    lua_pushlstring(L, cast(const char *, W.data), W.length); // [ v, refs, box, s ]
+    return 1;
+}
+
+/**
+ * @brief   Decode the value packed at byte `pos` of `s`. Also returns the
+ *          position just past it, so that values packed back to back can be
+ *          read in sequence.
+ *
+ * @exception <args[1]>:  type
+ *            bad_input(): other
+ *            dyarray_push_new(): memory
+ *
+ * @note    Stack usage:    [ -(1|2), +2, m|e ]
+ *          Stack before:   [ s: string, pos: integer? ]
+ *          Stack after:    [ v: any, next: integer ]
+ */
+static int unpack_serial(lua_State *L)
+{
+    Reader         R;
+    size_t         len;
+    const uint8_t *s   = cast(const uint8_t *, luaL_checklstring(L, 1, &len));
+    int            pos = luaL_optint(L, 2, 1);
+    const uint8_t *header;
+
+    luaL_argcheck(L, 1 <= pos && cast(size_t, pos) <= len + 1, 2, "position out of range");
+    lua_settop(L, 2);  // [ s, pos ]
+    lua_newtable(L);   // [ s, pos, refs ]
+    R.L        = L;
+    R.p        = s + pos - 1;
+    R.end      = s + len;
+    R.refs_idx = 3;
+    R.nrefs    = 0;
+
+    header = c_read_bytes(&R, SERIAL_HEADER_SIZE);
+    if (header[0] != 'L' || header[1] != 'S' || header[2] != SERIAL_VERSION)
+        bad_input(L, "not packed by this version");
+    if (((header[3] & SERIAL_FLAG_LE) != 0) != c_is_little_endian())
+        bad_input(L, "packed with a different byte order");
+
+    c_read_value(&R, 0);                                   // [ s, pos, refs, v ]
+    lua_pushinteger(L, cast(lua_Integer, R.p - s) + 1);    // [ s, pos, refs, v, next ]
+    return 2;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+static const luaL_Reg lib_fns[] = {
+    {"pack",    &pack_serial},
+    {"unpack",  &unpack_serial},
+    {NULL,      NULL},
+};
+
+LIB_EXPORT int luaopen_serial(lua_State *L)
+{
+    luaL_register(L, LIB_NAME, lib_fns); // [ serial ], reg(_G.serial, lib_fns)
+    return 1;
+}
@@ -0,0 +1,613 @@
+/**
+ * @name    Quantile Sketch
+ *
+ * @brief   A streaming, mergeable summary of a distribution for when keeping
+ *          every sample is not an option, e.g. request latencies. Values are
+ *          counted in buckets whose bounds grow geometrically by a factor of
+ *          `gamma = (1 + alpha) / (1 - alpha)`, so any quantile comes back
+ *          within a relative error of `alpha` of the true value, and bins
+ *          for values of any magnitude cost the same.
+ *
+ *          local s = sketch.new(0.01)
+ *          s:add_many(latencies)            -- a dyarray, in one call
+ *          print(s:quantile(0.99))
+ *          total:merge(s)                   -- e.g. across workers
+ *          local bytes = s:pack()           -- and `sketch.unpack(bytes)`
+ *
+ * @note    This is the DDSketch scheme (Masson et al., VLDB 2019). Inserting
+ *          costs one `log()` and is `O(1)` amortized; memory is bounded by
+ *          `max_bins` buckets each for positive and negative values. Once
+ *          those fill up the buckets closest to zero are folded together,
+ *          which only loses accuracy at the low end, rarely the interesting
+ *          end of a latency distribution. NaNs and infinities are ignored.
+ *
+ * @note    Merging is exact: merging sketches gives the same buckets as
+ *          adding all of their values to one, as long as neither collapsed.
+ */
+#define LIB_NAME "sketch"
+#include "common.h"
+#include "dyarray.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#define SKETCH_DEFAULT_ALPHA    0.01
+#define SKETCH_DEFAULT_BINS     2048
+#define SKETCH_MIN_BINS         16
+#define SKETCH_MIN_ALPHA        1e-4 // Keeps bucket keys well within `int`.
+#define SKETCH_VERSION          1
+#define SKETCH_FLAG_LE          0x01
+
+// Every function in `lib_fns` and `mt_fns` shares this upvalue, see
+// `luaopen_sketch()`.
+#define UPVALUE_MT  lua_upvalueindex(1)
+
+/**
+ * @brief   Dense counts for the bucket keys `offset` to `offset + length - 1`.
+ *          Bucket `k` holds the magnitudes in `(gamma^(k-1), gamma^k]`.
+ */
+typedef struct {
+    lua_Number *counts;
+    int         offset;
+    int         length;
+    int         capacity;
+} Store;
+
+typedef struct {
+    lua_Number  alpha;
+    lua_Number  gamma;
+    lua_Number  log_gamma;
+    lua_Number  count;      // Total of all buckets, zeros included.
+    lua_Number  zero_count; // Magnitudes too small to have a key.
+    lua_Number  min;
+    lua_Number  max;
+    lua_Number  sum;
+    int         max_bins;   // Per store.
+    Store       pos;
+    Store       neg;        // Keyed by magnitude.
+} Sketch;
+
+// HELPERS ----------------------------------------------------------------- {{{
+
+static Sketch *l_checkarg_sketch(lua_State *L, int argn)
+{
+    return l_checkarg_udata(L, argn, UPVALUE_MT, LIB_MTNAME);
+}
+
+static void c_init_sketch(Sketch *self, lua_Number alpha, int max_bins)
+{
+    memset(self, 0, sizeof(*self));
+    self->alpha     = alpha;
+    self->gamma     = (1 + alpha) / (1 - alpha);
+    self->log_gamma = log(self->gamma);
+    self->min       = HUGE_VAL;
+    self->max       = -HUGE_VAL;
+    self->max_bins  = max_bins;
+}
+
+/**
+ * @exception lua_newuserdata(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ */
+static Sketch *l_push_sketch(lua_State *L, lua_Number alpha, int max_bins)
+{
+    Sketch *self = lua_newuserdata(L, sizeof(*self)); // [ ...args, self ]
+    c_init_sketch(self, alpha, max_bins);
+    lua_pushvalue(L, UPVALUE_MT);                       // [ ...args, self, mt ]
+    lua_setmetatable(L, -2);                            // [ ...args, self ]
+    return self;
+}
+
+// }}} -------------------------------------------------------------------------
+
+// BUCKET STORE ------------------------------------------------------------ {{{
+
+static void c_store_free(lua_State *L, Store *st)
+{
+    if (st->counts != NULL)
+        free_pointer(L, st->counts, size_of_array(st->counts, st->capacity));
+    st->counts   = NULL;
+    st->capacity = 0;
+}
+
+/**
+ * @exception resize_pointer(): memory
+ */
+static void c_store_reserve(lua_State *L, Store *st, int n, int max_bins)
+{
+    int ncap = SKETCH_MIN_BINS;
+    if (n <= st->capacity)
+        return;
+    while (ncap < n)
+        ncap *= 2;
+    ncap = (ncap < max_bins) ? ncap : max_bins;
+    st->counts   = resize_pointer(L, st->counts,
+                                  size_of_array(st->counts, st->capacity),
+                                  size_of_array(st->counts, ncap));
+    st->capacity = ncap;
+}
+
+/**
+ * @brief   The index into `st->counts` of bucket `key`, growing the store to
+ *          cover it. If that would take more than `max_bins` buckets, the
+ *          lowest keys are folded into the lowest one that is kept, and keys
+ *          below it map to it.
+ *
+ * @exception resize_pointer(): memory
+ */
+static int c_store_index(lua_State *L, Store *st, int key, int max_bins)
+{
+    int         old_lo  = st->offset;
+    int         old_len = st->length;
+    int         lo, hi, nlen;
+    lua_Number *c;
+
+    if (old_len > 0 && old_lo <= key && key < old_lo + old_len)
+        return key - old_lo;
+    if (old_len == 0) {
+        c_store_reserve(L, st, 1, max_bins);
+        st->offset    = key;
+        st->length    = 1;
+        st->counts[0] = 0;
+        return 0;
+    }
+
+    lo = (key < old_lo) ? key : old_lo;
+    hi = (key > old_lo + old_len - 1) ? key : old_lo + old_len - 1;
+    if (hi - lo >= max_bins)
+        lo = hi - max_bins + 1;
+    nlen = hi - lo + 1;
+    c_store_reserve(L, st, nlen, max_bins);
+    c = st->counts;
+
+    if (lo <= old_lo) {
+        int shift = old_lo - lo;
+        memmove(c + shift, c, size_of_array(c, old_len));
+        for (int i = 0; i < shift; i++)
+            c[i] = 0;
+        for (int i = shift + old_len; i < nlen; i++)
+            c[i] = 0;
+    } else {
+        // Only reachable when `key` is a new high and the store is full.
+        int        drop   = lo - old_lo;
+        int        keep   = (old_len > drop) ? old_len - drop : 0;
+        lua_Number folded = 0;
+        for (int i = 0; i < old_len && i < drop; i++)
+            folded += c[i];
+        if (keep > 0)
+            memmove(c, c + drop, size_of_array(c, keep));
+        for (int i = keep; i < nlen; i++)
+            c[i] = 0;
+        c[0] += folded;
+    }
+    st->offset = lo;
+    st->length = nlen;
+    return (key > lo) ? key - lo : 0;
+}
+
+// }}} -------------------------------------------------------------------------
+
+// SKETCH ----------------------------------------------------------------- {{{1
+
+/**
+ * @brief   The value reported for bucket `key`: the point of the bucket whose
+ *          relative distance to either bound is `alpha`.
+ */
+static lua_Number c_bucket_value(const Sketch *self, int key)
+{
+    return 2 * exp(key * self->log_gamma) / (1 + self->gamma);
+}
+
+/**
+ * @exception resize_pointer(): memory
+ */
+static void c_sketch_add(lua_State *L, Sketch *self, lua_Number x, lua_Number w)
+{
+    lua_Number mag = fabs(x);
+
+    if (!(mag <= DBL_MAX))
+        return; // NaN or infinite.
+    if (mag < DBL_MIN) {
+        self->zero_count += w;
+    } else {
+        Store *st  = (x > 0) ? &self->pos : &self->neg;
+        int    key = cast_int(ceil(log(mag) / self->log_gamma));
+        int    i   = c_store_index(L, st, key, self->max_bins); // May move `counts`.
+        st->counts[i] += w;
+    }
+    self->count += w;
+    self->sum   += w * x;
+    self->min    = (x < self->min) ? x : self->min;
+    self->max    = (x > self->max) ? x : self->max;
+}
+
+static void c_store_merge(lua_State *L, Store *dst, const Store *src, int max_bins)
+{
+    if (src->length == 0)
+        return;
+    // Cover the highest key first, so that a collapse happens at most once.
+    c_store_index(L, dst, src->offset + src->length - 1, max_bins);
+    for (int i = 0; i < src->length; i++) {
+        if (src->counts[i] != 0) {
+            int j = c_store_index(L, dst, src->offset + i, max_bins);
+            dst->counts[j] += src->counts[i];
+        }
+    }
+}
+
+/**
+ * @brief   The value of rank `q * (count - 1)`, 0-based, walking up from the
+ *          most negative bucket. The extremes are tracked exactly, so `q = 0`
+ *          and `q = 1` are exact and nothing is reported outside them.
+ */
+static lua_Number c_sketch_quantile(const Sketch *self, lua_Number q)
+{
+    lua_Number rank = q * (self->count - 1);
+    lua_Number cum  = 0;
+    lua_Number v    = self->max;
+
+    if (self->count <= 0)
+        return NAN;
+    if (q <= 0 || q >= 1)
+        return (q <= 0) ? self->min : self->max;
+    for (int i = self->neg.length - 1; i >= 0; i--) {
+        cum += self->neg.counts[i];
+        if (cum > rank) {
+            v = -c_bucket_value(self, self->neg.offset + i);
+            goto done;
+        }
+    }
+    cum += self->zero_count;
+    if (cum > rank) {
+        v = 0;
+        goto done;
+    }
+    for (int i = 0; i < self->pos.length; i++) {
+        cum += self->pos.counts[i];
+        if (cum > rank) {
+            v = c_bucket_value(self, self->pos.offset + i);
+            goto done;
+        }
+    }
+done:
+    v = (v < self->min) ? self->min : v;
+    return (v > self->max) ? self->max : v;
+}
+
+/**
+ * @exception <args[1:2]>:       other
+ *            lua_newuserdata(): memory
+ *
+ * @note    Stack usage:    [ -(0|1|2), +1, m|v ]
+ *          Stack before:   [ alpha: number?, max_bins: integer? ]
+ *          Stack after:    [ self: sketch ]
+ */
+static int new_sketch(lua_State *L)
+{
+    lua_Number alpha    = luaL_optnumber(L, 1, SKETCH_DEFAULT_ALPHA);
+    int        max_bins = luaL_optint(L, 2, SKETCH_DEFAULT_BINS);
+
+    luaL_argcheck(L, SKETCH_MIN_ALPHA <= alpha && alpha < 1, 1,
+                  "relative accuracy must be in [1e-4, 1)");
+    luaL_argcheck(L, max_bins >= SKETCH_MIN_BINS, 2, "need at least 16 bins");
+    l_push_sketch(L, alpha, max_bins);
+    return 1;
+}
+
+/**
+ * @brief   Add `x`, `w` times if given.
+ *
+ * @exception <args[2:3]>:      type, other
+ *            resize_pointer(): memory
+ *
+ * @note    Stack usage:    [ -(1|2), +0, m|v ]
+ *          Stack before:   [ self: sketch, x: number, w: number? ]
+ *          Stack after:    [ self: sketch ]
+ */
+static int add_sketch(lua_State *L)
+{
+    Sketch    *self = l_checkarg_sketch(L, 1);
+    lua_Number x    = luaL_checknumber(L, 2);
+    lua_Number w    = luaL_optnumber(L, 3, 1);
+    luaL_argcheck(L, w >= 0, 3, "negative weight");
+    c_sketch_add(L, self, x, w);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   Add every value of a dyarray, without a Lua call per value.
+ *
+ * @exception <args[2]>:        type
+ *            resize_pointer(): memory
+ *
+ * @note    Stack usage:    [ -1, +0, m|v ]
+ *          Stack before:   [ self: sketch, values: dyarray ]
+ *          Stack after:    [ self: sketch ]
+ */
+static int add_many_sketch(lua_State *L)
+{
+    Sketch           *self = l_checkarg_sketch(L, 1);
+    DyArray          *a    = dyarray_check(L, 2);
+    const lua_Number *x    = dyarray_data(a);
+    int               n    = dyarray_length(a);
+
+    for (int i = 0; i < n; i++)
+        c_sketch_add(L, self, x[i], 1);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   Estimate of the `q`-quantile, within a relative error of `alpha`
+ *          unless the low buckets were collapsed. NaN if nothing was added.
+ *
+ * @exception <args[2]>: type, other
+ *
+ * @note    Stack usage:    [ -1, +1, v ]
+ *          Stack before:   [ self: sketch, q: number ]
+ *          Stack after:    [ self: sketch, quantile: number ]
+ */
+static int quantile_sketch(lua_State *L)
+{
+    Sketch    *self = l_checkarg_sketch(L, 1);
+    lua_Number q    = luaL_checknumber(L, 2);
+    luaL_argcheck(L, 0 <= q && q <= 1, 2, "quantile must be in [0, 1]");
+    lua_pushnumber(L, c_sketch_quantile(self, q));
+    return 1;
+}
+
+/**
+ * @brief   Add all of `other` into `self`. Both must have the same `alpha`;
+ *          `self` keeps its own `max_bins`.
+ *
+ * @exception <args[2]>:        type, other
+ *            resize_pointer(): memory
+ *
+ * @note    Stack usage:    [ -1, +0, m|v ]
+ *          Stack before:   [ self: sketch, other: sketch ]
+ *          Stack after:    [ self: sketch ]
+ */
+static int merge_sketch(lua_State *L)
+{
+    Sketch *self  = l_checkarg_sketch(L, 1);
+    Sketch *other = l_checkarg_sketch(L, 2);
+
+    luaL_argcheck(L, self->gamma == other->gamma, 2, "relative accuracy differs");
+    if (self != other) {
+        c_store_merge(L, &self->pos, &other->pos, self->max_bins);
+        c_store_merge(L, &self->neg, &other->neg, self->max_bins);
+        self->zero_count += other->zero_count;
+        self->count      += other->count;
+        self->sum        += other->sum;
+        self->min         = (other->min < self->min) ? other->min : self->min;
+        self->max         = (other->max > self->max) ? other->max : self->max;
+    } else {
+        // Merging with itself doubles every bucket.
+        for (int i = 0; i < self->pos.length; i++)
+            self->pos.counts[i] *= 2;
+        for (int i = 0; i < self->neg.length; i++)
+            self->neg.counts[i] *= 2;
+        self->zero_count *= 2;
+        self->count      *= 2;
+        self->sum        *= 2;
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int count_sketch(lua_State *L)
+{
+    lua_pushnumber(L, l_checkarg_sketch(L, 1)->count);
+    return 1;
+}
+
+static int sum_sketch(lua_State *L)
+{
+    lua_pushnumber(L, l_checkarg_sketch(L, 1)->sum);
+    return 1;
+}
+
+// Exact minimum and maximum, or nothing if nothing was added.
+static int range_sketch(lua_State *L)
+{
+    Sketch *self = l_checkarg_sketch(L, 1);
+    if (self->count <= 0)
+        return 0;
+    lua_pushnumber(L, self->min);
+    lua_pushnumber(L, self->max);
+    return 2;
+}
+
+static int mt_tostring(lua_State *L)
+{
+    Sketch *self = l_checkarg_sketch(L, 1);
+    lua_pushfstring(L, LIB_NAME "(alpha = %f, count = %f, bins = %d)",
+                    self->alpha, self->count, self->pos.length + self->neg.length);
+    return 1;
+}
+
+static int mt_gc(lua_State *L)
+{
+    Sketch *self = l_checkarg_sketch(L, 1);
+    DBG_PRINTFLN("free sketch of %d bins", self->pos.capacity + self->neg.capacity);
+    c_store_free(L, &self->pos);
+    c_store_free(L, &self->neg);
+    return 0;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// PACK AND UNPACK -------------------------------------------------------- {{{1
+
+static int c_is_little_endian(void)
+{
+    const uint16_t one = 1;
+    return *cast(const uint8_t *, &one) == 1;
+}
+
+static void c_add_store(luaL_Buffer *buf, const Store *st)
+{
+    int32_t head[2];
+    head[0] = cast(int32_t, st->offset);
+    head[1] = cast(int32_t, st->length);
+    luaL_addlstring(buf, cast(const char *, head), sizeof(head));
+    if (st->length > 0)
+        luaL_addlstring(buf, cast(const char *, st->counts), size_of_array(st->counts, st->length));
+}
+
+/**
+ * @brief   Everything needed to rebuild the sketch with `sketch.unpack()`, as
+ *          a plain string in native byte order like `serial.pack()` writes:
+ *
+ *          header:  "QS" version:u8 flags:u8
+ *          fields:  alpha count zero_count min max sum: double
+ *                   max_bins: i32
+ *          stores:  (offset: i32, length: i32, counts: double[length])[2]
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ *          Stack before:   [ self: sketch ]
+ *          Stack after:    [ self: sketch, s: string ]
+ */
+static int pack_sketch(lua_State *L)
+{
+    Sketch     *self = l_checkarg_sketch(L, 1);
+    char        header[4] = {'Q', 'S', SKETCH_VERSION, 0};
+    lua_Number  fields[6];
+    int32_t     max_bins = cast(int32_t, self->max_bins);
+    luaL_Buffer buf;
+
+    fields[0] = self->alpha;
+    fields[1] = self->count;
+    fields[2] = self->zero_count;
+    fields[3] = self->min;
+    fields[4] = self->max;
+    fields[5] = self->sum;
+    if (c_is_little_endian())
+        header[3] |= SKETCH_FLAG_LE;
+
+    luaL_buffinit(L, &buf);
+    luaL_addlstring(&buf, header, sizeof(header));
+    luaL_addlstring(&buf, cast(const char *, fields), sizeof(fields));
+    luaL_addlstring(&buf, cast(const char *, &max_bins), sizeof(max_bins));
+    c_add_store(&buf, &self->pos);
+    c_add_store(&buf, &self->neg);
+    luaL_pushresult(&buf);
+    return 1;
+}
+
+static int bad_input(lua_State *L, const char *why)
+{
+    return LIB_ERROR(L, "Cannot unpack: %s", why);
+}
+
+/**
+ * @exception bad_input(): other
+ *            resize_pointer(): memory
+ */
+static const char *c_read_store(lua_State *L, Store *st, int max_bins,
+                                const char *p, const char *end)
+{
+    int32_t head[2];
+
+    if (end - p < cast(ptrdiff_t, sizeof(head)))
+        bad_input(L, "truncated");
+    memcpy(head, p, sizeof(head));
+    p += sizeof(head);
+    if (head[1] < 0 || head[1] > max_bins)
+        bad_input(L, "bad bucket count");
+    if (end - p < cast(ptrdiff_t, head[1] * sizeof(lua_Number)))
+        bad_input(L, "truncated");
+    if (head[1] > 0) {
+        c_store_reserve(L, st, head[1], max_bins);
+        memcpy(st->counts, p, size_of_array(st->counts, head[1]));
+    }
+    st->offset = head[0];
+    st->length = head[1];
+    return p + head[1] * sizeof(lua_Number);
+}
+
+/**
+ * @exception <args[1]>:    type
+ *            bad_input():  other
+ *            resize_pointer(), lua_newuserdata(): memory
+ *
+ * @note    Stack usage:    [ -1, +1, m|e ]
+ *          Stack before:   [ s: string ]
+ *          Stack after:    [ self: sketch ]
+ */
+static int unpack_sketch(lua_State *L)
+{
+    size_t      len;
+    const char *p   = luaL_checklstring(L, 1, &len);
+    const char *end = p + len;
+    lua_Number  fields[6];
+    int32_t     max_bins;
+    Sketch     *self;
+
+    if (len < 4 + sizeof(fields) + sizeof(max_bins))
+        bad_input(L, "truncated");
+    if (p[0] != 'Q' || p[1] != 'S' || p[2] != SKETCH_VERSION)
+        bad_input(L, "not packed by this version");
+    if (((p[3] & SKETCH_FLAG_LE) != 0) != c_is_little_endian())
+        bad_input(L, "packed with a different byte order");
+    memcpy(fields, p + 4, sizeof(fields));
+    memcpy(&max_bins, p + 4 + sizeof(fields), sizeof(max_bins));
+    p += 4 + sizeof(fields) + sizeof(max_bins);
+    if (!(SKETCH_MIN_ALPHA <= fields[0] && fields[0] < 1) || max_bins < SKETCH_MIN_BINS)
+        bad_input(L, "bad parameters");
+
+    self = l_push_sketch(L, fields[0], max_bins); // [ s, self ]
+    self->count      = fields[1];
+    self->zero_count = fields[2];
+    self->min        = fields[3];
+    self->max        = fields[4];
+    self->sum        = fields[5];
+    p = c_read_store(L, &self->pos, max_bins, p, end);
+    p = c_read_store(L, &self->neg, max_bins, p, end);
+    if (p != end)
+        bad_input(L, "trailing bytes");
+    return 1;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+static const luaL_Reg lib_fns[] = {
+    {"new",         &new_sketch},
+    {"unpack",      &unpack_sketch},
+    {NULL,          NULL},
+};
+
+static const luaL_Reg no_fns[] = {
+    {NULL,          NULL},
+};
+
+// Methods and metamethods together; `mt.__index` is `mt` itself.
+static const luaL_Reg mt_fns[] = {
+    {"add",         &add_sketch},
+    {"add_many",    &add_many_sketch},
+    {"quantile",    &quantile_sketch},
+    {"merge",       &merge_sketch},
+    {"count",       &count_sketch},
+    {"sum",         &sum_sketch},
+    {"range",       &range_sketch},
+    {"pack",        &pack_sketch},
+    {"__tostring",  &mt_tostring},
+    {"__gc",        &mt_gc},
+    {NULL,          NULL},
+};
+
+LIB_EXPORT int luaopen_sketch(lua_State *L)
+{
+    lua_settop(L, 0);                    // []
+    luaL_newmetatable(L, LIB_MTNAME);    // [ mt ]
+    lua_pushvalue(L, 1);                 // [ mt, mt ]
+    lua_setfield(L, 1, "__index");       // [ mt ] ; mt.__index = mt
+    lua_pushvalue(L, 1);                 // [ mt, mt ]
+    luaL_setfuncs(L, mt_fns, 1);         // [ mt ], reg(mt, mt_fns)
+    luaL_register(L, LIB_NAME, no_fns);  // [ mt, sketch ] ; _G.sketch = sketch
+    lua_pushvalue(L, 1);                 // [ mt, sketch, mt ]
+    luaL_setfuncs(L, lib_fns, 1);        // [ mt, sketch ], reg(sketch, lib_fns)
+    return 1;
+}
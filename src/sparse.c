@@ -0,0 +1,921 @@
+/**
+ * @name    Sparse Vectors and Matrices
+ *
+ * @brief   A sparse vector stores only its nonzeros, as sorted indexes plus
+ *          values; a CSR (compressed sparse row) matrix does the same per
+ *          row, with `rowptr[i]` marking where row `i` starts. Memory and the
+ *          running time of every operation scale with the number of nonzeros
+ *          rather than with the dimension, except for the conversions to and
+ *          from dense dyarrays.
+ *
+ *          local v = sparse.vector(1e6, {3, 10, 999999}, {1, 2, 3})
+ *          print(v:dot(w), v:nnz())         -- w: a dense dyarray
+ *          local M = sparse.csr(2, 3, {1, 2, 2}, {1, 1, 3}, {5, 6, 7})
+ *          print(M:mul(dyarray.new{1, 1, 1})) --> {5, 13}
+ *
+ * @note    Indexes are 1-based in the API and stored 0-based as C `int`s,
+ *          which takes half the memory of storing them in a dyarray.
+ *          Duplicate entries given to the constructors are summed, and
+ *          explicit zeros are kept as structural entries.
+ */
+#define LIB_NAME "sparse"
+#include "common.h"
+#include "dyarray.h"
+#include <limits.h>
+#include <stdlib.h>
+
+#define VECTOR_MTNAME   LIB_MTNAME ".vector"
+#define CSR_MTNAME      LIB_MTNAME ".csr"
+
+// Every function in `lib_fns`, `vector_fns` and `csr_fns` shares these
+// upvalues, see `luaopen_sparse()`.
+#define UPVALUE_VECTOR_MT   lua_upvalueindex(1)
+#define UPVALUE_CSR_MT      lua_upvalueindex(2)
+
+typedef struct {
+    int         dim;      // Logical length.
+    int         nnz;      // #Stored entries.
+    int         capacity; // #Allocated entries.
+    int        *indices;  // 0-based, strictly increasing.
+    lua_Number *values;
+} SpVector;
+
+typedef struct {
+    int         nrows;
+    int         ncols;
+    int         capacity; // #Allocated entries of `cols` and `values`.
+    int        *rowptr;   // `nrows + 1` offsets; `rowptr[nrows]` is the nnz.
+    int        *cols;     // 0-based, strictly increasing within each row.
+    lua_Number *values;
+} CsrMatrix;
+
+// One entry while building from unsorted input.
+typedef struct {
+    int         row;
+    int         col;
+    lua_Number  value;
+} Entry;
+
+// HELPERS ----------------------------------------------------------------- {{{
+
+static SpVector *l_checkarg_vector(lua_State *L, int argn)
+{
+    return l_checkarg_udata(L, argn, UPVALUE_VECTOR_MT, VECTOR_MTNAME);
+}
+
+static CsrMatrix *l_checkarg_csr(lua_State *L, int argn)
+{
+    return l_checkarg_udata(L, argn, UPVALUE_CSR_MT, CSR_MTNAME);
+}
+
+static int l_isvector(lua_State *L, int i)
+{
+    int ok = 0;
+    if (lua_type(L, i) == LUA_TUSERDATA && lua_getmetatable(L, i)) {
+        ok = lua_rawequal(L, -1, UPVALUE_VECTOR_MT);
+        lua_pop(L, 1);
+    }
+    return ok;
+}
+
+static int l_checkarg_dim(lua_State *L, int argn)
+{
+    int n = luaL_checkint(L, argn);
+    luaL_argcheck(L, n >= 0, argn, "negative dimension");
+    return n;
+}
+
+/**
+ * @brief   A dense dyarray that must cover at least `len` elements.
+ *
+ * @exception <args[argn]>: type, other
+ */
+static const lua_Number *l_checkarg_dense(lua_State *L, int argn, int len)
+{
+    DyArray *a = dyarray_check(L, argn);
+    luaL_argcheck(L, dyarray_length(a) >= len, argn, "dense array too short");
+    return dyarray_data(a);
+}
+
+/**
+ * @brief   Numbers from either a dyarray or a table, so that the constructors
+ *          take both without copying the former.
+ */
+typedef struct {
+    const lua_Number *values; // NULL for tables.
+    int               argn;
+    int               length;
+} Source;
+
+static void l_checkarg_source(lua_State *L, int argn, Source *src)
+{
+    src->argn = argn;
+    if (lua_istable(L, argn)) {
+        src->values = NULL;
+        src->length = cast_int(lua_objlen(L, argn));
+    } else {
+        DyArray *a  = dyarray_check(L, argn);
+        src->values = dyarray_data(a);
+        src->length = dyarray_length(a);
+    }
+}
+
+// `src[i]`, 0-based.
+static lua_Number l_source_get(lua_State *L, const Source *src, int i)
+{
+    lua_Number n;
+    if (src->values != NULL)
+        return src->values[i];
+    lua_rawgeti(L, src->argn, i + 1); // [ ...args, src[i + 1] ]
+    if (!lua_isnumber(L, -1))
+        luaL_argerror(L, src->argn, "numbers expected");
+    n = lua_tonumber(L, -1);
+    lua_pop(L, 1);                    // [ ...args ]
+    return n;
+}
+
+// A 1-based index from `src` as a 0-based one in `[0, n)`.
+static int l_source_index(lua_State *L, const Source *src, int i, int n)
+{
+    lua_Number k = l_source_get(L, src, i);
+    luaL_argcheck(L, k >= 1 && k <= n && k == floor(k), src->argn, "index out of range");
+    return cast_int(k) - 1;
+}
+
+static int c_compare_entries(const void *a, const void *b)
+{
+    const Entry *x = a;
+    const Entry *y = b;
+    if (x->row != y->row)
+        return (x->row < y->row) ? -1 : 1;
+    if (x->col != y->col)
+        return (x->col < y->col) ? -1 : 1;
+    return 0;
+}
+
+/**
+ * @brief   Sort `entries` by (row, col) and sum duplicates, in place.
+ *
+ * @return  The number of distinct entries left at the front.
+ */
+static int c_sort_entries(Entry *entries, int n)
+{
+    int count = 0;
+    qsort(entries, cast(size_t, n), sizeof(entries[0]), &c_compare_entries);
+    for (int i = 0; i < n; i++) {
+        if (count > 0 && c_compare_entries(&entries[count - 1], &entries[i]) == 0)
+            entries[count - 1].value += entries[i].value;
+        else
+            entries[count++] = entries[i];
+    }
+    return count;
+}
+
+/**
+ * @brief   Read `rows` (optional), `cols` and `values` into a scratch array of
+ *          entries. The scratch array is a userdata so that it is collected
+ *          even if reading throws halfway.
+ *
+ * @exception <args[:]>:         type, index, other
+ *            lua_newuserdata(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m|v ]
+ */
+static Entry *l_read_entries(lua_State *L, const Source *rows, int nrows,
+                             const Source *cols, int ncols, const Source *vals)
+{
+    int    n = vals->length;
+    Entry *entries;
+
+    luaL_argcheck(L, cols->length == n, cols->argn, "length differs from values");
+    luaL_argcheck(L, rows == NULL || rows->length == n, rows ? rows->argn : 1,
+                  "length differs from values");
+    entries = lua_newuserdata(L, size_of_array(entries, n > 0 ? n : 1));
+    for (int i = 0; i < n; i++) {
+        entries[i].row   = (rows == NULL) ? 0 : l_source_index(L, rows, i, nrows);
+        entries[i].col   = l_source_index(L, cols, i, ncols);
+        entries[i].value = l_source_get(L, vals, i);
+    }
+    return entries;
+}
+
+// }}} -------------------------------------------------------------------------
+
+// VECTORS ---------------------------------------------------------------- {{{1
+
+/**
+ * @brief   Push an empty vector with room for `capacity` entries.
+ *
+ * @exception lua_newuserdata(), new_pointer(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ */
+static SpVector *l_push_vector(lua_State *L, int dim, int capacity)
+{
+    SpVector *self = lua_newuserdata(L, sizeof(*self)); // [ ...args, self ]
+
+    // Set these first so `__gc` is safe even if the allocations below throw.
+    self->dim      = dim;
+    self->nnz      = 0;
+    self->capacity = 0;
+    self->indices  = NULL;
+    self->values   = NULL;
+    lua_pushvalue(L, UPVALUE_VECTOR_MT); // [ ...args, self, mt ]
+    lua_setmetatable(L, -2);             // [ ...args, self ]
+
+    if (capacity > 0) {
+        self->indices  = new_pointer(L, size_of_array(self->indices, capacity));
+        self->capacity = capacity;
+        self->values   = new_pointer(L, size_of_array(self->values, capacity));
+    }
+    return self;
+}
+
+/**
+ * @brief   Index of the entry for C index `i`, or -1.
+ */
+static int c_vector_find(const SpVector *self, int i)
+{
+    int lo = 0, hi = self->nnz;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (self->indices[mid] < i)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < self->nnz && self->indices[lo] == i) ? lo : -1;
+}
+
+/**
+ * @brief   `sparse.vector(dim, indices?, values?)`, where `indices` are
+ *          1-based and need not be sorted.
+ *
+ * @exception <args[1:3]>:     type, index, other
+ *            l_push_vector(): memory
+ *
+ * @note    Stack usage:    [ -(1|3), +1, m|v ]
+ *          Stack before:   [ dim: integer, indices: (dyarray|integer[])?,
+ *                            values: (dyarray|number[])? ]
+ *          Stack after:    [ self: sparse.vector ]
+ */
+static int new_vector(lua_State *L)
+{
+    int       dim = l_checkarg_dim(L, 1);
+    Source    idx, vals;
+    Entry    *entries;
+    SpVector *self;
+    int       n;
+
+    if (lua_isnoneornil(L, 2)) {
+        l_push_vector(L, dim, 0);
+        return 1;
+    }
+    l_checkarg_source(L, 2, &idx);
+    l_checkarg_source(L, 3, &vals);
+    entries = l_read_entries(L, NULL, 0, &idx, dim, &vals); // [ ...args, entries ]
+    n       = c_sort_entries(entries, vals.length);
+    self    = l_push_vector(L, dim, n);                     // [ ...args, entries, self ]
+    for (int i = 0; i < n; i++) {
+        self->indices[i] = entries[i].col;
+        self->values[i]  = entries[i].value;
+    }
+    self->nnz = n;
+    return 1;
+}
+
+/**
+ * @brief   Keep the entries of a dense dyarray whose magnitude exceeds `eps`,
+ *          by default 0 so that only exact zeros are dropped.
+ *
+ * @exception <args[1:2]>:     type
+ *            l_push_vector(): memory
+ *
+ * @note    Stack usage:    [ -(1|2), +1, m|v ]
+ *          Stack before:   [ a: dyarray, eps: number? ]
+ *          Stack after:    [ v: sparse.vector ]
+ */
+static int from_dense_vector(lua_State *L)
+{
+    DyArray          *a   = dyarray_check(L, 1);
+    lua_Number        eps = luaL_optnumber(L, 2, 0);
+    int               len = dyarray_length(a);
+    const lua_Number *x   = dyarray_data(a);
+    SpVector         *self;
+    int               nnz = 0;
+
+    for (int i = 0; i < len; i++)
+        nnz += fabs(x[i]) > eps;
+    self = l_push_vector(L, len, nnz);
+    for (int i = 0; i < len; i++) {
+        if (fabs(x[i]) > eps) {
+            self->indices[self->nnz] = i;
+            self->values[self->nnz]  = x[i];
+            self->nnz++;
+        }
+    }
+    return 1;
+}
+
+static int dim_vector(lua_State *L)
+{
+    lua_pushinteger(L, l_checkarg_vector(L, 1)->dim);
+    return 1;
+}
+
+static int nnz_vector(lua_State *L)
+{
+    lua_pushinteger(L, l_checkarg_vector(L, 1)->nnz);
+    return 1;
+}
+
+/**
+ * @brief   `v[i]`, 0 if not stored. Binary search, `O(log nnz)`.
+ *
+ * @exception <args[2]>: type, index
+ */
+static int get_vector(lua_State *L)
+{
+    SpVector *self = l_checkarg_vector(L, 1);
+    int       i    = luaL_checkint(L, 2) - 1;
+    int       k;
+
+    luaL_argcheck(L, 0 <= i && i < self->dim, 2, "index out of range");
+    k = c_vector_find(self, i);
+    lua_pushnumber(L, (k < 0) ? 0 : self->values[k]);
+    return 1;
+}
+
+/**
+ * @brief   Copy out the 1-based indexes or the values as a new dyarray.
+ *
+ * @exception dyarray_push_new(): memory
+ */
+static int indices_vector(lua_State *L)
+{
+    SpVector   *self = l_checkarg_vector(L, 1);
+    lua_Number *dst  = dyarray_data(dyarray_push_new(L, self->nnz));
+    for (int k = 0; k < self->nnz; k++)
+        dst[k] = self->indices[k] + 1;
+    return 1;
+}
+
+static int values_vector(lua_State *L)
+{
+    SpVector   *self = l_checkarg_vector(L, 1);
+    lua_Number *dst  = dyarray_data(dyarray_push_new(L, self->nnz));
+    for (int k = 0; k < self->nnz; k++)
+        dst[k] = self->values[k];
+    return 1;
+}
+
+/**
+ * @brief   Dot product with a dense dyarray of at least `dim` elements, in
+ *          `O(nnz)`, or with another sparse vector, in `O(nnz + other.nnz)`.
+ *
+ * @exception <args[2]>: type, other
+ *
+ * @note    Stack usage:    [ -2, +1, v ]
+ *          Stack before:   [ self: sparse.vector, x: dyarray|sparse.vector ]
+ *          Stack after:    [ dot: number ]
+ */
+static int dot_vector(lua_State *L)
+{
+    SpVector  *self = l_checkarg_vector(L, 1);
+    lua_Number sum  = 0;
+
+    if (l_isvector(L, 2)) {
+        SpVector *other = lua_touserdata(L, 2);
+        int       i = 0, j = 0;
+        luaL_argcheck(L, other->dim == self->dim, 2, "dimension mismatch");
+        while (i < self->nnz && j < other->nnz) {
+            int a = self->indices[i], b = other->indices[j];
+            if (a == b)
+                sum += self->values[i++] * other->values[j++];
+            else if (a < b)
+                i++;
+            else
+                j++;
+        }
+    } else {
+        const lua_Number *x = l_checkarg_dense(L, 2, self->dim);
+        for (int k = 0; k < self->nnz; k++)
+            sum += self->values[k] * x[self->indices[k]];
+    }
+    lua_pushnumber(L, sum);
+    return 1;
+}
+
+/**
+ * @brief   `self + alpha * other` as a new vector, by merging the two sorted
+ *          index lists.
+ *
+ * @exception <args[2:3]>:     type, other
+ *            l_push_vector(): memory
+ *
+ * @note    Stack usage:    [ -(2|3), +1, m|v ]
+ *          Stack before:   [ self: sparse.vector, other: sparse.vector, alpha: number? ]
+ *          Stack after:    [ sum: sparse.vector ]
+ */
+static int add_vector(lua_State *L)
+{
+    SpVector  *self  = l_checkarg_vector(L, 1);
+    SpVector  *other = l_checkarg_vector(L, 2);
+    lua_Number alpha = luaL_optnumber(L, 3, 1);
+    SpVector  *out;
+    int        i = 0, j = 0, n = 0;
+
+    luaL_argcheck(L, other->dim == self->dim, 2, "dimension mismatch");
+    luaL_argcheck(L, self->nnz <= INT_MAX - other->nnz, 2, "too many entries");
+    out = l_push_vector(L, self->dim, self->nnz + other->nnz);
+    while (i < self->nnz || j < other->nnz) {
+        int a = (i < self->nnz) ? self->indices[i] : INT_MAX;
+        int b = (j < other->nnz) ? other->indices[j] : INT_MAX;
+        if (a == b) {
+            out->indices[n] = a;
+            out->values[n]  = self->values[i++] + alpha * other->values[j++];
+        } else if (a < b) {
+            out->indices[n] = a;
+            out->values[n]  = self->values[i++];
+        } else {
+            out->indices[n] = b;
+            out->values[n]  = alpha * other->values[j++];
+        }
+        n++;
+    }
+    out->nnz = n;
+    return 1;
+}
+
+/**
+ * @brief   Multiply every stored value by `s`, in place.
+ *
+ * @note    Stack usage:    [ -1, +0, v ]
+ *          Stack before:   [ self: sparse.vector, s: number ]
+ *          Stack after:    [ self: sparse.vector ]
+ */
+static int scale_vector(lua_State *L)
+{
+    SpVector  *self = l_checkarg_vector(L, 1);
+    lua_Number s    = luaL_checknumber(L, 2);
+    for (int k = 0; k < self->nnz; k++)
+        self->values[k] *= s;
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   A dense dyarray of length `dim`.
+ *
+ * @exception dyarray_push_new(): memory
+ */
+static int todense_vector(lua_State *L)
+{
+    SpVector   *self = l_checkarg_vector(L, 1);
+    lua_Number *dst  = dyarray_data(dyarray_push_new(L, self->dim));
+    for (int k = 0; k < self->nnz; k++)
+        dst[self->indices[k]] = self->values[k];
+    return 1;
+}
+
+/**
+ * @note    Stack usage:    [ -1, +1, m ]
+ *          Stack before:   [ self: sparse.vector ]
+ *          Stack after:    [ "sparse.vector(dim = 10, nnz = 2) {[3] = 1, [7] = 2}" ]
+ */
+static int mt_vector_tostring(lua_State *L)
+{
+    SpVector   *self = l_checkarg_vector(L, 1);
+    luaL_Buffer buf;
+
+    luaL_buffinit(L, &buf);
+    lua_pushfstring(L, LIB_NAME ".vector(dim = %d, nnz = %d) {", self->dim, self->nnz);
+    luaL_addvalue(&buf);
+    for (int k = 0; k < self->nnz; k++) {
+        char num[FORMAT_NUMBER_SIZE];
+        lua_pushfstring(L, (k > 0) ? ", [%d] = " : "[%d] = ", self->indices[k] + 1);
+        luaL_addvalue(&buf);
+        luaL_addlstring(&buf, num, cast(size_t, format_number(num, self->values[k])));
+    }
+    luaL_addchar(&buf, '}');
+    luaL_pushresult(&buf);
+    return 1;
+}
+
+static int mt_vector_gc(lua_State *L)
+{
+    SpVector *self = l_checkarg_vector(L, 1);
+    DBG_PRINTFLN("free vector of capacity %d", self->capacity);
+    if (self->indices != NULL)
+        free_pointer(L, self->indices, size_of_array(self->indices, self->capacity));
+    if (self->values != NULL)
+        free_pointer(L, self->values, size_of_array(self->values, self->capacity));
+    return 0;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+// CSR MATRICES ----------------------------------------------------------- {{{1
+
+/**
+ * @brief   Push an empty `nrows x ncols` matrix with room for `capacity`
+ *          entries. `rowptr` is zeroed.
+ *
+ * @exception lua_newuserdata(), new_pointer(): memory
+ *
+ * @note    Stack usage:    [ -0, +1, m ]
+ */
+static CsrMatrix *l_push_csr(lua_State *L, int nrows, int ncols, int capacity)
+{
+    CsrMatrix *self = lua_newuserdata(L, sizeof(*self)); // [ ...args, self ]
+
+    // Set these first so `__gc` is safe even if the allocations below throw.
+    self->nrows    = nrows;
+    self->ncols    = ncols;
+    self->capacity = 0;
+    self->rowptr   = NULL;
+    self->cols     = NULL;
+    self->values   = NULL;
+    lua_pushvalue(L, UPVALUE_CSR_MT); // [ ...args, self, mt ]
+    lua_setmetatable(L, -2);          // [ ...args, self ]
+
+    luaL_argcheck(L, nrows < INT_MAX, 1, "too many rows");
+    self->rowptr = new_pointer(L, size_of_array(self->rowptr, nrows + 1));
+    for (int i = 0; i <= nrows; i++)
+        self->rowptr[i] = 0;
+    if (capacity > 0) {
+        self->cols     = new_pointer(L, size_of_array(self->cols, capacity));
+        self->capacity = capacity;
+        self->values   = new_pointer(L, size_of_array(self->values, capacity));
+    }
+    return self;
+}
+
+static int c_csr_nnz(const CsrMatrix *self)
+{
+    return self->rowptr[self->nrows];
+}
+
+/**
+ * @brief   Fill `self` from entries sorted by (row, col), and turn the per-row
+ *          counts into offsets.
+ */
+static void c_csr_fill(CsrMatrix *self, const Entry *entries, int n)
+{
+    for (int k = 0; k < n; k++) {
+        self->cols[k]   = entries[k].col;
+        self->values[k] = entries[k].value;
+        self->rowptr[entries[k].row + 1]++;
+    }
+    for (int i = 0; i < self->nrows; i++)
+        self->rowptr[i + 1] += self->rowptr[i];
+}
+
+/**
+ * @brief   `sparse.csr(nrows, ncols, rows, cols, values)` from coordinate
+ *          triplets with 1-based indexes, in any order.
+ *
+ * @exception <args[1:5]>:  type, index, other
+ *            l_push_csr(): memory
+ *
+ * @note    Stack usage:    [ -5, +1, m|v ]
+ *          Stack before:   [ nrows: integer, ncols: integer, rows: dyarray|integer[],
+ *                            cols: dyarray|integer[], values: dyarray|number[] ]
+ *          Stack after:    [ self: sparse.csr ]
+ */
+static int new_csr(lua_State *L)
+{
+    int        nrows = l_checkarg_dim(L, 1);
+    int        ncols = l_checkarg_dim(L, 2);
+    Source     rows, cols, vals;
+    Entry     *entries;
+    CsrMatrix *self;
+    int        n;
+
+    l_checkarg_source(L, 3, &rows);
+    l_checkarg_source(L, 4, &cols);
+    l_checkarg_source(L, 5, &vals);
+    entries = l_read_entries(L, &rows, nrows, &cols, ncols, &vals); // [ ...args, entries ]
+    n       = c_sort_entries(entries, vals.length);
+    self    = l_push_csr(L, nrows, ncols, n); // [ ...args, entries, self ]
+    c_csr_fill(self, entries, n);
+    return 1;
+}
+
+/**
+ * @brief   The nonzeros of the row-major `nrows x ncols` matrix in a dense
+ *          dyarray, see `from_dense_vector()` for `eps`.
+ *
+ * @exception <args[1:4]>:  type, other
+ *            l_push_csr(): memory
+ *
+ * @note    Stack usage:    [ -(3|4), +1, m|v ]
+ *          Stack before:   [ a: dyarray, nrows: integer, ncols: integer, eps: number? ]
+ *          Stack after:    [ m: sparse.csr ]
+ */
+static int from_dense_csr(lua_State *L)
+{
+    int               nrows = l_checkarg_dim(L, 2);
+    int               ncols = l_checkarg_dim(L, 3);
+    lua_Number        eps   = luaL_optnumber(L, 4, 0);
+    const lua_Number *x;
+    CsrMatrix        *self;
+    int               nnz = 0;
+
+    luaL_argcheck(L, ncols == 0 || nrows <= INT_MAX / ncols, 2, "too many elements");
+    x = l_checkarg_dense(L, 1, nrows * ncols);
+    for (int i = 0; i < nrows * ncols; i++)
+        nnz += fabs(x[i]) > eps;
+    self = l_push_csr(L, nrows, ncols, nnz);
+    for (int i = 0, k = 0; i < nrows; i++) {
+        for (int j = 0; j < ncols; j++) {
+            lua_Number v = x[i * ncols + j];
+            if (fabs(v) > eps) {
+                self->cols[k]   = j;
+                self->values[k] = v;
+                k++;
+            }
+        }
+        self->rowptr[i + 1] = k;
+    }
+    return 1;
+}
+
+static int shape_csr(lua_State *L)
+{
+    CsrMatrix *self = l_checkarg_csr(L, 1);
+    lua_pushinteger(L, self->nrows);
+    lua_pushinteger(L, self->ncols);
+    return 2;
+}
+
+static int nnz_csr(lua_State *L)
+{
+    lua_pushinteger(L, c_csr_nnz(l_checkarg_csr(L, 1)));
+    return 1;
+}
+
+/**
+ * @brief   `m[i][j]`, 0 if not stored. Binary search within row `i`.
+ *
+ * @exception <args[2:3]>: type, index
+ */
+static int get_csr(lua_State *L)
+{
+    CsrMatrix *self = l_checkarg_csr(L, 1);
+    int        i    = luaL_checkint(L, 2) - 1;
+    int        j    = luaL_checkint(L, 3) - 1;
+    int        lo, hi;
+
+    luaL_argcheck(L, 0 <= i && i < self->nrows, 2, "index out of range");
+    luaL_argcheck(L, 0 <= j && j < self->ncols, 3, "index out of range");
+    lo = self->rowptr[i];
+    hi = self->rowptr[i + 1];
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (self->cols[mid] < j)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < self->rowptr[i + 1] && self->cols[lo] == j)
+        lua_pushnumber(L, self->values[lo]);
+    else
+        lua_pushnumber(L, 0);
+    return 1;
+}
+
+/**
+ * @brief   Sparse matrix times dense vector: `out = m * x`, where `x` has at
+ *          least `ncols` elements and `out` is `nrows` long.
+ *
+ * @exception <args[2:3]>:        type, other
+ *            dyarray_push_new(): memory
+ *
+ * @note    Stack usage:    [ -(2|3), +1, m|v ]
+ *          Stack before:   [ self: sparse.csr, x: dyarray, out: dyarray? ]
+ *          Stack after:    [ out: dyarray ]
+ */
+static int mul_csr(lua_State *L)
+{
+    CsrMatrix        *self = l_checkarg_csr(L, 1);
+    const lua_Number *x    = l_checkarg_dense(L, 2, self->ncols);
+    lua_Number       *y;
+
+    if (lua_isnoneornil(L, 3)) {
+        y = dyarray_data(dyarray_push_new(L, self->nrows));
+    } else {
+        DyArray *out = dyarray_check(L, 3);
+        luaL_argcheck(L, out != lua_touserdata(L, 2), 3, "must not be the input");
+        dyarray_reserve(L, out, self->nrows);
+        out->length = self->nrows;
+        y = dyarray_data(out);
+        lua_pushvalue(L, 3);
+    }
+    for (int i = 0; i < self->nrows; i++) {
+        lua_Number s = 0;
+        for (int k = self->rowptr[i]; k < self->rowptr[i + 1]; k++)
+            s += self->values[k] * x[self->cols[k]];
+        y[i] = s;
+    }
+    return 1;
+}
+
+/**
+ * @brief   Row `i` as a new sparse vector of dimension `ncols`.
+ *
+ * @exception <args[2]>:       type, index
+ *            l_push_vector(): memory
+ */
+static int row_csr(lua_State *L)
+{
+    CsrMatrix *self = l_checkarg_csr(L, 1);
+    int        i    = luaL_checkint(L, 2) - 1;
+    int        lo, n;
+    SpVector  *v;
+
+    luaL_argcheck(L, 0 <= i && i < self->nrows, 2, "index out of range");
+    lo = self->rowptr[i];
+    n  = self->rowptr[i + 1] - lo;
+    v  = l_push_vector(L, self->ncols, n);
+    for (int k = 0; k < n; k++) {
+        v->indices[k] = self->cols[lo + k];
+        v->values[k]  = self->values[lo + k];
+    }
+    v->nnz = n;
+    return 1;
+}
+
+/**
+ * @brief   `self + alpha * other` as a new matrix, merging row by row.
+ *
+ * @exception <args[2:3]>:  type, other
+ *            l_push_csr(): memory
+ *
+ * @note    Stack usage:    [ -(2|3), +1, m|v ]
+ *          Stack before:   [ self: sparse.csr, other: sparse.csr, alpha: number? ]
+ *          Stack after:    [ sum: sparse.csr ]
+ */
+static int add_csr(lua_State *L)
+{
+    CsrMatrix *self  = l_checkarg_csr(L, 1);
+    CsrMatrix *other = l_checkarg_csr(L, 2);
+    lua_Number alpha = luaL_optnumber(L, 3, 1);
+    int        nself = c_csr_nnz(self), nother = c_csr_nnz(other);
+    CsrMatrix *out;
+    int        n = 0;
+
+    luaL_argcheck(L, other->nrows == self->nrows && other->ncols == self->ncols, 2,
+                  "shape mismatch");
+    luaL_argcheck(L, nself <= INT_MAX - nother, 2, "too many entries");
+    out = l_push_csr(L, self->nrows, self->ncols, nself + nother);
+    for (int r = 0; r < self->nrows; r++) {
+        int i = self->rowptr[r], iend = self->rowptr[r + 1];
+        int j = other->rowptr[r], jend = other->rowptr[r + 1];
+        while (i < iend || j < jend) {
+            int a = (i < iend) ? self->cols[i] : INT_MAX;
+            int b = (j < jend) ? other->cols[j] : INT_MAX;
+            if (a == b) {
+                out->cols[n]   = a;
+                out->values[n] = self->values[i++] + alpha * other->values[j++];
+            } else if (a < b) {
+                out->cols[n]   = a;
+                out->values[n] = self->values[i++];
+            } else {
+                out->cols[n]   = b;
+                out->values[n] = alpha * other->values[j++];
+            }
+            n++;
+        }
+        out->rowptr[r + 1] = n;
+    }
+    return 1;
+}
+
+static int scale_csr(lua_State *L)
+{
+    CsrMatrix *self = l_checkarg_csr(L, 1);
+    lua_Number s    = luaL_checknumber(L, 2);
+    int        nnz  = c_csr_nnz(self);
+    for (int k = 0; k < nnz; k++)
+        self->values[k] *= s;
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   A dense row-major dyarray of `nrows * ncols` elements.
+ *
+ * @exception <args[1]>:          other
+ *            dyarray_push_new(): memory
+ */
+static int todense_csr(lua_State *L)
+{
+    CsrMatrix  *self = l_checkarg_csr(L, 1);
+    lua_Number *dst;
+
+    luaL_argcheck(L, self->ncols == 0 || self->nrows <= INT_MAX / self->ncols, 1,
+                  "too many elements");
+    dst = dyarray_data(dyarray_push_new(L, self->nrows * self->ncols));
+    for (int i = 0; i < self->nrows; i++) {
+        for (int k = self->rowptr[i]; k < self->rowptr[i + 1]; k++)
+            dst[i * self->ncols + self->cols[k]] = self->values[k];
+    }
+    return 1;
+}
+
+static int mt_csr_tostring(lua_State *L)
+{
+    CsrMatrix *self = l_checkarg_csr(L, 1);
+    lua_pushfstring(L, LIB_NAME ".csr(%d x %d, nnz = %d)",
+                    self->nrows, self->ncols, c_csr_nnz(self));
+    return 1;
+}
+
+static int mt_csr_gc(lua_State *L)
+{
+    CsrMatrix *self = l_checkarg_csr(L, 1);
+    DBG_PRINTFLN("free %d x %d matrix", self->nrows, self->ncols);
+    if (self->rowptr != NULL)
+        free_pointer(L, self->rowptr, size_of_array(self->rowptr, self->nrows + 1));
+    if (self->cols != NULL)
+        free_pointer(L, self->cols, size_of_array(self->cols, self->capacity));
+    if (self->values != NULL)
+        free_pointer(L, self->values, size_of_array(self->values, self->capacity));
+    return 0;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+static const luaL_Reg lib_fns[] = {
+    {"vector",          &new_vector},
+    {"from_dense",      &from_dense_vector},
+    {"csr",             &new_csr},
+    {"csr_from_dense",  &from_dense_csr},
+    {NULL,              NULL},
+};
+
+static const luaL_Reg no_fns[] = {
+    {NULL,              NULL},
+};
+
+// Methods and metamethods together; `mt.__index` is `mt` itself.
+static const luaL_Reg vector_fns[] = {
+    {"dim",             &dim_vector},
+    {"nnz",             &nnz_vector},
+    {"get",             &get_vector},
+    {"indices",         &indices_vector},
+    {"values",          &values_vector},
+    {"dot",             &dot_vector},
+    {"add",             &add_vector},
+    {"scale",           &scale_vector},
+    {"todense",         &todense_vector},
+    {"__len",           &dim_vector},
+    {"__tostring",      &mt_vector_tostring},
+    {"__gc",            &mt_vector_gc},
+    {NULL,              NULL},
+};
+
+static const luaL_Reg csr_fns[] = {
+    {"shape",           &shape_csr},
+    {"nnz",             &nnz_csr},
+    {"get",             &get_csr},
+    {"mul",             &mul_csr},
+    {"row",             &row_csr},
+    {"add",             &add_csr},
+    {"scale",           &scale_csr},
+    {"todense",         &todense_csr},
+    {"__tostring",      &mt_csr_tostring},
+    {"__gc",            &mt_csr_gc},
+    {NULL,              NULL},
+};
+
+/**
+ * @brief   Register `l` into the table on top of the stack, with the vector
+ *          and CSR metatables at stack indexes 1 and 2 as upvalues.
+ *
+ * @note    Stack usage:    [ -0, +0, m ]
+ */
+static void l_register_shared(lua_State *L, const luaL_Reg *l)
+{
+    lua_pushvalue(L, 1);     // [ ..., t, vector_mt ]
+    lua_pushvalue(L, 2);     // [ ..., t, vector_mt, csr_mt ]
+    luaL_setfuncs(L, l, 2);  // [ ..., t ]
+}
+
+LIB_EXPORT int luaopen_sparse(lua_State *L)
+{
+    lua_settop(L, 0);                         // []
+    luaL_newmetatable(L, VECTOR_MTNAME);      // [ vector_mt ]
+    luaL_newmetatable(L, CSR_MTNAME);         // [ vector_mt, csr_mt ]
+    for (int i = 1; i <= 2; i++) {
+        lua_pushvalue(L, i);                  // [ vector_mt, csr_mt, mt ]
+        lua_pushvalue(L, i);                  // [ vector_mt, csr_mt, mt, mt ]
+        lua_setfield(L, -2, "__index");       // [ vector_mt, csr_mt, mt ] ; mt.__index = mt
+        l_register_shared(L, (i == 1) ? vector_fns : csr_fns);
+        lua_pop(L, 1);                        // [ vector_mt, csr_mt ]
+    }
+    luaL_register(L, LIB_NAME, no_fns);       // [ vector_mt, csr_mt, sparse ]
+    l_register_shared(L, lib_fns);            // [ vector_mt, csr_mt, sparse ], reg(sparse, lib_fns)
+    return 1;
+}
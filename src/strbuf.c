@@ -0,0 +1,285 @@
+/**
+ * @name    String Builder
+ *
+ * @brief   A growable byte buffer for building large strings piece by piece.
+ *          Accumulating fragments in a table for `table.concat()` creates one
+ *          interned Lua string per fragment; appending to a `strbuf` only
+ *          copies bytes, and a single Lua string is created at the very end
+ *          (or none at all, with `buf:write(file)`).
+ *
+ *          local buf = strbuf.new()
+ *          for i = 1, 1e6 do
+ *              buf:append("item ", i, "\n")
+ *          end
+ *          buf:write(io.stdout)
+ *
+ * @note    The bytes live outside the Lua heap, allocated through
+ *          `resize_pointer()` so that they still count towards the GC debt.
+ */
+#define LIB_NAME "strbuf"
+#include "common.h"
+#include "strbuf.h"
+#include <lualib.h>
+
+// HELPERS ----------------------------------------------------------------- {{{
+
+static StrBuf *l_checkarg_strbuf(lua_State *L, int argn)
+{
+    return strbuf_check(L, argn);
+}
+
+static void c_strbuf_addnumber(lua_State *L, StrBuf *self, lua_Number n)
+{
+    char *p = strbuf_reserve(L, self, FORMAT_NUMBER_SIZE);
+    self->length += cast(size_t, format_number(p, n));
+}
+
+/**
+ * @brief   The `FILE *` behind an open `io` file handle. All of 5.1's
+ *          `FILE **`, 5.2+'s `luaL_Stream` and LuaJIT's file userdata start
+ *          with it.
+ *
+ * @exception <args[argn]>: type
+ */
+static FILE *l_checkarg_file(lua_State *L, int argn)
+{
+#if LUA_VERSION_NUM >= 502
+    luaL_Stream *s = luaL_checkudata(L, argn, LUA_FILEHANDLE);
+    FILE        *f = (s->closef == NULL) ? NULL : s->f;
+#else
+    FILE        *f = *cast(FILE **, luaL_checkudata(L, argn, LUA_FILEHANDLE));
+#endif
+    luaL_argcheck(L, f != NULL, argn, "attempt to use a closed file");
+    return f;
+}
+
+// }}} -------------------------------------------------------------------------
+
+// METHODS ---------------------------------------------------------------- {{{1
+
+/**
+ * @exception <args[1]>:        type
+ *            lua_newuserdata(), resize_pointer(): memory
+ *
+ * @note    Stack usage:    [ -(0|1), +1, m|v ]
+ *          Stack before:   [ capacity: integer? ]
+ *          Stack after:    [ self: strbuf ]
+ */
+static int new_strbuf(lua_State *L)
+{
+    int     cap  = luaL_optint(L, 1, 0);
+    StrBuf *self;
+
+    luaL_argcheck(L, cap >= 0, 1, "negative capacity");
+    self = strbuf_push_new(L); // [ cap?, self ]
+    if (cap > 0)
+        strbuf_reserve(L, self, cast(size_t, cap));
+    return 1;
+}
+
+/**
+ * @brief   Append each string or number argument in order. Numbers are
+ *          formatted with `format_number()`.
+ *
+ * @exception <args[2:]>:       type
+ *            resize_pointer(): memory
+ *
+ * @note    Stack usage:    [ -0, +0, m|v ]
+ *          Stack before:   [ self: strbuf, ...: (string|number) ]
+ *          Stack after:    [ self: strbuf, ...: (string|number) ]
+ */
+static int append_strbuf(lua_State *L)
+{
+    StrBuf *self = l_checkarg_strbuf(L, 1);
+    int     top  = lua_gettop(L);
+
+    for (int i = 2; i <= top; i++) {
+        size_t      len;
+        const char *s;
+        switch (lua_type(L, i)) {
+        case LUA_TNUMBER:
+            c_strbuf_addnumber(L, self, lua_tonumber(L, i));
+            break;
+        case LUA_TSTRING:
+            s = lua_tolstring(L, i, &len);
+            strbuf_addlstring(L, self, s, len);
+            break;
+        default:
+            return luaL_typerror(L, i, "string or number");
+        }
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @exception <args[2]>:        type
+ *            resize_pointer(): memory
+ *
+ * @note    Stack usage:    [ -1, +0, m|v ]
+ *          Stack before:   [ self: strbuf, n: number ]
+ *          Stack after:    [ self: strbuf ]
+ */
+static int append_number_strbuf(lua_State *L)
+{
+    StrBuf    *self = l_checkarg_strbuf(L, 1);
+    lua_Number n    = luaL_checknumber(L, 2);
+    c_strbuf_addnumber(L, self, n);
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   Append `n` copies of `s`, separated by `sep` if given. Like
+ *          `string.rep()` but without creating the repeated string.
+ *
+ * @exception <args[2:4]>:      type
+ *            resize_pointer(): memory
+ *
+ * @note    Stack usage:    [ -(2|3), +0, m|v ]
+ *          Stack before:   [ self: strbuf, s: string, n: integer, sep: string? ]
+ *          Stack after:    [ self: strbuf ]
+ */
+static int rep_strbuf(lua_State *L)
+{
+    StrBuf     *self = l_checkarg_strbuf(L, 1);
+    size_t      len, seplen;
+    const char *s    = luaL_checklstring(L, 2, &len);
+    int         n    = luaL_checkint(L, 3);
+    const char *sep  = luaL_optlstring(L, 4, "", &seplen);
+
+    if (n > 0) {
+        size_t total = len + seplen;
+        char  *p;
+        if (total != 0 && cast(size_t, n) > (~cast(size_t, 0) >> 1) / total)
+            return luaL_error(L, LIB_MEMERR);
+        p = strbuf_reserve(L, self, total * cast(size_t, n) - seplen);
+        for (int i = 0; i < n; i++) {
+            if (i > 0) {
+                memcpy(p, sep, seplen);
+                p += seplen;
+            }
+            memcpy(p, s, len);
+            p += len;
+        }
+        self->length = cast(size_t, p - self->data);
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   Make room for at least `n` more bytes without reallocating.
+ *
+ * @note    Stack usage:    [ -1, +0, m|v ]
+ *          Stack before:   [ self: strbuf, n: integer ]
+ *          Stack after:    [ self: strbuf ]
+ */
+static int reserve_strbuf(lua_State *L)
+{
+    StrBuf *self = l_checkarg_strbuf(L, 1);
+    int     n    = luaL_checkint(L, 2);
+    luaL_argcheck(L, n >= 0, 2, "negative size");
+    strbuf_reserve(L, self, cast(size_t, n));
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @brief   Forget the contents but keep the allocation, so that a buffer can
+ *          be reused in a loop without reallocating.
+ *
+ * @note    Stack usage:    [ -0, +0, - ]
+ *          Stack before:   [ self: strbuf ]
+ *          Stack after:    [ self: strbuf ]
+ */
+static int clear_strbuf(lua_State *L)
+{
+    StrBuf *self = l_checkarg_strbuf(L, 1);
+    self->length = 0;
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ * @note    Stack usage:    [ -0, +1, m ]
+ *          Stack before:   [ self: strbuf ]
+ *          Stack after:    [ self: strbuf, s: string ]
+ */
+static int tostring_strbuf(lua_State *L)
+{
+    StrBuf *self = l_checkarg_strbuf(L, 1);
+    lua_pushlstring(L, self->data, self->length);
+    return 1;
+}
+
+/**
+ * @brief   Write the contents straight to an `io` file, `io.stdout` if not
+ *          given, without creating a Lua string.
+ *
+ * @exception <args[2]>: type
+ *            fwrite():  other
+ *
+ * @note    Stack usage:    [ -(0|1), +0, v|e ]
+ *          Stack before:   [ self: strbuf, file: file*? ]
+ *          Stack after:    [ self: strbuf ]
+ */
+static int write_strbuf(lua_State *L)
+{
+    StrBuf *self = l_checkarg_strbuf(L, 1);
+    FILE   *f    = lua_isnoneornil(L, 2) ? stdout : l_checkarg_file(L, 2);
+
+    if (self->length > 0 && fwrite(self->data, 1, self->length, f) != self->length)
+        return LIB_ERROR(L, "write failed after %d bytes", cast_int(self->length));
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int length_strbuf(lua_State *L)
+{
+    StrBuf *self = l_checkarg_strbuf(L, 1);
+    lua_pushinteger(L, cast(lua_Integer, self->length));
+    return 1;
+}
+
+static int mt_gc(lua_State *L)
+{
+    StrBuf *self = l_checkarg_strbuf(L, 1);
+    DBG_PRINTFLN("free strbuf of capacity %d", cast_int(self->capacity));
+    if (self->data != NULL)
+        free_pointer(L, self->data, self->capacity);
+    return 0;
+}
+
+// 1}}} ------------------------------------------------------------------------
+
+static const luaL_Reg lib_fns[] = {
+    {"new",     &new_strbuf},
+    {NULL,      NULL},
+};
+
+// Methods and metamethods together; `mt.__index` is `mt` itself.
+static const luaL_Reg mt_fns[] = {
+    {"append",          &append_strbuf},
+    {"append_number",   &append_number_strbuf},
+    {"rep",             &rep_strbuf},
+    {"reserve",         &reserve_strbuf},
+    {"clear",           &clear_strbuf},
+    {"tostring",        &tostring_strbuf},
+    {"write",           &write_strbuf},
+    {"length",          &length_strbuf},
+    {"__len",           &length_strbuf},
+    {"__tostring",      &tostring_strbuf},
+    {"__gc",            &mt_gc},
+    {NULL,              NULL},
+};
+
+LIB_EXPORT int luaopen_strbuf(lua_State *L)
+{
+    luaL_newmetatable(L, LIB_MTNAME);    // [ mt ]
+    luaL_register(L, NULL, mt_fns);      // [ mt ], reg(mt, mt_fns)
+    lua_pushvalue(L, -1);                // [ mt, mt ]
+    lua_setfield(L, -2, "__index");      // [ mt ] ; mt.__index = mt
+    luaL_register(L, LIB_NAME, lib_fns); // [ mt, strbuf ], reg(_G.strbuf, lib_fns)
+    return 1;
+}
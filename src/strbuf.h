@@ -0,0 +1,92 @@
+/**
+ * @brief   Layout of the `strbuf` userdata, shared with other C modules so
+ *          that they can append to a buffer the caller passed in, or hand back
+ *          a new one, without going through Lua method calls.
+ *
+ * @note    Include this after `common.h`.
+ */
+#ifndef STRBUF_H
+#define STRBUF_H
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#define STRBUF_MTNAME           "C_Modules" "strbuf"
+#define STRBUF_MIN_SIZE         64
+
+typedef struct {
+    size_t  length;   // #Bytes written.
+    size_t  capacity; // #Bytes allocated.
+    char   *data;     // Not nul-terminated.
+} StrBuf;
+
+/**
+ * @brief   Like `luaL_checkudata()`, this throws if `args[argn]` is not a
+ *          strbuf.
+ */
+static inline StrBuf *strbuf_check(lua_State *L, int argn)
+{
+    return luaL_checkudata(L, argn, STRBUF_MTNAME);
+}
+
+/**
+ * @brief   Make room for `n` more bytes, at least doubling the capacity, and
+ *          return where they go. Bump `self->length` after writing them.
+ *
+ * @exception resize_pointer(): memory
+ */
+static inline char *strbuf_reserve(lua_State *L, StrBuf *self, size_t n)
+{
+    if (n > self->capacity - self->length) {
+        size_t ncap = (self->capacity < STRBUF_MIN_SIZE) ? STRBUF_MIN_SIZE : self->capacity;
+        if (n > (~cast(size_t, 0) >> 1) - self->length)
+            luaL_error(L, LIB_MEMERR);
+        while (ncap - self->length < n)
+            ncap *= 2;
+        self->data     = resize_pointer(L, self->data, self->capacity, ncap);
+        self->capacity = ncap;
+    }
+    return self->data + self->length;
+}
+
+static inline void strbuf_addlstring(lua_State *L, StrBuf *self, const char *s, size_t n)
+{
+    memcpy(strbuf_reserve(L, self, n), s, n);
+    self->length += n;
+}
+
+/**
+ * @brief   Create an empty strbuf. If the `strbuf` module has not been loaded
+ *          yet we `require` it so its metatable is registered.
+ *
+ * @exception require(): memory, other
+ *
+ * @note    Stack usage:    [ 0, +1, m|e ]
+ *          Stack before:   [ ...args ]
+ *          Stack after:    [ ...args, self ]
+ *
+ * @note    As in `bitset_push_new()`, the module is loaded before the
+ *          userdata is created so that the library outlives its `__gc`.
+ */
+static inline StrBuf *strbuf_push_new(lua_State *L)
+{
+    StrBuf *self;
+
+    luaL_getmetatable(L, STRBUF_MTNAME); // [ ...args, mt ]
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);                   // [ ...args ]
+        lua_getglobal(L, "require");     // [ ...args, require ]
+        lua_pushliteral(L, "strbuf");    // [ ...args, require, "strbuf" ]
+        lua_call(L, 1, 0);               // [ ...args ]
+        luaL_getmetatable(L, STRBUF_MTNAME);
+    }
+    self = lua_newuserdata(L, sizeof(*self)); // [ ...args, mt, self ]
+    self->length   = 0;
+    self->capacity = 0;
+    self->data     = NULL;
+    lua_insert(L, -2);                   // [ ...args, self, mt ]
+    lua_setmetatable(L, -2);             // [ ...args, self ] ; setmetatable(self, mt)
+    return self;
+}
+
+#endif // STRBUF_H
@@ -0,0 +1,47 @@
+local dyarray = require "dyarray"
+local bitset  = require "bitset"
+
+local b = bitset.new(10)
+print("\nCONSTRUCTION")
+print("b               ", b)
+print("b:set(2):set(5) ", b:set(2):set(5):set(9))
+print("b:test(5)       ", b:test(5))        --> true
+print("b[6]            ", b[6])             --> false
+b[9] = false
+print("b[9] = false    ", b)
+print("b:popcount()    ", b:popcount())     --> 2
+print("b:find_next(3)  ", b:find_next(3))   --> 5
+print("b:find_next(6)  ", b:find_next(6))   --> nil
+
+--- LOGICAL OPERATIONS --- {{{
+
+local c = bitset.new(10):set(5):set(7)
+
+print("\nLOGICAL OPERATIONS")
+print("b:band(c)       ", b:band(c))        --> 0000100000
+print("b:bor(c)        ", b:bor(c))         --> 0100101000
+print("b:bxor(c)       ", b:bxor(c))        --> 0100001000
+print("b:bnot()        ", b:bnot())         --> 1011011111
+print("#b:bnot()       ", b:bnot():popcount()) --> 8
+
+---@param b bitset
+local function mess_up_length(b)
+    return b:band(bitset.new(3))
+end
+
+print("b:band(short)   ", pcall(mess_up_length, b)) --> (length mismatch)
+
+--- }}}
+
+--- DYARRAY MASKS --- {{{
+
+local a = dyarray.new{5, 1, 8, 3, 9, 2}
+
+print("\nDYARRAY MASKS")
+print("a:lt(4)         ", a:lt(4))          --> 010101
+print("a:between(2, 8) ", a:between(2, 8))  --> 101101
+print("a:compress(...) ", a:compress(a:gt(4)))     --> {5, 8, 9}
+print("a:where(..., 0) ", a:where(a:ge(5), 0))     --> {5, 0, 8, 0, 9, 0}
+print("a:where(..., a) ", a:where(a:eq(1), a:cumsum())) --> {5, 1, 14, 17, 26, 28}
+
+--- }}}
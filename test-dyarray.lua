@@ -61,3 +61,310 @@ print("c:pop()      ", popped)
 print("c            ", c)
 
 --- }}}
+
+--- SCANS AND DIFFERENCES --- {{{
+
+local d = dyarray.new{1, 2, 3, 4, 5}
+
+print("\nSCANS AND DIFFERENCES")
+print("d                      ", d)
+print("d:cumsum()             ", d:cumsum())                   --> {1, 3, 6, 10, 15}
+print("d:cumprod()            ", d:cumprod())                  --> {1, 2, 6, 24, 120}
+print("d:cummax()             ", dyarray.new{3, 1, 4, 1, 5}:cummax()) --> {3, 3, 4, 4, 5}
+print("d:scan('sum', 'exclusive')", d:scan("sum", "exclusive")) --> {0, 1, 3, 6, 10}
+print("d:diff()               ", d:diff())                     --> {1, 1, 1, 1}
+print("d:cumsum():diff(2)     ", d:cumsum():diff(2))           --> {1, 1, 1}
+print("d:cumsum(d)            ", d:cumsum(d))                  --> {1, 3, 6, 10, 15}
+print("d[4] - d[1]            ", d[4] - d[1])                  --> 9 (sum of 2..4)
+
+--- }}}
+
+--- MASKS --- {{{
+
+-- This script never requires `bitset` itself. The masks below load it on
+-- demand, and the bitset must still be freed cleanly when the interpreter
+-- exits, after which `make test` checks the exit status.
+local m = dyarray.new{1, 2, 3}:lt(2)
+
+print("\nMASKS")
+print("{1, 2, 3}:lt(2)        ", m)                            --> 100
+print("compress               ", dyarray.new{1, 2, 3}:compress(m)) --> {1}
+
+--- }}}
+
+--- HEAP --- {{{
+
+local h = dyarray.heap("max")
+
+print("\nHEAP")
+print("h                  ", h)
+print("h:push(3, 30)      ", h:push(3, 30):push(9, 90):push(1, 10))
+print("h:peek()           ", h:peek())                    --> 9 90
+print("h:pop()            ", h:pop())                     --> 9 90
+print("h:replace_top(0, 0)", h:replace_top(0, 0))         --> 3 30
+print("h:pop()            ", h:pop())                     --> 1 10
+print("#h                 ", #h)                          --> 1
+
+local q = dyarray.heap():heapify(dyarray.new{5, 2, 8, 1}, dyarray.new{1, 2, 3, 4})
+print("q:pop()            ", q:pop())                     --> 1 4
+print("q:heapify(mismatch) ", pcall(q.heapify, q, dyarray.new{7, 7}, dyarray.new{1})) --> false (length mismatch with values)
+print("q unchanged        ", #q, q:pop())                 --> 3 2 2
+print("b:topk(3)          ", dyarray.new{5, 2, 8, 1, 9}:topk(3)) --> {9, 8, 5}
+print("dyarray.length(h)  ", pcall(dyarray.length, h))    --> false (C_Modulesdyarray expected, got userdata)
+print("h.length(b)        ", pcall(h.length, dyarray.new{})) --> false (C_Modulesdyarray.heap expected, got userdata)
+
+--- }}}
+
+--- GATHER AND SELECT --- {{{
+
+local e   = dyarray.new{10, 20, 30, 40, 50}
+local idx = dyarray.new{5, 1, -1, 2}
+
+print("\nGATHER AND SELECT")
+print("e:gather(idx)          ", e:gather(idx))                --> {50, 10, 50, 20}
+print("e:scatter(idx, 0)      ", e:copy():scatter(idx, 0))     --> {0, 0, 30, 40, 0}
+print("e:scatter(idx, idx)    ", e:copy():scatter(idx, idx))   --> {1, 2, 30, 40, -1}
+print("e:select('gt', 25)     ", e:select("gt", 25))           --> {30, 40, 50}
+print("e:select('between', ...)", e:select("between", 15, 35)) --> {20, 30}
+print("unique                 ", dyarray.new{3, 1, 3, 2, 1}:unique()) --> {1, 2, 3}
+print("unique with NaNs        ", dyarray.new{0/0, 2, 0/0, 1}:unique()) --> {1, 2, nan} (or -nan)
+
+---@param a dyarray
+local function mess_up_gather(a)
+    return a:gather(dyarray.new{1, 6})
+end
+
+print("e:gather({1, 6})       ", pcall(mess_up_gather, e))     --> (index out of range)
+
+--- }}}
+
+--- LINEAR ALGEBRA --- {{{
+
+local M = dyarray.new{1, 2, 3, 4, 5, 6} -- 2 x 3
+local N = dyarray.new{1, 0, 0, 1, 1, 1} -- 3 x 2
+
+print("\nLINEAR ALGEBRA")
+print("gemm(M, N, 2, 2, 3)    ", dyarray.gemm(M, N, 2, 2, 3))   --> {4, 5, 10, 11}
+print("gemv(M, {1, 1, 1})     ", dyarray.gemv(M, dyarray.new{1, 1, 1}, 2, 3)) --> {6, 15}
+print("gemm(M, N, 3, 2, 3)    ", pcall(dyarray.gemm, M, N, 3, 2, 3)) --> (too short)
+print("gemm(M, N, ..., M)     ", pcall(dyarray.gemm, M, N, 2, 2, 3, M)) --> (must not be one of the inputs)
+
+-- Large enough for the blocked path: I * X == X.
+local size = 70
+local I, X = dyarray.new(), dyarray.new()
+I:resize(size * size)
+X:resize(size * size)
+for i = 1, size * size do
+    X[i] = i % 9
+end
+for i = 0, size - 1 do
+    I[i * size + i + 1] = 1
+end
+local P = dyarray.gemm(I, X, size, size, size)
+local same = true
+for i = 1, size * size do
+    same = same and P[i] == X[i]
+end
+print("gemm(I, X) == X        ", same)                           --> true
+
+--- }}}
+
+--- ELEMENTWISE MATH --- {{{
+
+---@param a   dyarray
+---@param fn  fun(x: number): number
+---@param tol number
+local function close_to(a, fn, tol)
+    for i = 1, #a do
+        local want = fn(i / 7 - 40)
+        if math.abs(a[i] - want) > tol * (1 + math.abs(want)) then
+            return false
+        end
+    end
+    return true
+end
+
+local xs = dyarray.new()
+for i = 1, 560 do
+    xs:push(i / 7 - 40)
+end
+local h = dyarray.new{-1.5, -0.5, 0.5, 2.5}
+local z = dyarray.new{0, 1, 2}
+
+print("\nELEMENTWISE MATH")
+print("z:exp(), z:log()       ", z:exp()[1], z:log()[2])       --> 1 0
+print("z:sin(), z:cos()       ", z:sin()[1], z:cos()[1])       --> 0 1
+print("z:tanh(), z:sigmoid()  ", z:tanh()[1], z:sigmoid()[1])  --> 0 0.5
+print("h:floor()              ", h:floor())                    --> {-2, -1, 0, 2}
+print("h:ceil()               ", h:ceil())                     --> {-1, -0, 1, 3}
+print("h:round()              ", h:round())                    --> {-2, -1, 1, 3}
+print("z:pow(2), z:pow(3)     ", z:pow(2), z:pow(3))           --> {0, 1, 4} {0, 1, 8}
+print("z:pow(z)               ", z:pow(z))                     --> {1, 1, 4}
+print("z:pow(0.5)[3]          ", z:pow(0.5)[3] == math.sqrt(2)) --> true
+print("h:floor(h) (in-place)  ", h:floor(h) == h, h)           --> true {-2, -1, 0, 2}
+print("xs:exp() ~ math.exp    ", close_to(xs:exp(), math.exp, 1e-15)) --> true
+print("xs:sin() ~ math.sin    ", close_to(xs:sin(), math.sin, 1e-13)) --> true
+print("log(0), log(-1)        ", dyarray.new{0, -1}:log()[1], dyarray.new{-1}:log()[1] ~= dyarray.new{-1}:log()[1]) --> -inf true
+print("z:pow(h)               ", pcall(z.pow, z, h))           --> false (length mismatch)
+
+--- }}}
+
+--- STATISTICS --- {{{
+
+local s = dyarray.new{2, 4, 4, 4, 5, 5, 7, 9}
+
+print("\nSTATISTICS")
+print("s:mean()               ", s:mean())                     --> 5
+print("s:variance()           ", s:variance())                 --> 4
+print("s:std()                ", s:std())                      --> 2
+print("s:variance(1)          ", s:variance(1))                --> 4.5714285714286
+print("s:median()             ", s:median())                   --> 4.5
+print("s:quantile(0.25)       ", s:quantile(0.25))             --> 4
+print("s:quantiles{...}       ", s:quantiles{0.9, 0, 1})       --> {7.6, 2, 9}
+print("s (unchanged)          ", s)                            --> {2, 4, 4, 4, 5, 5, 7, 9}
+print("s:histogram(4)         ", s:histogram(4))               --> {1, 5, 1, 1}
+print("s:histogram(2, 0, 4)   ", s:histogram(2, 0, 4))         --> {0, 4}
+print("median with NaN        ", dyarray.new{3, 0/0, 1}:median()) --> 2
+local nan = dyarray.new():median()
+print("empty median is NaN    ", nan ~= nan)                   --> true
+
+-- Large enough for the partitioning path, in reverse order.
+local r = dyarray.new()
+for i = 1, 1001 do
+    r:push(1002 - i)
+end
+print("r:quantiles{...}       ", r:quantiles{0.5, 0.001, 0.999}) --> {501, 2, 1000}
+print("s:quantile(2)          ", pcall(s.quantile, s, 2))      --> (quantile must be in [0, 1])
+
+--- }}}
+
+--- RANDOM --- {{{
+
+---@param a  dyarray
+---@param lo number
+---@param hi number
+local function all_within(a, lo, hi)
+    for i = 1, #a do
+        if a[i] < lo or a[i] >= hi then
+            return false
+        end
+    end
+    return true
+end
+
+dyarray.seed(2024)
+local r1 = dyarray.random(1000)
+dyarray.seed(2024)
+local r2 = dyarray.random(1000)
+local rng = dyarray.rng(7)
+local deck = dyarray.new{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}
+
+print("\nRANDOM")
+print("same seed, same values ", r1[1] == r2[1] and r1[1000] == r2[1000]) --> true
+print("seed(0/0), seed(2^63)   ", (pcall(dyarray.seed, 0/0)), (pcall(rng.seed, rng, 2^63))) --> false false
+print("random(1000) in [0, 1) ", all_within(r1, 0, 1))         --> true
+print("fill_uniform(-2, 2)    ", all_within(r1:copy():fill_uniform(-2, 2, rng), -2, 2)) --> true
+print("random(1e5, 'normal')  ", math.abs(dyarray.random(1e5, "normal", rng):mean()) < 0.02) --> true
+print("fill_normal(10, 0.5)   ", math.abs(r1:copy():fill_normal(10, 0.5, rng):mean() - 10) < 0.1) --> true
+print("deck:shuffle()         ", deck:copy():shuffle(rng):unique()) --> {1, 2, 3, 4, 5, 6, 7, 8, 9, 10}
+print("#deck:sample(3)        ", #deck:sample(3, rng), #deck:sample(3, rng):unique()) --> 3 3
+print("deck:sample(10)        ", deck:sample(10):unique())    --> {1, 2, 3, 4, 5, 6, 7, 8, 9, 10}
+print("rng:random(1, 6)       ", all_within(dyarray.new{rng:random(1, 6), rng:random(6)}, 1, 7)) --> true
+print("rng:split()            ", rng:split():random() ~= rng:random()) --> true
+print("deck:sample(11)        ", pcall(deck.sample, deck, 11)) --> false (sample size out of range)
+print("deck:shuffle({})       ", pcall(deck.shuffle, deck, {})) --> false (C_Modulesdyarray.rng expected, got table)
+
+--- }}}
+
+--- LAZY EXPRESSIONS --- {{{
+
+-- Scoped so these names do not shadow the arrays used further down.
+do
+    local a = dyarray.new{0, 4, 12, 24}
+    local b = dyarray.new{1, 1, 1, 1}
+    local e = a:lazy()
+    local f = ((e * 2) + b):sqrt()
+
+    -- Large enough for several blocks.
+    local long = dyarray.new()
+    for i = 1, 1001 do
+        long:push(i)
+    end
+
+    print("\nLAZY EXPRESSIONS")
+    print("f                      ", f)          --> C_Modulesdyarray.expr: sqrt(((x1 * 2) + x2))
+    print("f:eval()               ", f:eval())                     --> {1, 3, 5, 7}
+    print("f:sum()                ", f:sum())                      --> 16
+    print("(e - b):mean()         ", (e - b):mean())               --> 9
+    print("(1 - e):exp()          ", (1 - e):exp())      --> C_Modulesdyarray.expr: exp((1 - x1))
+    print("(-(e + 1)):max()       ", (-(e + 1)):max())             --> -1
+    print("(e - 5):abs():min()    ", (e - 5):abs():min())          --> 1
+    print("(e + 1):reduce('prod') ", (e + 1):reduce("prod"))       --> 1625
+    print("(e ^ 2):sum(), #e      ", (e ^ 2):sum(), #e)            --> 736 4
+    print("(e * e):sum()          ", (e * e):sum())                --> 736
+    print("(e * 0.5):eval(a)      ", (e * 0.5):eval(a) == a, a)    --> true {0, 2, 6, 12}
+    print("e:sum() (reads a now)  ", e:sum())                      --> 20
+    print("long * 2 - long        ", (long:lazy() * 2 - long):sum()) --> 501501
+    b:push(1)
+    print("(e + b):sum()          ", pcall(f.sum, e + b))          --> false (expression inputs differ in length (4 and 5))
+    print("e + {}                 ", pcall(function() return e + {} end)) --> false (number, dyarray or C_Modulesdyarray.expr expected, got table)
+end
+
+--- }}}
+
+--- RAW POINTER --- {{{
+
+print("\nRAW POINTER")
+print("e:ptr()                ", e:ptr())                      --> userdata: 0x... 5
+
+if jit then
+    local dyffi = require "dyarray_ffi"
+    print("dyffi.sum(e)           ", dyffi.sum(e))              --> 150
+    dyffi.view(e).values[0] = 11
+    print("dyffi.view(e)          ", e[1])                      --> 11
+end
+
+--- }}}
+
+--- DUMP TABLE --- {{{
+
+local config = {name = "svc", ports = {80, 443}, ratio = 0.25, ["a\nb"] = true}
+config.self  = config
+config.alias = config.ports
+
+print("\nDUMP TABLE")
+print(dump_table(config, {sort = true, out = "string"}))
+--> {
+-->     ["a\nb"] = true,
+-->     ["alias"] = {
+-->         [1] = 80,
+-->         [2] = 443,
+-->     },
+-->     ["name"] = "svc",
+-->     ["ports"] = <ref root.alias>,
+-->     ["ratio"] = 0.25,
+-->     ["self"] = <ref root>,
+--> }
+print(dump_table({{{{}}}}, {depth = 2, out = "string"})) --> { [1] = { [1] = {...}, }, }
+dump_table({1, 2, 3})
+
+---@param t table
+local function mess_up_dump(t)
+    return dump_table(t, {out = "nowhere"})
+end
+
+print("dump_table(out = 'nowhere')", pcall(mess_up_dump, config)) --> (invalid option)
+
+--- }}}
+
+--- UNSAFE ACCESSORS --- {{{
+
+local uget, uset = e:unsafe()
+uset(2, 22)
+
+print("\nUNSAFE ACCESSORS")
+print("uget(2)                ", uget(2), e[2])                --> 22 22
+e:push(60)
+print("uget(6) after push     ", uget(6))                      --> 60
+
+--- }}}
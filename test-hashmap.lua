@@ -0,0 +1,53 @@
+-- `hashmap.insert_many()` takes dyarrays, so load that module first.
+local dyarray = require "dyarray"
+local hashmap = require "hashmap"
+
+local m = hashmap.new(4)
+print("\nCONSTRUCTION")
+print("m               ", m)
+print("m:set(1, 10)    ", m:set(1, 10):set(2.5, 20):set(-0, 30))
+print("m:get(2.5)      ", m:get(2.5))   --> 20
+print("m[0]            ", m[0])         --> 30 (-0 and 0 are the same key)
+print("m:has(3)        ", m:has(3))     --> false
+
+--- REMOVAL --- {{{
+
+print("\nREMOVAL")
+m[1] = nil
+print("m[1] = nil      ", m:get(1))     --> nil
+print("m:remove(2.5)   ", m:remove(2.5)) --> 20
+print("#m              ", #m)           --> 1
+
+local function mess_up_key(m)
+    m:set(0/0, 1)
+end
+
+print("m:set(NaN, 1)   ", pcall(mess_up_key, m)) --> (key is NaN)
+
+--- }}}
+
+--- BULK --- {{{
+
+local keys   = dyarray.new{}
+local values = dyarray.new{}
+for i = 1, 1000 do
+    keys:push(i * 7)
+    values:push(i / 2)
+end
+
+print("\nBULK")
+print("m:insert_many() ", m:insert_many(keys, values))
+print("m:get(7000)     ", m:get(7000))  --> 500
+print("m:get_many(...) ", m:get_many(dyarray.new{7, 8, 14}, -1)) --> {0.5, -1, 1}
+print("m:reserve(1e5)  ", m:reserve(1e5))
+print("m:reserve(2^31) ", pcall(m.reserve, m, 2^31))  --> false (count must be in [0, 939524096])
+print("hashmap.new(-1) ", pcall(hashmap.new, -1))    --> false (count must be in [0, 939524096])
+print("m:clear()       ", m:clear())
+
+local n = 0
+for k, v in m:set(4, 2):set(8, 4):pairs() do
+    n = n + v
+end
+print("sum of values   ", n)            --> 6
+
+--- }}}
@@ -0,0 +1,58 @@
+local dyarray = require "dyarray"
+local ndarray = require "ndarray"
+
+local buf = dyarray.new{1, 2, 3, 4, 5, 6}
+local A   = ndarray.new({2, 3}, buf)
+
+print("\nCONSTRUCTION")
+print("A                  ", A)                        --> ndarray(2x3) {{1, 2, 3}, {4, 5, 6}}
+print("A:shape()          ", A:shape())                --> 2 3
+print("A:strides()        ", A:strides())              --> 3 1
+print("ndarray.new(3)     ", ndarray.new(3))           --> ndarray(3) {0, 0, 0}
+print("new({2, 4}, buf)   ", pcall(ndarray.new, {2, 4}, buf)) --> false (dyarray too short for shape)
+
+--- INDEXING --- {{{
+
+print("\nINDEXING")
+print("A[{2, 1}]          ", A[{2, 1}])                --> 4
+print("A:get(-1, -1)      ", A:get(-1, -1))            --> 6
+print("A[2][3]            ", A[2][3])                  --> 6
+print("A[{3, 1}]          ", pcall(function() return A[{3, 1}] end)) --> false (index out of range)
+A[{1, 1}] = 10
+print("buf[1]             ", buf[1])                   --> 10
+A:set(1, 1, 1)
+
+--- }}}
+
+--- VIEWS --- {{{
+
+local T = A:transpose()
+
+print("\nVIEWS")
+print("T                  ", T)                        --> ndarray(3x2) {{1, 4}, {2, 5}, {3, 6}}
+print("T:strides()        ", T:strides())              --> 1 3
+print("T:is_contiguous()  ", T:is_contiguous())        --> false
+print("A:col(2)           ", A:col(2))                 --> ndarray(2) {2, 5}
+print("A:reshape{3, -1}   ", A:reshape{3, -1})         --> ndarray(3x2) {{1, 2}, {3, 4}, {5, 6}}
+print("T:reshape(6)       ", pcall(T.reshape, T, 6))   --> false (cannot reshape a non-contiguous view)
+print("T:copy():reshape(6)", T:copy():reshape(6))      --> ndarray(6) {1, 4, 2, 5, 3, 6}
+print("T:flatten()        ", T:flatten())              --> {1, 4, 2, 5, 3, 6}
+
+--- }}}
+
+--- ELEMENTWISE --- {{{
+
+print("\nELEMENTWISE")
+print("A:add(A)           ", A:add(A))                 --> ndarray(2x3) {{2, 4, 6}, {8, 10, 12}}
+print("T:mul(T)           ", T:mul(T))                 --> ndarray(3x2) {{1, 16}, {4, 25}, {9, 36}}
+print("T:sum()            ", T:sum())                  --> 21
+A:row(2):mul(10, A:row(2))
+print("A (row 2 * 10)     ", A)                        --> ndarray(2x3) {{1, 2, 3}, {40, 50, 60}}
+A:col(1):fill(0)
+print("buf                ", buf)                      --> {0, 2, 3, 0, 50, 60}
+print("A:add(T)           ", pcall(A.add, A, T))       --> false (shape mismatch)
+
+buf:resize(2)
+print("after resize       ", pcall(A.sum, A))          --> false (buffer was shrunk)
+
+--- }}}
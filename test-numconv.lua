@@ -0,0 +1,36 @@
+local dyarray = require "dyarray"
+local numconv = require "numconv"
+
+print("\nPARSING")
+local a, nbad = numconv.parse_many{"0x1", "0x20", " 42 ", "-0b101", "1e3", "oops", 7}
+print("parse_many      ", a, nbad)                               --> {1, 32, 42, -5, 1000, nan, 7} 1
+print("base 2          ", numconv.parse_many({"101", "0x1"}, 2)) --> {5, nan} 1
+print("base 36         ", numconv.parse_many({"zz"}, 36))        --> {1295} 0
+
+--- FORMATTING --- {{{
+
+local b = dyarray.new{0, 1, 255, -42}
+
+print("\nFORMATTING")
+print("base 16         ", numconv.format_many(b, 16, " "))      --> 0x0 0x1 0xff -0x2a
+print("base 2          ", numconv.format_many(b, 2, ","))       --> 0b0,0b1,0b11111111,-0b101010
+print("base 10         ", numconv.format_many(dyarray.new{0.5, 1e20}, 10, " ")) --> 0.5 1e+20
+local lines = {}
+for s in tostring(numconv.format_many(b, 16)):gmatch("[^\n]+") do
+    lines[#lines + 1] = s
+end
+print("roundtrip       ", numconv.parse_many(lines))             --> {0, 1, 255, -42}
+print("format(0.5, 16) ", pcall(numconv.format_many, dyarray.new{0.5}, 16)) --> (Cannot format)
+
+--- }}}
+
+--- BIT HELPERS --- {{{
+
+print("\nBIT HELPERS")
+print("ilog2(1000)     ", numconv.ilog2(1000))                  --> 9
+print("next_pow2(1000) ", numconv.next_pow2(1000))              --> 1024
+print("next_pow2(0)    ", numconv.next_pow2(0))                 --> 1
+print("popcount(255)   ", numconv.popcount(255))                --> 8
+print("ilog2(0)        ", pcall(numconv.ilog2, 0))              --> (positive integer expected)
+
+--- }}}
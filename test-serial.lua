@@ -0,0 +1,61 @@
+local dyarray = require "dyarray"
+local serial  = require "serial"
+
+---@param v any
+local function roundtrip(v)
+    return (serial.unpack(serial.pack(v)))
+end
+
+print("\nSCALARS")
+print("nil             ", roundtrip(nil))             --> nil
+print("true            ", roundtrip(true))            --> true
+print("-3              ", roundtrip(-3))              --> -3
+print("0.1             ", roundtrip(0.1) == 0.1)      --> true
+print("2^60            ", roundtrip(2^60) == 2^60)    --> true
+print("'a\\0b'          ", roundtrip("a\0b") == "a\0b") --> true
+
+--- TABLES --- {{{
+
+local state = {1, 2, nil, 4, name = "worker", [0.5] = {x = 1}, [true] = false}
+state.self   = state
+state.shared = state[0.5]
+
+local s = serial.pack(state)
+local t = roundtrip(state)
+
+print("\nTABLES")
+print("#s vs dump_table", #s, #dump_table(state, {out = "string"})) --> (smaller)
+print("t[4], t.name    ", t[4], t.name)               --> 4 worker
+print("t[3]            ", t[3])                       --> nil
+print("t[0.5].x        ", t[0.5].x)                   --> 1
+print("t[true]         ", t[true])                    --> false
+print("t.self == t     ", t.self == t)                --> true
+print("t.shared        ", t.shared == t[0.5])         --> true
+dump_table(t, {sort = true})
+
+--- }}}
+
+--- DYARRAY --- {{{
+
+local a = dyarray.new{1.5, 2.5, 3.5}
+local b = roundtrip({values = a, copy = a})
+
+print("\nDYARRAY")
+print("b.values        ", b.values)                   --> {1.5, 2.5, 3.5}
+print("b.copy == values", b.copy == b.values)         --> true
+
+-- Back to back values.
+local two = serial.pack(1) .. serial.pack("two")
+local v1, at = serial.unpack(two)
+print("unpack(two, at) ", v1, serial.unpack(two, at)) --> 1 two 16
+
+--- }}}
+
+--- ERRORS --- {{{
+
+print("\nERRORS")
+print("pack(print)     ", pcall(serial.pack, {print}))           --> (Cannot pack a function value)
+print("unpack(s:sub)   ", pcall(serial.unpack, s:sub(1, -2)))    --> (truncated)
+print("unpack('junk')  ", pcall(serial.unpack, "junk"))          --> (not packed by this version)
+
+--- }}}
@@ -0,0 +1,80 @@
+local dyarray = require "dyarray"
+local sketch  = require "sketch"
+
+local values = dyarray.new()
+for i = 1, 1000 do
+    values:push(i)
+end
+
+-- Within `alpha` of `expected`, relatively.
+---@param x        number
+---@param expected number
+---@param alpha?   number
+local function close(x, expected, alpha)
+    return math.abs(x - expected) <= (alpha or 0.01) * math.abs(expected)
+end
+
+local s = sketch.new():add_many(values)
+
+print("\nSKETCH")
+print("s                      ", s)                            --> sketch(alpha = 0.01, count = 1000, bins = 347)
+print("s:count(), s:sum()     ", s:count(), s:sum())           --> 1000 500500
+print("s:range()              ", s:range())                    --> 1 1000
+print("s:quantile(0)          ", s:quantile(0))                --> 1
+print("s:quantile(1)          ", s:quantile(1))                --> 1000
+print("p50 within 1%          ", close(s:quantile(0.5), 500))   --> true
+print("p99 within 1%          ", close(s:quantile(0.99), 990))  --> true
+print("empty quantile is NaN  ", sketch.new():quantile(0.5) ~= sketch.new():quantile(0.5)) --> true
+print("s:quantile(2)          ", pcall(s.quantile, s, 2))      --> false (quantile must be in [0, 1])
+
+--- SIGNS AND WEIGHTS --- {{{
+
+local t = sketch.new(0.05):add(-10, 3):add(0):add(10, 4):add(0/0)
+
+print("\nSIGNS AND WEIGHTS")
+print("t:count()              ", t:count())                    --> 8
+print("t:quantile(0.25)       ", close(t:quantile(0.25), -10, 0.05)) --> true
+print("t:quantile(3/7)        ", t:quantile(3 / 7))            --> 0
+print("t:quantile(0.75)       ", close(t:quantile(0.75), 10, 0.05))  --> true
+
+--- }}}
+
+--- MERGE --- {{{
+
+local lo, hi = sketch.new(), sketch.new()
+for i = 1, 1000 do
+    (i % 2 == 0 and lo or hi):add(i)
+end
+lo:merge(hi)
+
+print("\nMERGE")
+print("lo:count()             ", lo:count())                   --> 1000
+print("same p90 as s          ", lo:quantile(0.9) == s:quantile(0.9)) --> true
+print("merge(alpha 0.05)      ", pcall(lo.merge, lo, t))       --> false (relative accuracy differs)
+
+--- }}}
+
+--- PACK --- {{{
+
+local bytes = s:pack()
+local u     = sketch.unpack(bytes)
+
+print("\nPACK")
+print("u:count()              ", u:count())                    --> 1000
+print("same p50 as s          ", u:quantile(0.5) == s:quantile(0.5)) --> true
+print("unpack(truncated)      ", pcall(sketch.unpack, bytes:sub(1, 20))) --> false (Cannot unpack: truncated)
+
+--- }}}
+
+--- BOUNDED MEMORY --- {{{
+
+local b = sketch.new(0.01, 16)
+for i = 0, 99 do
+    b:add(1.1 ^ i)
+end
+
+print("\nBOUNDED MEMORY")
+print("b                      ", b)                            --> sketch(alpha = 0.01, count = 100, bins = 16)
+print("b:quantile(1)          ", close(b:quantile(1), 1.1 ^ 99)) --> true
+
+--- }}}
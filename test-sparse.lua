@@ -0,0 +1,32 @@
+local dyarray = require "dyarray"
+local sparse  = require "sparse"
+
+local v = sparse.vector(10, {7, 2, 7}, {1, 5, 2})
+local w = sparse.from_dense(dyarray.new{0, 1, 0, 0, 0, 0, 3, 0, 0, 4})
+
+print("\nVECTORS")
+print("v                  ", v)              --> sparse.vector(dim = 10, nnz = 2) {[2] = 5, [7] = 3}
+print("w:nnz()            ", w:nnz(), #w)    --> 3 10
+print("v:get(7), v:get(1) ", v:get(7), v:get(1)) --> 3 0
+print("v:dot(w)           ", v:dot(w))       --> 14
+print("v:dot(dense)       ", v:dot(w:todense())) --> 14
+print("v:add(w, -1)       ", v:add(w, -1))   --> sparse.vector(dim = 10, nnz = 3) {[2] = 4, [7] = 0, [10] = -4}
+print("w:indices()        ", w:indices())    --> {2, 7, 10}
+print("v:scale(2):values()", v:scale(2):values()) --> {10, 6}
+print("vector(3, {4}, {1})", pcall(sparse.vector, 3, {4}, {1})) --> false (index out of range)
+
+--- CSR --- {{{
+
+local M = sparse.csr(2, 3, {1, 2, 2}, {1, 1, 3}, {5, 6, 7})
+local D = sparse.csr_from_dense(dyarray.new{0, 1, 0, 2, 0, 0}, 2, 3)
+
+print("\nCSR")
+print("M                  ", M)              --> sparse.csr(2 x 3, nnz = 3)
+print("M:shape()          ", M:shape())      --> 2 3
+print("M:get(2, 3)        ", M:get(2, 3))    --> 7
+print("M:mul({1, 1, 1})   ", M:mul(dyarray.new{1, 1, 1})) --> {5, 13}
+print("M:row(2)           ", M:row(2))       --> sparse.vector(dim = 3, nnz = 2) {[1] = 6, [3] = 7}
+print("M:add(D):todense() ", M:add(D):todense()) --> {5, 1, 0, 8, 0, 7}
+print("M:mul({1, 1})      ", pcall(M.mul, M, dyarray.new{1, 1})) --> false (dense array too short)
+
+--- }}}
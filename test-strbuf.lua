@@ -0,0 +1,40 @@
+local strbuf = require "strbuf"
+
+local buf = strbuf.new(16)
+print("\nCONSTRUCTION")
+print("buf             ", buf:append("x = ", 42, ", y = ", -0.5)) --> x = 42, y = -0.5
+print("#buf            ", #buf)                                 --> 16
+print("append_number   ", buf:clear():append_number(2^53))      --> 9.007199254741e+15
+print("rep             ", buf:clear():rep("ab", 3, "-"))        --> ab-ab-ab
+print("rep(s, 0)       ", buf:clear():rep("ab", 0))             --> (empty)
+print("reserve         ", buf:reserve(1e6):length())            --> 0
+
+--- LARGE OUTPUT --- {{{
+
+local big = strbuf.new()
+for i = 1, 100000 do
+    big:append(i, "\n")
+end
+
+print("\nLARGE OUTPUT")
+print("#big            ", #big)                                 --> 588895
+print("tail            ", big:tostring():sub(-7))               --> 100000
+
+local path = os.tmpname()
+local file = assert(io.open(path, "wb"))
+big:write(file)
+file:close()
+file = assert(io.open(path, "rb"))
+print("write(file)     ", file:read("*a") == big:tostring())    --> true
+file:close()
+os.remove(path)
+
+--- }}}
+
+--- ERRORS --- {{{
+
+print("\nERRORS")
+print("append(true)    ", pcall(buf.append, buf, true))         --> (string or number expected)
+print("write(closed)   ", pcall(buf.write, buf, file))          --> (closed file)
+
+--- }}}